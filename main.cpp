@@ -23,53 +23,474 @@
 #include <string>
 #include <metis.h>
 #include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
 
 #include "src/field.h"
 #include "src/helpers.h"
 #include "src/common.h"
 #include "src/MPI/Decomposition/decomposition.h"
 #include "src/MPI/Decomposition/decompositionMetis.h"
+#include "src/MPI/Decomposition/autotuner.h"
+#include "src/MPI/Decomposition/dryRun.h"
+#include "src/MPI/Decomposition/incrementalRefiner.h"
+#include "src/MPI/Decomposition/chunkMapper.h"
 #include "src//MPI/topologies.h"
+#include "src/MPI/halo.h"
+#include "src/MPI/chunkMigration.h"
+#include "src/MPI/topologyBenchmark.h"
+#include "src/MPI/nodeLayout.h"
+#include "src/MPI/reductionBatch.h"
 #include "src/graph.h"
+#include "src/localGraph.h"
+#include "src/graphReader.h"
+#include "src/benchmarks.h"
+#include "src/weightModel.h"
+#include "src/reproducibleSum.h"
+#include "src/pageLocality.h"
 
 void reportElapsedTime(double start, double end, const std::string &message) {
-    findGlobalMin(start);
-    findGlobalMax(end);
+    ReductionBatch batch;
+    batch.add(start, ReductionBatch::OP_MIN);
+    batch.add(end, ReductionBatch::OP_MAX);
+    batch.flush();
     printByRoot("Elapsed time (" + message + "): " + std::to_string(end - start) + "s.");
 }
 
+/*!
+ * @brief Print the conversion errors of the messages sent in a reduced precision.
+ * @param message Name of the communication.
+ * @param wire Wire format used for sending, its total statistics are reduced over all processes.
+ */
+void reportWireErrors(WireFormat &wire, const std::string &message) {
+    WireStats stats = wire.getTotalStats();
+    int64_t num_bytes = wire.getEncodedBytes();
+    std::ostringstream errors;
+
+    if (wire.getPrecision() == WIRE_DOUBLE)
+        return;
+
+    stats.reduce();
+    ReductionBatch batch;
+    batch.add(num_bytes, ReductionBatch::OP_SUM);
+    batch.flush();
+
+    errors << std::scientific << std::setprecision(3) << "max. abs. error " << stats.max_abs_error
+           << ", max. rel. error " << stats.max_rel_error << ", rms error " << stats.getRmsError();
+    printByRoot(message + " sent as " + WireFormat::getName(wire.getPrecision()) + ": "
+                + std::to_string(num_bytes) + " bytes instead of "
+                + std::to_string(stats.num_values * (int64_t) sizeof(double)) + ", " + errors.str());
+}
+
+void generateGraph(Graph &graph, IndicesIJK elts_glob, int stencil) {
+    /* The 2D 5-point graph has a dedicated generator */
+    if (elts_glob.k == 1 && stencil == 7) {
+        graph.generateStructuredParallel(IndicesIJ(elts_glob.i, elts_glob.j));
+    }
+    else {
+        graph.generateStructured(elts_glob, stencil);
+    }
+}
+
+/*!
+ * @brief Let the weights drift and rebalance the graph decomposition incrementally after each drift.
+ * The load drifts towards the cells with higher IDs: at each step the compute weight of the cell
+ * \e n grows by 2% times n / N of its initial value.
+ * @param weights Weights of vertices, \e ncon consecutive values per vertex, changed by the drift.
+ * @param tolerance Allowed load imbalance.
+ * @param tpwgts Desired fraction of each constraint for each partition (empty for uniform).
+ * @param part [in, out] Partitioning, replaced by the refined one.
+ */
+void refineDriftingWeights(Graph &graph, std::vector<int32_t> &weights, int32_t ncon, double tolerance,
+                           const std::vector<real_t> &tpwgts, int num_parts, int num_drifts,
+                           std::vector<int32_t> &part) {
+    IncrementalRefiner refiner;
+    std::vector<Migration> migrations;
+    std::vector<double> fractions;
+    std::vector<int32_t> initial(graph.getRows());
+    int32_t num_vertices = graph.getRows();
+
+    for (size_t pid = 0; pid < tpwgts.size() / ncon; ++pid)
+        fractions.push_back(tpwgts[pid * ncon]);
+    for (int32_t v = 0; v < num_vertices; ++v)
+        initial[v] = weights[(int64_t) v * ncon];
+
+    refiner.setTolerance(tolerance);
+    refiner.initialize(graph, part.data(), num_parts, weights.data(), ncon, fractions);
+
+    for (int drift = 1; drift <= num_drifts; ++drift) {
+        for (int32_t v = 0; v < num_vertices; ++v) {
+            double factor = 1. + 0.02 * drift * v / num_vertices;
+            int32_t weight = std::max<int32_t>(std::llround(initial[v] * factor), 1);
+            if (weight != weights[(int64_t) v * ncon]) {
+                weights[(int64_t) v * ncon] = weight;
+                refiner.updateWeight(v, weight);
+            }
+        }
+
+        double start = getWallTime();
+        int error = refiner.refine(migrations);
+        double elapsed = getWallTime() - start;
+
+        std::ostringstream imbalance;
+        imbalance << std::fixed << std::setprecision(4) << refiner.getImbalance();
+        printByRoot("Drift " + std::to_string(drift) + ": " + std::to_string(migrations.size())
+                    + " cells migrated, edge cut " + (refiner.getCutChange() >= 0 ? "+" : "")
+                    + std::to_string(refiner.getCutChange()) + ", imbalance " + imbalance.str() + ", "
+                    + std::to_string(refiner.getNumVisited()) + " vertices examined, "
+                    + std::to_string(elapsed) + "s");
+        if (error == EXIT_FAILURE)
+            printByRoot("Warning! The refined decomposition exceeds the allowed imbalance...");
+    }
+
+    part.swap(refiner.getPartitioning());
+}
+
+/*!
+ * @brief Map the chunks of the over-decomposition to processes by their weights.
+ * @param weights Weights of vertices, \e ncon consecutive values per vertex.
+ * @param chunks Chunk of each cell.
+ * @param tolerance Allowed load imbalance.
+ * @param owners [out] Process of each chunk.
+ * @param part [out] Process of each cell.
+ */
+void mapChunks(Graph &graph, const std::vector<int32_t> &weights, int32_t ncon, const std::vector<int32_t> &chunks,
+               int32_t num_chunks, int num_parts, double tolerance, std::vector<int32_t> &owners,
+               std::vector<int32_t> &part) {
+    ChunkMapper mapper;
+    ProcessGraph chunk_graph;
+    std::vector<double> costs(num_chunks, 0.);
+
+    for (size_t cell = 0; cell < chunks.size(); ++cell)
+        costs[chunks[cell]] += weights[(int64_t) cell * ncon];
+
+    /* Neighboring chunks are kept on the same process if the balance allows it */
+    chunk_graph.build(graph, chunks.data(), num_chunks);
+    mapper.setTolerance(tolerance);
+    mapper.map(costs, num_parts, owners, &chunk_graph);
+
+    part.resize(chunks.size());
+    for (size_t cell = 0; cell < chunks.size(); ++cell)
+        part[cell] = owners[chunks[cell]];
+
+    std::ostringstream imbalance;
+    imbalance << std::fixed << std::setprecision(4) << ChunkMapper::getImbalance(costs, num_parts, owners);
+    printByRoot(std::to_string(num_chunks) + " chunks mapped to " + std::to_string(num_parts)
+                + " processes, imbalance " + imbalance.str());
+}
+
+/*!
+ * @brief Perform the work on the given cells.
+ * Besides the work, each cell averages the values (all components) of its neighbors, which
+ * requires ghost cells for the boundary ones.
+ * @param cell_costs Time spent on each local cell is added to it (NULL to skip the measurement).
+ */
+void computeCells(Field &field, Halo &halo, const std::vector<int32_t> &cells, ReproducibleSum &result,
+                  ReproducibleSum &checksum, double* cell_costs = NULL) {
+    int32_t num_local = halo.getNumLocal();
+
+    for (size_t n = 0; n < cells.size(); ++n) {
+        int32_t cell = cells[n];
+        double start = (cell_costs != NULL) ? getWallTime() : 0.;
+        double sum = 0.;
+        for (int32_t ckey = halo.getOffsets()[cell]; ckey < halo.getOffsets()[cell + 1]; ++ckey) {
+            int32_t ngb = halo.getNodes()[ckey];
+            for (int comp = 0; comp < field.getNumComponents(); ++comp)
+                sum += (ngb < num_local) ? field.at(comp, ngb) : halo.getGhost(comp, ngb - num_local);
+        }
+        checksum.add(sum / std::max(halo.getOffsets()[cell + 1] - halo.getOffsets()[cell], 1));
+        result.add(field.performCellWork(field(cell)));
+        if (cell_costs != NULL)
+            cell_costs[cell] += getWallTime() - start;
+    }
+}
+
+/*!
+ * @brief Print the statistics of the step reduced over all processes.
+ * @param step Index of the step.
+ * @param stats Time of the step, wait time, max. absolute and relative conversion errors.
+ * @param convert Whether the halo is exchanged in a reduced precision.
+ */
+void reportStep(int step, const double* stats, bool convert) {
+    std::ostringstream errors;
+
+    if (convert) {
+        errors << std::scientific << std::setprecision(3) << ", max. abs. error " << stats[2]
+               << ", max. rel. error " << stats[3];
+    }
+    printByRoot("Step " + std::to_string(step) + ": " + std::to_string(stats[0]) + "s, max. wait "
+                + std::to_string(stats[1]) + "s" + errors.str());
+}
+
+/*!
+ * @brief Run the time steps, the halo exchange is hidden behind the work on the interior cells.
+ * The exchange alone is timed first, the fraction of it that is not spent in MPI_Waitall during
+ * the steps is reported as hidden. Time in MPI_Waitall before the last neighbor has even posted its
+ * messages is due to the load imbalance, not to the communication, so it is reported separately:
+ * each process sends the time it posted the exchange along with it, the clocks being aligned by a
+ * barrier before the steps. With the over-decomposition, chunks migrate between the steps once the
+ * measured load is out of balance.
+ * @param migration Chunks of the over-decomposition (NULL without it).
+ */
+void runTimeSteps(Field &field, Halo &halo, int num_steps, ReproducibleSum &result,
+                  ChunkMigration *migration = NULL) {
+    ReproducibleSum checksum;
+    double exchange_time = 0.;
+    double total_wait = 0.;
+    double total_late = 0.;
+    double total_step = 0.;
+    int num_repeats = 3;
+    int tag = 172;
+
+    for (int r = 0; r < num_repeats; ++r) {
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = getWallTime();
+        halo.begin(field);
+        halo.end();
+        exchange_time += (getWallTime() - start) / num_repeats;
+    }
+
+    /*
+     * Statistics of each step are reduced in the background during the next step, so the step
+     * is reported once the next one is over.
+     */
+    ReductionBatch batch;
+    double stats[4] = {0., 0., 0., 0.};     // Time of the step, wait time and errors being reduced
+    bool convert = halo.getWireFormat().getPrecision() != WIRE_DOUBLE;
+    int reported_step = EMPTY;
+    std::vector<double> ngb_posted;         // Time each neighbor posted its messages of the step
+    std::vector<MPI_Request> stamp_requests;
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double origin = getWallTime();
+
+    for (int step = 0; step < num_steps; ++step) {
+        double start = getWallTime();
+        double wait = 0.;
+        double late = 0.;
+        std::vector<int> &neighbors = halo.getNeighbors();
+        int num_ngbs = neighbors.size();
+
+        double* cell_costs = (migration != NULL) ? migration->getCellCosts().data() : NULL;
+        halo.begin(field);
+        double posted = getWallTime() - origin;
+        ngb_posted.assign(num_ngbs, 0.);
+        stamp_requests.resize(2 * num_ngbs);
+        for (int n = 0; n < num_ngbs; ++n) {
+            MPI_Irecv(&ngb_posted[n], 1, MPI_DOUBLE, neighbors[n], tag, MPI_COMM_WORLD, &stamp_requests[n]);
+            MPI_Isend(&posted, 1, MPI_DOUBLE, neighbors[n], tag, MPI_COMM_WORLD, &stamp_requests[num_ngbs + n]);
+        }
+        computeCells(field, halo, halo.getInterior(), result, checksum, cell_costs);
+        double ready = getWallTime() - origin;
+        wait = halo.end();
+        MPI_Waitall(stamp_requests.size(), stamp_requests.data(), MPI_STATUSES_IGNORE);
+        computeCells(field, halo, halo.getBoundary(), result, checksum, cell_costs);
+
+        /* Messages cannot arrive before they were posted, waiting for the last neighbor is not communication */
+        for (int n = 0; n < num_ngbs; ++n)
+            late = std::max(late, ngb_posted[n] - ready);
+        late = std::min(late, wait);
+
+        double step_time = getWallTime() - start;
+        total_wait += wait;
+        total_late += late;
+        total_step += step_time;
+
+        batch.clear();
+        if (reported_step != EMPTY) {
+            reportStep(reported_step, stats, convert);
+        }
+        stats[0] = step_time;
+        stats[1] = wait;
+        stats[2] = halo.getWireFormat().getLastStats().max_abs_error;
+        stats[3] = halo.getWireFormat().getLastStats().max_rel_error;
+        reported_step = step;
+        for (int n = 0; n < 4; ++n)
+            batch.add(stats[n], ReductionBatch::OP_MAX);
+        batch.start();
+
+        if (migration != NULL)
+            migration->rebalance(field, halo);
+    }
+    batch.clear();
+    if (reported_step != EMPTY) {
+        reportStep(reported_step, stats, convert);
+    }
+
+    /* Part of the exchange that was overlapped with the work on the interior cells */
+    double exposed = total_wait - total_late;
+    double hidden = (exchange_time > 0.) ? 1. - std::min(exposed / num_steps / exchange_time, 1.) : 1.;
+    double min_hidden = hidden;
+
+    batch.add(total_step, ReductionBatch::OP_MAX);
+    batch.add(total_wait, ReductionBatch::OP_MAX);
+    batch.add(total_late, ReductionBatch::OP_MAX);
+    batch.add(exposed, ReductionBatch::OP_MAX);
+    batch.add(exchange_time, ReductionBatch::OP_MAX);
+    batch.add(hidden, ReductionBatch::OP_SUM);
+    batch.add(min_hidden, ReductionBatch::OP_MIN);
+    batch.flush();
+    checksum.reduce();
+    printByRoot("Average step: " + std::to_string(total_step / num_steps) + "s, time in MPI_Waitall: "
+                + std::to_string(total_wait) + "s, exchange alone: " + std::to_string(exchange_time) + "s");
+    printByRoot("Time in MPI_Waitall waiting for late neighbors (imbalance): " + std::to_string(total_late)
+                + "s, for the communication: " + std::to_string(exposed) + "s");
+    printByRoot("Hidden communication: " + std::to_string(100. * hidden / getNumProcs()) + "% on average, "
+                + std::to_string(100. * min_hidden) + "% at least");
+    printByRoot("Checksum of the neighbor averages: " + std::to_string(checksum.getValue()));
+    if (migration != NULL)
+        printByRoot("Chunk migration: " + std::to_string(migration->getNumMoves()) + " chunks, "
+                    + std::to_string(migration->getNumMovedCells()) + " cells moved in total");
+    reportWireErrors(halo.getWireFormat(), "Halo");
+}
+
 int main(int argc, char** argv) {
 
     Helpers helper;
     Field field;
-    IndicesIJ elts_glob;        // Number of global cells in each direction
-    IndicesIJ struct_part;      // Number of processes in each direction (for structured decomposition only)
+    IndicesIJK elts_glob;       // Number of global cells in each direction
+    IndicesIJK struct_part;     // Number of processes in each direction (for structured decomposition only)
     DecompositionStruct decomp_struct;
     DecompositionMetis decomp_metis;
     Graph graph(ADJ_LIST);
     int8_t type = STRUCTURED;
+    bool autotune = false;
     int root_pid = 0;
     int32_t* partitioning;
+    std::vector<int32_t> glob_part;         // Process of each cell, updated by the chunk migration
+    std::vector<int32_t> refined_part;      // Partitioning refined for the drifting weights
+    std::vector<int32_t> chunk_of_cells;    // Chunk of each cell (over-decomposition only)
+    std::vector<int32_t> chunk_owners;      // Process of each chunk
+    std::vector<int32_t> mapped_part;       // Process of each cell, derived from the chunks
     int32_t num_glob_elts;
     double elp_times[2];
     Topologies topology;
+    Topologies cart_topology;
+    DryRun dry_run;
+    int num_parts;              // Number of subdomains, differs from the number of processes for a dry run
     double res = 0.;
+    ReproducibleSum result;
 
     /* Initialize MPI region */
     initialize(argc, argv);
 
     /* Parse input from the CL */
     helper.parseInput(argc, argv, elts_glob, struct_part, type);
-    num_glob_elts = elts_glob.i * elts_glob.j;
+    setPagePolicy(helper.getPagePolicy());
+    num_glob_elts = elts_glob.i * elts_glob.j * elts_glob.k;
+    autotune = (type == AUTOTUNE);
+
+    /* A dry run decomposes the domain for the requested number of processes instead of the available ones */
+    num_parts = (helper.getDryRunProcs() > 0) ? helper.getDryRunProcs() : getNumProcs();
+    decomp_struct.setNumParts(num_parts);
+    decomp_metis.setNumParts(num_parts * helper.getNumChunks());
+    if (helper.getDryRunProcs() > 0)
+        dry_run.calibrateNetwork("network.dat");
+
+    /* Chunks of the over-decomposition are the partitions of a graph */
+    if (helper.getNumChunks() > 1 && ((type != METIS && type != NATIVE) || !helper.getTargetWeights().empty())) {
+        printByRoot("Error! The over-decomposition requires a graph decomposition without target weights...");
+        terminateExecution();
+    }
+
+    /* Nodes of the processes are discovered by all processes, the root one partitions the graph for them */
+    if (helper.isNodeAware()) {
+        NodeLayout node_layout;
+        if ((type != METIS && type != NATIVE) || helper.getNumChunks() > 1) {
+            printByRoot("Error! The node-aware partitioning requires a graph decomposition without chunks...");
+            terminateExecution();
+        }
+        if (helper.getRanksPerNode() > 0) {
+            node_layout.emulate(num_parts, helper.getRanksPerNode());
+        }
+        else if (helper.getDryRunProcs() > 0) {
+            printByRoot("Error! The nodes of a dry run have to be set by the number of ranks per node...");
+            terminateExecution();
+        }
+        else {
+            node_layout.discover();
+        }
+        printByRoot("Number of nodes: " + std::to_string(node_layout.getNumNodes()));
+        decomp_metis.setNodeLayout(node_layout.getNodeOfRanks());
+    }
+
+    /* Read the graph by the root process, it replaces the structured grid. The other processes receive the
+     * rows of their cells along with the field, unless they migrate chunks of the whole graph */
+    if (!helper.getGraphFile().empty()) {
+        GraphReader reader;
+        double start = getWallTime();
+        int32_t num_rows = 0;
+
+        if (type != METIS && type != NATIVE) {
+            printByRoot("Error! A graph read from the file can be decomposed with METIS or the native partitioner only...");
+            terminateExecution();
+        }
+        if (getMyRank() == root_pid || helper.getNumChunks() > 1) {
+            if (reader.read(helper.getGraphFile(), graph) == EXIT_FAILURE) {
+                terminateExecution();
+            }
+            num_rows = graph.getRows();
+        }
+        broadcastFromRoot(&num_rows, 1, root_pid);
+
+        elts_glob = IndicesIJK(num_rows, 1, 1);
+        num_glob_elts = num_rows;
+        printByRoot("The graph has been read in " + std::to_string(getWallTime() - start) + "s: "
+                    + std::to_string(graph.getRows()) + " vertices, "
+                    + std::to_string(graph.getNodes().size() / 2) + " edges");
+    }
+
+    /* Find the number of processes in each direction, if requested */
+    if (helper.getProcessLayout() == LAYOUT_PENCIL || helper.getProcessLayout() == LAYOUT_BLOCK) {
+        struct_part = decomp_struct.getProcessGrid(num_parts, helper.getProcessLayout(), elts_glob);
+        printByRoot("Process grid: " + std::to_string(struct_part.i) + " x " + std::to_string(struct_part.j)
+                    + " x " + std::to_string(struct_part.k));
+    }
+
+    /* Run the requested benchmark instead of the regular workflow */
+    /* The communication benchmark needs the partitioning, it runs later */
+    if (!helper.getBenchmark().empty() && helper.getBenchmark() != "comm") {
+        Benchmarks benchmarks;
+        int error = EXIT_SUCCESS;
+        if (getMyRank() == root_pid) {
+            error = benchmarks.run(helper.getBenchmark(), IndicesIJ(elts_glob.i, elts_glob.j),
+                                   IndicesIJ(struct_part.i, struct_part.j));
+        }
+        finalize();
+        return error;
+    }
 
     /* Generate initial field and decompose the data by the root process */
     if (getMyRank() == root_pid) {
-        field.initialize(elts_glob, elts_glob);
+        field.initialize(elts_glob, elts_glob, helper.getNumComponents(), helper.getFieldLayout());
         field.generate();
 
         /* Print field to the file */
         field.print("original");
 
+        /* Select the grid of processes by evaluating all factorizations of the number of processes */
+        if (helper.getProcessLayout() == LAYOUT_AUTO) {
+            struct_part = decomp_struct.selectProcessGrid(num_parts, elts_glob);
+        }
+        else if (helper.getProcessLayout() == LAYOUT_AUTO_LOAD) {
+            struct_part = decomp_struct.selectProcessGrid(num_parts, elts_glob, &field);
+        }
+
+        /* Select the decomposition type and its options, or reuse the ones selected before */
+        if (autotune) {
+            Autotuner autotuner;
+            autotuner.setCostFactor(helper.getCostFactor());
+            autotuner.setNumParts(num_parts);
+            if (autotuner.tune(elts_glob, field, helper.getStencil(), "autotune.dat") == EXIT_FAILURE) {
+                terminateExecution();
+            }
+            type = autotuner.getType();
+            if (type == STRUCTURED)
+                struct_part = autotuner.getProcessGrid();
+            decomp_metis.setConfig(autotuner.getMetisConfig());
+        }
+
         if (type == STRUCTURED) {
             /* Call for structured decomposition */
             if (decomp_struct.decompose(struct_part, elts_glob) == EXIT_FAILURE) {
@@ -78,54 +499,229 @@ int main(int argc, char** argv) {
 
             /* Print structured decomposition to the file */
             decomp_struct.print("struct.dat", elts_glob);
-
-            partitioning = decomp_struct.getPartitioning().data();
-        } else if (type == METIS) {
-            graph.generateStructured(elts_glob);
+        } else if (type == METIS || type == NATIVE) {
+            if (graph.getNodes().empty()) {
+                generateGraph(graph, elts_glob, helper.getStencil());
+            }
 
             /* Uncomment this line to print the graph to the terminal */
             // graph.print();
 
+            /* Weights stored in the graph file take precedence over the field */
+            int32_t ncon = (graph.getNumConstraints() > 0) ? graph.getNumConstraints()
+                                                           : helper.getNumConstraints();
+
+            /* Weights of each vertex are interleaved: [compute, memory] */
             std::vector<int32_t> weights;
-            weights.resize(graph.getRows());
-            for (int32_t n = 0; n < weights.size(); ++n) {
-                /* Uncomment this line to change the weight distribution */
-                // weights[n] = 100 * field(n);
-                weights[n] = field.getLocalLoad(field(n));
+            if (graph.getNumConstraints() > 0) {
+                weights.assign(graph.getVertexWeights().begin(), graph.getVertexWeights().end());
+            } else {
+                WeightModel weight_model;
+                weight_model.calibrate(field);
+                weight_model.computeWeights(field, weights, ncon);
+            }
+
+            /* A single tolerance applies to all constraints */
+            std::vector<real_t> ubvec;
+            std::vector<float> &tolerances = helper.getTolerances();
+            if (!tolerances.empty()) {
+                if (tolerances.size() != 1 && (int32_t) tolerances.size() != ncon) {
+                    printByRoot("Error! Number of tolerances differs from number of constraints...");
+                    terminateExecution();
+                }
+                for (int32_t con = 0; con < ncon; ++con)
+                    ubvec.push_back(tolerances[(tolerances.size() == 1) ? 0 : con]);
+            }
+
+            /* Fractions of a partition apply to all constraints, they are normalized to sum up to 1 */
+            std::vector<real_t> tpwgts;
+            std::vector<float> &targets = helper.getTargetWeights();
+            if (!targets.empty()) {
+                double sum = 0.;
+                if ((int) targets.size() != num_parts) {
+                    printByRoot("Error! Number of target weights differs from number of processes...");
+                    terminateExecution();
+                }
+                for (size_t pid = 0; pid < targets.size(); ++pid)
+                    sum += targets[pid];
+                for (size_t pid = 0; pid < targets.size(); ++pid)
+                    for (int32_t con = 0; con < ncon; ++con)
+                        tpwgts.push_back(targets[pid] / sum);
             }
 
             /* Call for graph decomposition */
-            if (decomp_metis.decompose(graph, weights.data()) == EXIT_FAILURE) {
+            decomp_metis.getConfig().native = (type == NATIVE);
+            if (decomp_metis.decompose(graph, weights.data(), ncon,
+                                       ubvec.empty() ? NULL : ubvec.data(),
+                                       tpwgts.empty() ? NULL : tpwgts.data()) == EXIT_FAILURE) {
                 terminateExecution();
             }
+            decomp_metis.reportBalance(weights.data(), ncon, tpwgts.empty() ? NULL : tpwgts.data());
 
             /* Print graph decomposition to the file */
             decomp_metis.print("graph.dat", elts_glob);
+            decomp_metis.reportLinks(helper.getNumComponents(), WireFormat(helper.getWirePrecision()).getValueSize());
 
             partitioning = decomp_metis.getPartitioning().data();
+
+            /* Rebalance the decomposition for slowly drifting weights instead of partitioning it again */
+            if (helper.getNumDrifts() > 0) {
+                refined_part.assign(partitioning, partitioning + num_glob_elts);
+                refineDriftingWeights(graph, weights, ncon, ubvec.empty() ? 1.03 : ubvec[0], tpwgts,
+                                      decomp_metis.getNumParts(), helper.getNumDrifts(), refined_part);
+                partitioning = refined_part.data();
+            }
+
+            /* Partitions of the over-decomposition are chunks, which are mapped to processes */
+            if (helper.getNumChunks() > 1) {
+                chunk_of_cells.assign(partitioning, partitioning + num_glob_elts);
+                mapChunks(graph, weights, ncon, chunk_of_cells, decomp_metis.getNumParts(), num_parts,
+                          ubvec.empty() ? 1.05 : ubvec[0], chunk_owners, mapped_part);
+                partitioning = mapped_part.data();
+            }
         }
         else {
             printByRoot("Unknown decomposition type");
             terminateExecution();
         }
+
+        /* Predict the time step instead of running it */
+        if (helper.getDryRunProcs() > 0) {
+            WeightModel weight_model;
+            int value_size = WireFormat(helper.getWirePrecision()).getValueSize();
+            if (graph.getNodes().empty()) {
+                generateGraph(graph, elts_glob, helper.getStencil());
+            }
+            weight_model.calibrate(field);
+            if (type == STRUCTURED)
+                dry_run.predict(graph, field, decomp_struct.getOwnership(), weight_model, value_size);
+            else
+                dry_run.predict(graph, field, partitioning, num_parts, weight_model, value_size);
+        }
     }
 
-    /* Distribute the field */
-    field.distribute(partitioning, num_glob_elts, root_pid);
+    if (helper.getDryRunProcs() > 0) {
+        finalize();
+        return EXIT_SUCCESS;
+    }
+
+    /* The automatically selected grid of processes and decomposition type are known by the root process only */
+    if (helper.getProcessLayout() == LAYOUT_AUTO || helper.getProcessLayout() == LAYOUT_AUTO_LOAD || autotune) {
+        int32_t grid[4] = {struct_part.i, struct_part.j, struct_part.k, type};
+        broadcastFromRoot(grid, 4, root_pid);
+        struct_part = IndicesIJK(grid[0], grid[1], grid[2]);
+        type = grid[3];
+        if (type == STRUCTURED)
+            printByRoot("Process grid: " + std::to_string(struct_part.i) + " x " + std::to_string(struct_part.j)
+                    + " x " + std::to_string(struct_part.k));
+    }
+
+    /* Chunks and their owners are known by all processes, so each one can migrate its chunks */
+    if (helper.getNumChunks() > 1) {
+        chunk_of_cells.resize(num_glob_elts);
+        chunk_owners.resize(num_parts * helper.getNumChunks());
+        broadcastFromRoot(chunk_of_cells.data(), num_glob_elts, root_pid);
+        broadcastFromRoot(chunk_owners.data(), chunk_owners.size(), root_pid);
+    }
+
+    /* The structured decomposition is known by all processes from the grid of processes alone */
+    StructuredOwnership ownership(struct_part, elts_glob);
+
+    /* Distribute the field, each process gets the rows of its cells and the owners of their neighbors along.
+     * The structured decomposition computes them from the ranges of the subdomains instead */
+    WireFormat dist_wire(helper.getWirePrecision());
+    LocalGraph local_graph;
+    if (type == STRUCTURED)
+        field.distribute(ownership, root_pid, dist_wire);
+    else
+        field.distribute(partitioning, num_glob_elts, root_pid, dist_wire, graph, local_graph);
+    reportWireErrors(dist_wire, "Field");
 
     /* Print local field for debugging */
     field.print("output");
 
+    /* Chunks are migrated by their owners, so the graph of the whole domain is kept by all processes */
+    if (helper.getNumChunks() > 1 && graph.getNodes().empty()) {
+        generateGraph(graph, elts_glob, helper.getStencil());
+    }
+
+    /* Create the graph topology and print neighbors of each process */
+    if (type == STRUCTURED)
+        topology.createGraphTopology(ownership, helper.getStencil());
+    else
+        topology.createGraphTopology(local_graph);
+    topology.testGraphTopology();
+    topology.reportLinkWeights(field.getNumComponents(), WireFormat(helper.getWirePrecision()).getValueSize());
+
+    /* Structured decomposition maps directly onto the Cartesian topology */
+    if (type == STRUCTURED && elts_glob.k == 1) {
+        cart_topology.createCartTopology(IndicesIJ(struct_part.i, struct_part.j));
+    }
+    else if (type == STRUCTURED) {
+        cart_topology.createCartTopology(struct_part);
+    }
+    if (type == STRUCTURED) {
+        if (cart_topology.testCartTopology() != EXIT_SUCCESS) {
+            finalize();
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Measure the neighbors instead of the time steps */
+    if (helper.getBenchmark() == "comm") {
+        TopologyBenchmark comm_benchmark;
+        std::vector<int> cart_dims;
+        int error;
+        if (type == STRUCTURED) {
+            cart_dims.push_back(struct_part.i);
+            cart_dims.push_back(struct_part.j);
+            if (elts_glob.k > 1)
+                cart_dims.push_back(struct_part.k);
+        }
+        if (type == STRUCTURED)
+            error = comm_benchmark.run(ownership, helper.getStencil(), cart_dims);
+        else
+            error = comm_benchmark.run(local_graph, cart_dims);
+        finalize();
+        return error;
+    }
+
     /* Perform some calculations and report the elapsed time */
     elp_times[0] = helper.tic();
-    res = field.performDummyWork();
+    if (helper.getNumSteps() > 0) {
+        Halo halo;
+        ChunkMigration migration;
+        if (type == STRUCTURED)
+            halo.build(ownership, helper.getStencil(), field.getNumComponents(), helper.getWirePrecision());
+        else
+            halo.build(local_graph, field.getNumComponents(), helper.getWirePrecision());
+        if (helper.getNumChunks() > 1) {
+            migration.initialize(graph, glob_part, chunk_of_cells, chunk_owners);
+            if (!helper.getTolerances().empty())
+                migration.setTolerance(helper.getTolerances()[0]);
+        }
+        runTimeSteps(field, halo, helper.getNumSteps(), result, (helper.getNumChunks() > 1) ? &migration : NULL);
+    }
+    else {
+        field.performDummyWork(result);
+    }
     elp_times[1] = helper.toc();
 
-    /* Print result for the verification */
-    findGlobalSum(res);
-    printByRoot("result: " + std::to_string(res));
+    /* Print result for the verification, the exact sum does not depend on the decomposition */
+    result.reduce();
+    res = result.getValue();
+    std::ostringstream res_str;
+    res_str << std::setprecision(17) << res;
+    printByRoot("result: " + res_str.str());
     reportElapsedTime(elp_times[0], elp_times[1], "Work");
 
+    /* Pages of the field and the graph are placed by now */
+    if (helper.getReportPages()) {
+        PageLocality locality;
+        locality.collect();
+        locality.report();
+    }
+
     /* Finalize MPI region */
     finalize();
 
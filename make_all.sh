@@ -25,14 +25,29 @@ compiler='mpicxx'
 extra_flags=(-lmpi -lmetis)
 exe_name=topologies
 
+# "./make_all.sh virtual" replaces MPI by threads within a single process, the number of
+# ranks is set at runtime by the environment variable VIRTUAL_RANKS
+if [ "$1" == "virtual" ]; then
+    extra_flags=(-lmetis -DUSE_VIRTUAL_RANKS)
+    exe_name=topologies_virtual
+fi
+
 $compiler \
-    -g3 -O3 --std=c++11 \
+    -g3 -O3 --std=c++11 -fopenmp \
     "${extra_flags[@]}" \
     -o $exe_name \
     main.cpp \
     src/field.cpp \
     src/helpers.cpp \
     src/MPI/Decomposition/decomposition.cpp \
-    src/graph.cpp \
-    src/MPI/Decomposition/decompositionMetis.cpp \
-    src/MPI/topologies.cpp
+    src/graph.cpp src/localGraph.cpp \
+    src/processGraph.cpp \
+    src/graphReader.cpp \
+    src/benchmarks.cpp src/weightModel.cpp src/reproducibleSum.cpp src/pageLocality.cpp \
+    src/MPI/Decomposition/decompositionMetis.cpp src/MPI/Decomposition/autotuner.cpp src/MPI/Decomposition/dryRun.cpp \
+    src/MPI/Decomposition/nativePartitioner.cpp \
+    src/MPI/Decomposition/incrementalRefiner.cpp \
+    src/MPI/Decomposition/chunkMapper.cpp src/MPI/Decomposition/structuredOwnership.cpp \
+    src/MPI/topologies.cpp src/MPI/halo.cpp src/MPI/reductionBatch.cpp src/MPI/wireFormat.cpp src/MPI/chunkMigration.cpp \
+    src/MPI/topologyBenchmark.cpp src/MPI/nodeLayout.cpp \
+    src/MPI/virtualRanks.cpp
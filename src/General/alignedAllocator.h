@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_ALIGNEDALLOCATOR_H
+#define UNBALANCED_WORKLOAD_ALIGNEDALLOCATOR_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+
+#include "macro.h"
+
+/*!
+ * @brief Size of a huge page, allocations of at least this size follow the page policy.
+ */
+const size_t huge_page_size = 2 * 1024 * 1024;
+
+/*!
+ * @brief Get the backing of large allocations, shared by all allocators.
+ */
+inline PagePolicy& pagePolicy() {
+
+    static PagePolicy policy = PAGES_DEFAULT;
+    return policy;
+}
+
+/*!
+ * @brief Set the backing of large allocations.
+ * Memory is released according to the current policy, thus it has to be set before anything is
+ * allocated, i.e. right after parsing the command line.
+ */
+inline void setPagePolicy(PagePolicy policy) {
+
+    pagePolicy() = policy;
+}
+
+/*!
+ * @brief Allocator returning memory aligned to \e ALIGNMENT bytes (a cache line by default).
+ * Elements are default-initialized, i.e. \e resize() of a vector of numbers does not write the
+ * memory. Pages are thus placed on the NUMA node of the thread touching them first, which is
+ * expected to be the one computing on them. Allocations of at least \e huge_page_size bytes are
+ * backed by huge pages unless the policy is \e PAGES_DEFAULT.
+ */
+template<typename T, size_t ALIGNMENT = 64>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+
+    template<typename U>
+    struct rebind {
+        typedef AlignedAllocator<U, ALIGNMENT> other;
+    };
+
+    AlignedAllocator() { }
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) { }
+
+    T* allocate(size_t size) {
+        void *ptr = NULL;
+        if (size == 0)
+            return NULL;
+        if (isHuge(size))
+            return static_cast<T*>(mapHugePages(getMappedLength(size)));
+        if (posix_memalign(&ptr, ALIGNMENT, size * sizeof(T)) != 0)
+            throw std::bad_alloc();
+        return static_cast<T*>(ptr);
+    }
+
+    void deallocate(T *ptr, size_t size) {
+        if (ptr != NULL && isHuge(size))
+            munmap(ptr, getMappedLength(size));
+        else
+            free(ptr);
+    }
+
+    /*!
+     * @brief Construct the element without a value, numbers are left uninitialized.
+     */
+    template<typename U>
+    void construct(U *ptr) {
+        ::new((void*) ptr) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U *ptr, Args&&... args) {
+        ::new((void*) ptr) U(std::forward<Args>(args)...);
+    }
+
+private:
+    inline bool isHuge(size_t size) {
+        return pagePolicy() != PAGES_DEFAULT && size * sizeof(T) >= huge_page_size;
+    }
+
+    inline size_t getMappedLength(size_t size) {
+        return (size * sizeof(T) + huge_page_size - 1) / huge_page_size * huge_page_size;
+    }
+
+    /*!
+     * @brief Map anonymous memory backed by huge pages.
+     * Explicit huge pages come from the pool reserved by the system. If it is exhausted (or not
+     * configured), transparent huge pages are requested for a region aligned to the huge page.
+     * @param length Length of the region, a multiple of \e huge_page_size.
+     */
+    void* mapHugePages(size_t length) {
+
+        void *ptr = MAP_FAILED;
+        char *base;
+        size_t head;
+
+#ifdef MAP_HUGETLB
+        if (pagePolicy() == PAGES_EXPLICIT)
+            ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+            return ptr;
+#endif
+
+        /* Over-allocate by a huge page and trim the region, so it starts at the huge page boundary */
+        ptr = mmap(NULL, length + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+
+        base = static_cast<char*>(ptr);
+        head = (huge_page_size - (uintptr_t) base % huge_page_size) % huge_page_size;
+        if (head > 0)
+            munmap(base, head);
+        munmap(base + head + length, huge_page_size - head);
+
+#ifdef MADV_HUGEPAGE
+        madvise(base + head, length, MADV_HUGEPAGE);
+#endif
+        return base + head;
+    }
+};
+
+template<typename T, typename U, size_t ALIGNMENT>
+inline bool operator==(const AlignedAllocator<T, ALIGNMENT>&, const AlignedAllocator<U, ALIGNMENT>&) {
+    return true;
+}
+
+template<typename T, typename U, size_t ALIGNMENT>
+inline bool operator!=(const AlignedAllocator<T, ALIGNMENT>&, const AlignedAllocator<U, ALIGNMENT>&) {
+    return false;
+}
+
+#endif //UNBALANCED_WORKLOAD_ALIGNEDALLOCATOR_H
@@ -39,6 +39,33 @@ enum StorageType {
 enum ExecutionType {
     STRUCTURED,
     METIS,
+    AUTOTUNE,       // Select either STRUCTURED or METIS (and its options) automatically
+    NATIVE,         // Built-in multilevel graph partitioner instead of METIS
+};
+
+enum ProcessLayout {
+    LAYOUT_MANUAL,      // Number of processes in each direction is set by the user
+    LAYOUT_PENCIL,      // Decompose in i-th and j-th directions only
+    LAYOUT_BLOCK,       // Decompose in all directions
+    LAYOUT_AUTO,        // Minimize the total halo size
+    LAYOUT_AUTO_LOAD,   // Minimize the maximum load of a subdomain
+};
+
+enum FieldLayout {
+    FIELD_SOA,          // Each component is stored in a separate array
+    FIELD_AOSOA,        // Components are interleaved in blocks of cells
+};
+
+enum WirePrecision {
+    WIRE_DOUBLE,        // Values are sent as they are
+    WIRE_FLOAT,         // Single precision, half of the bytes
+    WIRE_BF16,          // bfloat16 (8-bit mantissa), a quarter of the bytes
+};
+
+enum PagePolicy {
+    PAGES_DEFAULT,      // Regular pages of the heap
+    PAGES_TRANSPARENT,  // Transparent huge pages requested by madvise()
+    PAGES_EXPLICIT,     // Huge pages reserved by the system (transparent ones if none are left)
 };
 
 #define NOT_IMPLEMENTED { std::cerr << "Error! The " << __FUNCTION__ << " function is not implemented. See file " \
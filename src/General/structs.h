@@ -36,4 +36,21 @@ struct IndicesIJ {
     IndicesIJ(int _i, int _j) : i(_i), j(_j) { }
 };
 
+/*!
+ * @brief Structure of {i,j,k} indices.
+ */
+struct IndicesIJK {
+    int i = 0;
+    int j = 0;
+    int k = 0;
+
+    IndicesIJK() { }
+    IndicesIJK(int _i, int _j, int _k) : i(_i), j(_j), k(_k) { }
+
+    /*!
+     * @brief Convert 2D sizes into 3D ones, i.e. a single layer in k-th direction.
+     */
+    explicit IndicesIJK(IndicesIJ ij) : i(ij.i), j(ij.j), k(1) { }
+};
+
 #endif //UNBALANCED_WORKLOAD_STRUCTS_H
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+
+#include "autotuner.h"
+#include "../../weightModel.h"
+
+int Autotuner::tune(const IndicesIJK elts_glob, Field &field, int stencil, const std::string file_name) {
+
+    int num_procs = getNumParts();
+    int64_t num_cells = (int64_t) elts_glob.i * elts_glob.j * elts_glob.k;
+    int dim = (elts_glob.k > 1) ? 3 : 2;
+    std::vector<Candidate> candidates;
+    std::ostringstream key;
+    Candidate best;
+
+    key << elts_glob.i << " " << elts_glob.j << " " << elts_glob.k << " " << num_procs << " "
+        << stencil << " " << alpha;
+
+    /* Reuse the configuration selected by one of the previous runs */
+    if (load(file_name, key.str(), best)) {
+        std::cout << "Autotuner: " << best.name << " (read from " << file_name << ")\n";
+        type = best.type;
+        grid = best.grid;
+        config = best.config;
+        return EXIT_SUCCESS;
+    }
+
+    /*
+     * The coarse grid should still have a few hundred cells per process, otherwise the
+     * structured decomposition can not be represented on it.
+     */
+    int64_t max_coarse_cells = std::max((int64_t) 1 << 16, (int64_t) 256 * num_procs);
+    int factor = (int) std::ceil(std::pow((double) num_cells / max_coarse_cells, 1. / dim));
+    factor = std::max(factor, 1);
+
+    IndicesIJK elts_coarse;
+    std::vector<int32_t> weights;
+    Graph graph(ADJ_LIST);
+    double start = getWallTime();
+
+    coarsen(elts_glob, field, factor, elts_coarse, weights);
+    graph.generateStructured(elts_coarse, stencil);
+
+    /* Structured candidates, duplicate grids are skipped */
+    DecompositionStruct decomp_struct;
+    decomp_struct.setNumParts(num_procs);
+    ProcessLayout layouts[2] = {LAYOUT_PENCIL, LAYOUT_BLOCK};
+    for (int l = 0; l < 2; ++l) {
+        Candidate candidate;
+        candidate.type = STRUCTURED;
+        candidate.grid = decomp_struct.getProcessGrid(num_procs, layouts[l], elts_glob);
+        candidate.name = "structured " + std::to_string(candidate.grid.i) + "x"
+                         + std::to_string(candidate.grid.j) + "x" + std::to_string(candidate.grid.k);
+        if (l > 0 && candidate.name == candidates.back().name)
+            continue;
+        candidates.push_back(candidate);
+    }
+
+    /* METIS candidates */
+    MetisConfig metis_configs[7];
+    metis_configs[1].recursive = true;
+    metis_configs[2].min_volume = true;
+    metis_configs[3].contiguous = true;
+    metis_configs[4].ufactor = 10;
+    metis_configs[5].ufactor = 100;
+    metis_configs[6].niter = 50;
+    for (int c = 0; c < 7; ++c) {
+        Candidate candidate;
+        candidate.type = METIS;
+        candidate.config = metis_configs[c];
+        candidate.name = "METIS " + getName(metis_configs[c]);
+        candidates.push_back(candidate);
+    }
+
+    /* A coarse face represents factor^(dim-1) fine faces */
+    double face_scale = std::pow((double) factor, dim - 1);
+    double cells_per_part = (double) num_cells / num_procs;
+
+    std::cout << "Autotuner: " << candidates.size() << " candidates on the " << elts_coarse.i << " x "
+              << elts_coarse.j << " x " << elts_coarse.k << " grid (coarsening factor " << factor << ")\n";
+
+    for (auto &candidate : candidates) {
+        std::vector<int32_t> part;
+
+        if (candidate.type == STRUCTURED) {
+            /* Directions of the coarse grid might be too short for the grid of processes */
+            if (candidate.grid.i > elts_coarse.i || candidate.grid.j > elts_coarse.j
+                || candidate.grid.k > elts_coarse.k
+                || decomp_struct.decompose(candidate.grid, elts_coarse) == EXIT_FAILURE) {
+                candidate.cost = -1.;
+                continue;
+            }
+            decomp_struct.getOwnership().fill(part);
+        }
+        else {
+            DecompositionMetis decomp_metis;
+            decomp_metis.setConfig(candidate.config);
+            decomp_metis.setNumParts(num_procs);
+            if (decomp_metis.partition(graph, weights.data(), 1, NULL, NULL) != METIS_OK) {
+                candidate.cost = -1.;
+                continue;
+            }
+            part = decomp_metis.getPartitioning();
+        }
+
+        evaluate(graph, weights, part, face_scale, cells_per_part, candidate);
+
+        std::cout << "  " << candidate.name << ": load " << candidate.load << ", volume "
+                  << candidate.volume << ", cost " << candidate.cost << "\n";
+
+        if (best.name.empty() || candidate.cost < best.cost)
+            best = candidate;
+    }
+
+    if (best.name.empty()) {
+        std::cout << "Error! None of the candidates can decompose the problem...\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Autotuner: " << best.name << " has been selected in "
+              << getWallTime() - start << "s\n";
+
+    type = best.type;
+    grid = best.grid;
+    config = best.config;
+
+    save(file_name, key.str(), best);
+
+    return EXIT_SUCCESS;
+}
+
+void Autotuner::coarsen(const IndicesIJK elts_glob, Field &field, int factor, IndicesIJK &elts_coarse,
+                        std::vector<int32_t> &weights) {
+
+    std::vector<double> loads;
+
+    elts_coarse.i = (elts_glob.i + factor - 1) / factor;
+    elts_coarse.j = (elts_glob.j + factor - 1) / factor;
+    elts_coarse.k = (elts_glob.k + factor - 1) / factor;
+
+    loads.assign((int64_t) elts_coarse.i * elts_coarse.j * elts_coarse.k, 0.);
+
+    for (int i = 0; i < elts_glob.i; ++i) {
+        for (int j = 0; j < elts_glob.j; ++j) {
+            for (int k = 0; k < elts_glob.k; ++k) {
+                int64_t id = k / factor + (int64_t) elts_coarse.k * (j / factor
+                             + (int64_t) elts_coarse.j * (i / factor));
+                loads[id] += field.getLocalLoad(field(i, j, k));
+            }
+        }
+    }
+
+    /* Sums of loads easily exceed the range of int32_t */
+    weights.resize(loads.size());
+    WeightModel::quantize(loads, weights.data());
+}
+
+void Autotuner::evaluate(Graph &graph, const std::vector<int32_t> &weights, const std::vector<int32_t> &part,
+                         double face_scale, double cells_per_part, Candidate &candidate) {
+
+    int num_procs = getNumParts();
+    std::vector<double> loads(num_procs, 0.);
+    std::vector<double> volumes(num_procs, 0.);
+    std::vector<int32_t> foreign;
+    double total = 0.;
+    int32_t *offsets = graph.getOffsets().data();
+    int32_t *nodes = graph.getNodes().data();
+
+    for (int32_t n = 0; n < graph.getRows(); ++n) {
+        loads[part[n]] += weights[n];
+        total += weights[n];
+
+        /* The cell is sent once to each neighboring partition */
+        foreign.clear();
+        for (int32_t pos = offsets[n]; pos < offsets[n + 1]; ++pos) {
+            int32_t pid = part[nodes[pos]];
+            if (pid != part[n] && std::find(foreign.begin(), foreign.end(), pid) == foreign.end())
+                foreign.push_back(pid);
+        }
+        volumes[part[n]] += foreign.size();
+    }
+
+    candidate.load = *std::max_element(loads.begin(), loads.end()) / (total / num_procs);
+    candidate.volume = *std::max_element(volumes.begin(), volumes.end()) * face_scale / cells_per_part;
+    candidate.cost = candidate.load + alpha * candidate.volume;
+}
+
+bool Autotuner::load(const std::string file_name, const std::string key, Candidate &candidate) {
+
+    std::ifstream in_str(file_name);
+    std::string line;
+
+    /* Each line is: key | type grid.i grid.j grid.k | recursive min_volume contiguous ufactor niter */
+    while (std::getline(in_str, line)) {
+        size_t sep = line.find('|');
+        if (line.empty() || line[0] == '#' || sep == std::string::npos)
+            continue;
+        if (line.substr(0, sep - 1) != key)
+            continue;
+
+        std::istringstream values(line.substr(sep + 1));
+        int t;
+        char bar;
+        values >> t >> candidate.grid.i >> candidate.grid.j >> candidate.grid.k >> bar
+               >> candidate.config.recursive >> candidate.config.min_volume >> candidate.config.contiguous
+               >> candidate.config.ufactor >> candidate.config.niter;
+        if (values.fail() || (t != STRUCTURED && t != METIS))
+            continue;
+
+        candidate.type = t;
+        if (candidate.type == STRUCTURED)
+            candidate.name = "structured " + std::to_string(candidate.grid.i) + "x"
+                             + std::to_string(candidate.grid.j) + "x" + std::to_string(candidate.grid.k);
+        else
+            candidate.name = "METIS " + getName(candidate.config);
+        return true;
+    }
+
+    return false;
+}
+
+void Autotuner::save(const std::string file_name, const std::string key, const Candidate &candidate) {
+
+    bool exists = std::ifstream(file_name).good();
+    std::ofstream out_str(file_name, std::ios::app);
+
+    if (!out_str.is_open()) {
+        std::cout << "Warning! The selected configuration can not be stored in " << file_name << "\n";
+        return;
+    }
+
+    if (!exists)
+        out_str << "# elts.i elts.j elts.k num_procs stencil alpha | type grid.i grid.j grid.k | "
+                   "recursive min_volume contiguous ufactor niter\n";
+
+    out_str << key << " | " << (int) candidate.type << " " << candidate.grid.i << " " << candidate.grid.j
+            << " " << candidate.grid.k << " | " << candidate.config.recursive << " "
+            << candidate.config.min_volume << " " << candidate.config.contiguous << " "
+            << candidate.config.ufactor << " " << candidate.config.niter << "\n";
+}
+
+std::string Autotuner::getName(const MetisConfig &metis_config) {
+
+    std::string name = metis_config.recursive ? "recursive" : "k-way";
+
+    if (metis_config.min_volume)
+        name += ", volume";
+    if (metis_config.contiguous)
+        name += ", contiguous";
+    if (metis_config.ufactor != EMPTY)
+        name += ", ufactor " + std::to_string(metis_config.ufactor);
+    if (metis_config.niter != EMPTY)
+        name += ", niter " + std::to_string(metis_config.niter);
+
+    return name;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_AUTOTUNER_H
+#define UNBALANCED_WORKLOAD_AUTOTUNER_H
+
+#include <string>
+#include <vector>
+
+#include "../../General/macro.h"
+#include "../../General/structs.h"
+#include "../../field.h"
+#include "../../graph.h"
+#include "decomposition.h"
+#include "decompositionMetis.h"
+
+/*!
+ * \class Autotuner
+ * @brief Selects the decomposition (structured or METIS with its options) for the given problem.
+ * Candidates are evaluated on a coarsened copy of the grid with the cost model
+ *   cost = max. load / avg. load + alpha * max. volume / avg. number of cells,
+ * where the volume of a subdomain is the number of cells it sends to its neighbors. The
+ * selected configuration is stored in a file, so subsequent runs of the same problem skip
+ * the search.
+ */
+class Autotuner {
+public:
+    Autotuner() : alpha(1.), type(STRUCTURED), grid(1, 1, 1), num_parts(EMPTY) { }
+
+    ~Autotuner() { }
+
+    /*!
+     * @brief Select the decomposition, or read it from the file if it has been selected before.
+     * @param elts_glob Global number of elements/cells in each direction.
+     * @param field Global field used to evaluate the load of each cell.
+     * @param stencil Number of points in the stencil (7 or 27).
+     * @param file_name File with previously selected configurations.
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int tune(const IndicesIJK elts_glob, Field &field, int stencil, const std::string file_name);
+
+    /*!
+     * @brief Set the weight of the communication volume in the cost model.
+     */
+    inline void setCostFactor(double factor) {
+        alpha = factor;
+    }
+
+    /*!
+     * @brief Set number of subdomains, e.g. for a dry run (the number of processes by default).
+     */
+    inline void setNumParts(int parts) {
+        num_parts = parts;
+    }
+
+    /*!
+     * @brief Get number of subdomains.
+     */
+    inline int getNumParts() {
+        return (num_parts != EMPTY) ? num_parts : getNumProcs();
+    }
+
+    /*!
+     * @brief Get the selected decomposition type, either \e STRUCTURED or \e METIS.
+     */
+    inline int8_t getType() {
+        return type;
+    }
+
+    /*!
+     * @brief Get the selected grid of processes (structured decomposition only).
+     */
+    inline IndicesIJK getProcessGrid() {
+        return grid;
+    }
+
+    /*!
+     * @brief Get the selected options of METIS (METIS decomposition only).
+     */
+    inline MetisConfig& getMetisConfig() {
+        return config;
+    }
+
+private:
+    /*!
+     * @brief Candidate decomposition and its score.
+     */
+    struct Candidate {
+        std::string name;
+        int8_t type = STRUCTURED;
+        IndicesIJK grid;
+        MetisConfig config;
+        double load = 0.;       // Maximum load relative to the average one
+        double volume = 0.;     // Maximum volume relative to the average number of cells
+        double cost = 0.;
+    };
+
+    /*!
+     * @brief Merge blocks of \e factor cells in each direction into a single cell.
+     * Weights of the coarse cells are sums of loads of the merged cells, quantized with
+     * \e WeightModel::quantize().
+     * @param elts_glob Global number of elements/cells in each direction.
+     * @param field Global field used to evaluate the load of each cell.
+     * @param factor Number of merged cells in each direction.
+     * @param elts_coarse [out] Number of coarse cells in each direction.
+     * @param weights [out] Weights of coarse cells.
+     */
+    void coarsen(const IndicesIJK elts_glob, Field &field, int factor, IndicesIJK &elts_coarse,
+                 std::vector<int32_t> &weights);
+
+    /*!
+     * @brief Score the partitioning of the coarse graph.
+     * @param graph Coarse graph.
+     * @param weights Weights of coarse cells.
+     * @param part Partition of each coarse cell.
+     * @param face_scale Number of fine faces represented by a coarse face.
+     * @param cells_per_part Average number of fine cells per partition.
+     * @param candidate [out] Candidate to be scored.
+     */
+    void evaluate(Graph &graph, const std::vector<int32_t> &weights, const std::vector<int32_t> &part,
+                  double face_scale, double cells_per_part, Candidate &candidate);
+
+    /*!
+     * @brief Find the configuration of the problem in the file.
+     * @return Returns true if the configuration has been found.
+     */
+    bool load(const std::string file_name, const std::string key, Candidate &candidate);
+
+    /*!
+     * @brief Append the configuration of the problem to the file.
+     */
+    void save(const std::string file_name, const std::string key, const Candidate &candidate);
+
+    /*!
+     * @brief Human readable description of METIS options.
+     */
+    std::string getName(const MetisConfig &metis_config);
+
+private:
+    double alpha;           // Weight of the communication volume in the cost model
+    int8_t type;            // Selected decomposition type
+    IndicesIJK grid;        // Selected grid of processes
+    MetisConfig config;     // Selected options of METIS
+    int num_parts;          // Number of subdomains (EMPTY for the number of processes)
+};
+
+#endif //UNBALANCED_WORKLOAD_AUTOTUNER_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <set>
+#include <cmath>
+#include <algorithm>
+
+#include "chunkMapper.h"
+
+void ChunkMapper::map(const std::vector<double>& costs, int32_t num_procs, std::vector<int32_t>& owners,
+                      ProcessGraph* chunk_graph) {
+
+    int32_t num_chunks = costs.size();
+    std::vector<int32_t> order(num_chunks);
+    std::vector<double> loads(num_procs, 0.);
+    std::set<std::pair<double, int32_t> > by_load;      // (load, process), the least loaded first
+    double total = 0.;
+
+    for (int32_t c = 0; c < num_chunks; ++c) {
+        order[c] = c;
+        total += costs[c];
+    }
+    for (int32_t pid = 0; pid < num_procs; ++pid)
+        by_load.insert(std::make_pair(0., pid));
+
+    /* The most expensive chunks first, ties in the order of chunks */
+    std::stable_sort(order.begin(), order.end(), [&costs](int32_t a, int32_t b) { return costs[a] > costs[b]; });
+
+    /* A process may exceed the least loaded one by this amount to keep the neighbors together */
+    double slack = (tolerance - 1.) * total / num_procs;
+
+    owners.assign(num_chunks, EMPTY);
+    for (int32_t n = 0; n < num_chunks; ++n) {
+        int32_t c = order[n];
+        int32_t best = by_load.begin()->second;
+        int64_t best_affinity = 0;
+
+        if (chunk_graph != NULL && chunk_graph->getNumProcs() == num_chunks) {
+            for (int32_t ngb = 0; ngb < chunk_graph->getNumNeighbors(c); ++ngb) {
+                int32_t pid = owners[chunk_graph->getNeighbors(c)[ngb]];
+                int64_t affinity = 0;
+                if (pid == EMPTY || loads[pid] > loads[by_load.begin()->second] + slack)
+                    continue;
+
+                /* Faces shared with the chunks already mapped to the process */
+                for (int32_t other = 0; other < chunk_graph->getNumNeighbors(c); ++other) {
+                    if (owners[chunk_graph->getNeighbors(c)[other]] == pid)
+                        affinity += chunk_graph->getWeights(c)[other];
+                }
+                if (affinity > best_affinity || (affinity == best_affinity && affinity > 0 && pid < best)) {
+                    best = pid;
+                    best_affinity = affinity;
+                }
+            }
+        }
+
+        by_load.erase(std::make_pair(loads[best], best));
+        loads[best] += costs[c];
+        by_load.insert(std::make_pair(loads[best], best));
+        owners[c] = best;
+    }
+}
+
+void ChunkMapper::remap(const std::vector<double>& costs, int32_t num_procs, std::vector<int32_t>& owners,
+                        std::vector<ChunkMove>& moves) {
+
+    int32_t num_chunks = costs.size();
+    std::vector<double> loads(num_procs, 0.);
+    std::vector<std::vector<int32_t> > chunks(num_procs);
+    std::set<std::pair<double, int32_t> > by_load;
+    double total = 0.;
+    int32_t limit = (max_moves != EMPTY) ? max_moves : num_procs;
+
+    moves.clear();
+    for (int32_t c = 0; c < num_chunks; ++c) {
+        loads[owners[c]] += costs[c];
+        chunks[owners[c]].push_back(c);
+        total += costs[c];
+    }
+    for (int32_t pid = 0; pid < num_procs; ++pid)
+        by_load.insert(std::make_pair(loads[pid], pid));
+
+    while ((int32_t) moves.size() < limit) {
+        int32_t heaviest = by_load.rbegin()->second;
+        int32_t lightest = by_load.begin()->second;
+        double difference = loads[heaviest] - loads[lightest];
+        int32_t best = EMPTY;
+
+        if (loads[heaviest] <= tolerance * total / num_procs)
+            break;
+
+        /* The chunk closest to a half of the difference evens out the pair best */
+        for (size_t n = 0; n < chunks[heaviest].size(); ++n) {
+            int32_t c = chunks[heaviest][n];
+            if (costs[c] <= 0. || costs[c] >= difference)
+                continue;
+            if (best == EMPTY || std::fabs(costs[c] - 0.5 * difference) < std::fabs(costs[best] - 0.5 * difference))
+                best = c;
+        }
+        if (best == EMPTY)
+            break;
+
+        by_load.erase(std::make_pair(loads[heaviest], heaviest));
+        by_load.erase(std::make_pair(loads[lightest], lightest));
+        loads[heaviest] -= costs[best];
+        loads[lightest] += costs[best];
+        by_load.insert(std::make_pair(loads[heaviest], heaviest));
+        by_load.insert(std::make_pair(loads[lightest], lightest));
+        chunks[heaviest].erase(std::find(chunks[heaviest].begin(), chunks[heaviest].end(), best));
+        chunks[lightest].push_back(best);
+        owners[best] = lightest;
+
+        ChunkMove move = {best, heaviest, lightest};
+        moves.push_back(move);
+    }
+}
+
+double ChunkMapper::getImbalance(const std::vector<double>& costs, int32_t num_procs,
+                                 const std::vector<int32_t>& owners) {
+
+    int32_t num_chunks = costs.size();
+    std::vector<double> loads(num_procs, 0.);
+    double total = 0.;
+
+    for (int32_t c = 0; c < num_chunks; ++c) {
+        loads[owners[c]] += costs[c];
+        total += costs[c];
+    }
+    return (total > 0.) ? *std::max_element(loads.begin(), loads.end()) * num_procs / total : 1.;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_CHUNKMAPPER_H
+#define UNBALANCED_WORKLOAD_CHUNKMAPPER_H
+
+#include <vector>
+#include <cstdint>
+
+#include "../../General/macro.h"
+#include "../../processGraph.h"
+
+/*!
+ * @brief Chunk changing its owner.
+ */
+struct ChunkMove {
+    int32_t chunk;
+    int32_t from;       // Previous owner
+    int32_t to;         // New owner
+};
+
+/*!
+ * \class ChunkMapper
+ * @brief Assigns the chunks of an over-decomposition (several partitions per process) to processes.
+ * The initial mapping follows the longest processing time first rule: chunks are taken from the
+ * most expensive one and each goes to the least loaded process. If the graph of chunks is given,
+ * a chunk rather goes to a process already owning its neighbors, as long as that process is within
+ * the tolerance of the least loaded one. Remapping with measured costs moves single chunks from the
+ * most loaded process to the least loaded one, so the balance is restored with a few small moves.
+ */
+class ChunkMapper {
+public:
+    ChunkMapper() : tolerance(1.05), max_moves(EMPTY) { }
+
+    ~ChunkMapper() { }
+
+    /*!
+     * @brief Map the chunks to processes.
+     * @param costs Cost of each chunk.
+     * @param num_procs Number of processes.
+     * @param owners [out] Process of each chunk.
+     * @param chunk_graph Connectivity between chunks (NULL to ignore it).
+     */
+    void map(const std::vector<double>& costs, int32_t num_procs, std::vector<int32_t>& owners,
+             ProcessGraph* chunk_graph = NULL);
+
+    /*!
+     * @brief Move chunks from the most loaded processes to the least loaded ones until the imbalance
+     * is within the tolerance or no move reduces the maximum load.
+     * @param costs Cost of each chunk, e.g. the measured one.
+     * @param num_procs Number of processes.
+     * @param owners [in, out] Process of each chunk.
+     * @param moves [out] Moved chunks.
+     */
+    void remap(const std::vector<double>& costs, int32_t num_procs, std::vector<int32_t>& owners,
+               std::vector<ChunkMove>& moves);
+
+    /*!
+     * @brief Get the ratio of the maximum load of a process to the average one.
+     */
+    static double getImbalance(const std::vector<double>& costs, int32_t num_procs,
+                               const std::vector<int32_t>& owners);
+
+    /*!
+     * @brief Set allowed load imbalance, i.e. the maximum ratio of the load of a process to the average.
+     */
+    inline void setTolerance(double value) {
+        tolerance = value;
+    }
+
+    /*!
+     * @brief Set maximum number of moves of a single remapping (EMPTY for the number of processes).
+     */
+    inline void setMaxMoves(int32_t moves) {
+        max_moves = moves;
+    }
+
+private:
+    double tolerance;       // Allowed load imbalance
+    int32_t max_moves;      // Maximum number of moves of a single remapping
+};
+
+#endif //UNBALANCED_WORKLOAD_CHUNKMAPPER_H
@@ -27,47 +27,30 @@
 #include <iostream>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
 #include "decomposition.h"
 
-void DecompositionStruct::getProcCoord(int rank, int &proc_ind_i, int &proc_ind_j) {
+int DecompositionStruct::decompose(const IndicesIJ num_procs, const IndicesIJ elts_glob) {
 
-    /*
-     * Note, according to the standard, C and C++ always round down results of
-     * the integer division!
-     */
-    proc_ind_i = rank / num_subdomains.j;               // index of the process
-                                                        // in i-th direction
-    proc_ind_j = rank - proc_ind_i * num_subdomains.j;  // index of the process
-                                                        // in j-th direction
+    return decompose(IndicesIJK(num_procs), IndicesIJK(elts_glob));
 }
 
-//int DecompositionStruct::getProcInd(int proc_ind_i, int proc_ind_j) {
-//
-//    return proc_ind_j + proc_ind_i * num_subdomains.j;
-//}
-
-int DecompositionStruct::decompose(const IndicesIJ num_procs, const IndicesIJ elts_glob) {
+int DecompositionStruct::decompose(const IndicesIJK num_procs, const IndicesIJK elts_glob) {
 
-    int num_procs_avail = getNumProcs();
-
-    part.resize(elts_glob.i * elts_glob.j);
+    int num_procs_avail = getNumParts();
 
     /* Check if number of processes correspond to the decomposition size. */
-    if (num_procs_avail != num_procs.i * num_procs.j) {
+    if (num_procs_avail != num_procs.i * num_procs.j * num_procs.k) {
         printByRoot("The specified number of processes doesn't "
                     "match the available number of processes: "
-                    + std::to_string(num_procs.i * num_procs.j)
+                    + std::to_string(num_procs.i * num_procs.j * num_procs.k)
                     + " vs. "
                     + std::to_string(num_procs_avail));
         /* Note, all processes should exit the function! */
         return EXIT_FAILURE;
     }
 
-    /* Assign number of subdomains to local variables. */
-    num_subdomains.i = num_procs.i;
-    num_subdomains.j = num_procs.j;
-
     /*
      * Assume that all processes are enumerated in the "natural" order. For a 2d
      * decomposition among 9 processes the enumeration will look like:
@@ -82,91 +65,149 @@ int DecompositionStruct::decompose(const IndicesIJ num_procs, const IndicesIJ el
      * 10x10 elements. Thus, processes 0,1,3,4 should have 3x3 elements each,
      * while processes 2 and 5 should have 3x4 elements, processes 6 and 7 should
      * have 4x3 elements, and process 8 should have 4x4 elements. Summing up, all
-     * this processes will result in total number of 100 elements.
+     * this processes will result in total number of 100 elements. In 3d, the same
+     * applies to the k-th direction, which is the fastest one in the enumeration.
+     * The ownership computes these ranges and the owner of any cell on demand.
      */
+    ownership = StructuredOwnership(num_procs, elts_glob);
 
-    for (int pid = 0; pid < getNumProcs(); ++pid) {
-        int proc_ind_i = 0;     // index of the process in i-th direction.
-        int proc_ind_j = 0;     // index of the process in j-th direction.
-        IndicesIJ beg_ind_glob;
-        IndicesIJ end_ind_glob;
-        IndicesIJ elts_loc;
-
-        /* Get process "coordinates". Note: my_rank = proc_ind_j + proc_ind_i * nj. */
-        getProcCoord(pid, proc_ind_i, proc_ind_j);
-
-        /* Assign local dimensions */
-        elts_loc.i = floor(elts_glob.i / num_subdomains.i);
-        elts_loc.j = floor(elts_glob.j / num_subdomains.j);
-
-        /*
-         * Get the global indices that correspond to the very first (bottom/left) cells
-         * of the current sub-domain.
-         */
-        beg_ind_glob.i = proc_ind_i * elts_loc.i;
-        beg_ind_glob.j = proc_ind_j * elts_loc.j;
-
-        /* Correct the number of cells for the most top/right sub-domains */
-        if ((elts_glob.i % num_subdomains.i) && (proc_ind_i == num_subdomains.i - 1)) {
-            int remainder = elts_glob.i - elts_loc.i * (proc_ind_i + 1);
-            elts_loc.i += remainder;
-        }
+    return EXIT_SUCCESS;
+}
 
-        if ((elts_glob.j % num_subdomains.j) && (proc_ind_j == num_subdomains.j - 1)) {
-            int remainder = elts_glob.j - elts_loc.j * (proc_ind_j + 1);
-            elts_loc.j += remainder;
-        }
+IndicesIJK DecompositionStruct::getProcessGrid(int num_procs, ProcessLayout layout, const IndicesIJK elts_glob) {
 
-        /*
-         * Get the global indices that correspond to the very last (top/right) cells
-         * of the current sub-domain.
-         */
-        if (proc_ind_i + 1 < num_subdomains.i) {
-            end_ind_glob.i = (proc_ind_i + 1) * elts_loc.i;
-        }
-        else {
-            end_ind_glob.i = elts_glob.i;
-        }
-        if (proc_ind_j + 1 < num_subdomains.i) {
-            end_ind_glob.j = (proc_ind_j + 1) * elts_loc.j;
-        }
-        else {
-            end_ind_glob.j = elts_glob.j;
+    int dims[3] = {0, 0, 0};
+
+    /* Zeros are filled in by MPI, the rest is kept as is */
+    if (layout == LAYOUT_PENCIL || elts_glob.k == 1) {
+        dims[2] = 1;
+    }
+    MPI_Dims_create(num_procs, 3, dims);
+
+    return IndicesIJK(dims[0], dims[1], dims[2]);
+}
+
+IndicesIJK DecompositionStruct::selectProcessGrid(int num_procs, const IndicesIJK elts_glob, Field *field) {
+
+    std::vector<GridCandidate> candidates;
+    std::vector<double> volume;     // Summed-volume table of the load
+    IndicesIJK size(elts_glob.i + 1, elts_glob.j + 1, elts_glob.k + 1);
+    double total_load = 0.;
+    int num_printed = 5;
+
+    /* Summed-volume table gives the load of any box in O(1) */
+    if (field != NULL) {
+        volume.assign((int64_t) size.i * size.j * size.k, 0.);
+        for (int i = 1; i < size.i; ++i) {
+            for (int j = 1; j < size.j; ++j) {
+                for (int k = 1; k < size.k; ++k) {
+                    int64_t id = k + size.k * (j + (int64_t) size.j * i);
+                    volume[id] = field->getLocalLoad((*field)(i - 1, j - 1, k - 1))
+                                 + volume[id - size.k * size.j] + volume[id - size.k] + volume[id - 1]
+                                 - volume[id - size.k * size.j - size.k] - volume[id - size.k * size.j - 1]
+                                 - volume[id - size.k - 1] + volume[id - size.k * size.j - size.k - 1];
+                }
+            }
         }
+        total_load = volume.back();
+    }
 
-        /* Fill in the partition array */
-        for (int i = beg_ind_glob.i; i < end_ind_glob.i; ++i) {
-            for (int j = beg_ind_glob.j; j < end_ind_glob.j; ++j) {
-                part[j + i * elts_glob.j] = pid;
+    /* Each subdomain must have at least one cell in each direction */
+    for (int pi = 1; pi <= std::min(num_procs, elts_glob.i); ++pi) {
+        if (num_procs % pi)
+            continue;
+        for (int pj = 1; pj <= std::min(num_procs / pi, elts_glob.j); ++pj) {
+            if ((num_procs / pi) % pj)
+                continue;
+            int pk = num_procs / pi / pj;
+            if (pk > elts_glob.k)
+                continue;
+
+            GridCandidate cand;
+            cand.grid = IndicesIJK(pi, pj, pk);
+            cand.halo = (int64_t) (pi - 1) * elts_glob.j * elts_glob.k
+                        + (int64_t) (pj - 1) * elts_glob.i * elts_glob.k
+                        + (int64_t) (pk - 1) * elts_glob.i * elts_glob.j;
+
+            if (field != NULL) {
+                StructuredOwnership cand_ownership(cand.grid, elts_glob);
+                for (int pid = 0; pid < num_procs; ++pid) {
+                    IndicesIJK beg, end;
+                    cand_ownership.getRange(pid, beg, end);
+
+                    /* Inclusion-exclusion over the corners of the box */
+                    double load = 0.;
+                    for (int corner = 0; corner < 8; ++corner) {
+                        int i = (corner & 4) ? end.i : beg.i;
+                        int j = (corner & 2) ? end.j : beg.j;
+                        int k = (corner & 1) ? end.k : beg.k;
+                        int sign = ((corner & 4) ? 1 : -1) * ((corner & 2) ? 1 : -1) * ((corner & 1) ? 1 : -1);
+                        load += sign * volume[k + size.k * (j + (int64_t) size.j * i)];
+                    }
+                    cand.max_load = std::max(cand.max_load, load);
+                }
             }
+            candidates.push_back(cand);
         }
+    }
 
+    if (candidates.empty()) {
+        std::cout << "Warning! The grid is too small for " << num_procs << " processes...\n";
+        return getProcessGrid(num_procs, LAYOUT_BLOCK, elts_glob);
+    }
 
+    std::sort(candidates.begin(), candidates.end(),
+              [](const GridCandidate &a, const GridCandidate &b) {
+                  if (a.max_load != b.max_load)
+                      return a.max_load < b.max_load;
+                  return a.halo < b.halo;
+              });
+
+    /* Report the best candidates. Each cut face is sent in both directions. */
+    std::cout << "Best process grids (communication volume per exchange):\n";
+    for (int n = 0; n < std::min<int>(num_printed, candidates.size()); ++n) {
+        GridCandidate &cand = candidates[n];
+        std::cout << "  " << cand.grid.i << " x " << cand.grid.j << " x " << cand.grid.k << ": "
+                  << 2 * cand.halo << " faces (" << 2 * cand.halo * sizeof(double) << " bytes)";
+        if (field != NULL) {
+            std::cout << ", max load " << cand.max_load << " (imbalance "
+                      << cand.max_load * num_procs / total_load << ")";
+        }
+        std::cout << "\n";
     }
 
-    return EXIT_SUCCESS;
+    return candidates[0].grid;
 }
 
 void DecompositionStruct::print(const std::string file_name, const IndicesIJ elts_glob) {
 
-    if (!part.empty()) {
-        std::ofstream out_str;
-        int32_t id = 0;
+    print(file_name, IndicesIJK(elts_glob));
+}
+
+void DecompositionStruct::print(const std::string file_name, const IndicesIJK elts_glob) {
+
+    const IndicesIJK &decomposed = ownership.getGlobalSize();
+    std::ofstream out_str;
 
-        out_str.open(file_name, std::ios::out);
+    /* Nothing has been decomposed for this domain */
+    if (decomposed.i != elts_glob.i || decomposed.j != elts_glob.j || decomposed.k != elts_glob.k)
+        return;
 
-        if (out_str.is_open()) {
+    out_str.open(file_name, std::ios::out);
+
+    if (out_str.is_open()) {
+        /* Print layer by layer in k-th direction, owners are computed on the fly */
+        for (int32_t k = 0; k < elts_glob.k; ++k) {
             out_str << "\n";
             for (int32_t j = 0; j < elts_glob.j; ++j) {
                 for (int32_t i = 0; i < elts_glob.i; ++i) {
-                    id = j + elts_glob.j * i;
-                    out_str << part[id] << " ";
+                    out_str << ownership.getOwner(i, j, k) << " ";
                 }
                 out_str << "\n";
             }
-            out_str << "\n";
         }
-
-        out_str.close();
+        out_str << "\n";
     }
+
+    out_str.close();
 }
@@ -29,48 +29,102 @@
 #include "../../General/macro.h"
 #include "../../General/structs.h"
 #include "../../field.h"
+#include "structuredOwnership.h"
 
 /*!
  * \class DecompositionStruct
- * @brief Responsible for the structured data decomposition in a 1D or 2D way.
+ * @brief Responsible for the structured data decomposition in a 1D, 2D or 3D way.
+ * The decomposition is described by \e StructuredOwnership, the owner of each cell is computed
+ * on demand instead of being stored.
  */
 class DecompositionStruct {
 public:
     /*!
      * @brief Default constructor.
      */
-    DecompositionStruct() : num_subdomains(1, 1) { }
-    ~DecompositionStruct() { part.clear(); }
+    DecompositionStruct() : num_parts(EMPTY) { }
+    ~DecompositionStruct() { }
 
     /*!
      * @brief Decompose the domain.
      * @param num_procs [in] Number of subdomains in each direction.
      * @param elts_glob [in] Global number of elements/cells in each direction.
-     * @param elts_loc [out] Local number of elements/cells in each direction.
-     * @param beg_ind_glob [out] Global indices of the very first cell.
      * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
      */
     int decompose(const IndicesIJ num_procs, const IndicesIJ elts_glob);
 
+    /*!
+     * @brief Decompose the 3D domain.
+     * Cells and processes are enumerated as k + n.k * (j + n.j * i).
+     * @param num_procs [in] Number of subdomains in each direction.
+     * @param elts_glob [in] Global number of elements/cells in each direction.
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int decompose(const IndicesIJK num_procs, const IndicesIJK elts_glob);
+
+    /*!
+     * @brief Find the number of subdomains in each direction for the given layout.
+     * Pencils are never split in k-th direction, blocks are split in all directions. The k-th
+     * direction of a 2D domain (a single layer of cells) is never split.
+     * @param num_procs Total number of subdomains.
+     * @param layout Either \e LAYOUT_PENCIL or \e LAYOUT_BLOCK.
+     * @param elts_glob Global number of elements/cells in each direction.
+     * @return Number of subdomains in each direction.
+     */
+    IndicesIJK getProcessGrid(int num_procs, ProcessLayout layout, const IndicesIJK elts_glob);
+
+    /*!
+     * @brief Select the number of subdomains in each direction automatically.
+     * All factorizations of \e num_procs are evaluated. Without \e field, the one with the
+     * smallest total halo (number of cut faces) is selected. With \e field, the one with the
+     * smallest maximum load of a subdomain is selected and the halo size breaks ties. The
+     * estimated communication volume of the best candidates is printed.
+     * @param num_procs Total number of subdomains.
+     * @param elts_glob Global number of elements/cells in each direction.
+     * @param field Global field used to evaluate the load of each cell (optional).
+     * @return Number of subdomains in each direction.
+     */
+    IndicesIJK selectProcessGrid(int num_procs, const IndicesIJK elts_glob, Field *field = NULL);
+
+    /*!
+     * @brief Set number of subdomains, e.g. for a dry run (the number of processes by default).
+     */
+    inline void setNumParts(int parts) {
+        num_parts = parts;
+    }
+
+    /*!
+     * @brief Get number of subdomains.
+     */
+    inline int getNumParts() {
+        return (num_parts != EMPTY) ? num_parts : getNumProcs();
+    }
+
     void print(const std::string file_name, const IndicesIJ elts_glob);
 
-    inline std::vector<int32_t>& getPartitioning() {
-        return part;
+    void print(const std::string file_name, const IndicesIJK elts_glob);
+
+    /*!
+     * @brief Get ownership of the cells by the last decomposition.
+     */
+    inline const StructuredOwnership& getOwnership() {
+        return ownership;
     }
 
 private:
     /*!
-     * @brief Calculate the coordinates of the sub-domain based on its rank.
-     * @param rank Rank of the process.
-     * @param proc_ind_i [out] Coordinate in i-th direction.
-     * @param proc_ind_j [out] Coordinate in j-th direction.
+     * @brief Candidate grid of processes, see \e selectProcessGrid().
      */
-    void getProcCoord(int rank, int &proc_ind_i, int &proc_ind_j);
+    struct GridCandidate {
+        IndicesIJK grid;
+        int64_t halo = 0;       // Total number of cut faces
+        double max_load = 0.;   // Maximum load of a subdomain
+    };
 
 private:
-    std::vector<int32_t> part;
+    StructuredOwnership ownership;  // Owner of each cell, computed on demand
 
-    IndicesIJ num_subdomains;   // Total number of subdomains in each direction
+    int num_parts;              // Total number of subdomains (EMPTY for the number of processes)
 };
 
 #endif //UNBALANCED_WORKLOAD_DECOMPOSITION_H
@@ -20,15 +20,54 @@
  * SOFTWARE.
  */
 
-#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 #include "decompositionMetis.h"
+#include "nativePartitioner.h"
 #include "../../common.h"
 
 int DecompositionMetis::decompose(Graph &graph, int32_t* weights) {
 
+    return decompose(graph, weights, 1, NULL, NULL);
+}
+
+int DecompositionMetis::decompose(Graph &graph, int32_t* weights, int32_t num_constraints,
+                                  real_t* ubvec, real_t* tpwgts) {
+
+    int error = partition(graph, weights, num_constraints, ubvec, tpwgts);
+
+    if (getNumParts() == 1) {
+        std::cout << "Warning! Serial execution, nothing will be done...\n";
+        return EXIT_SUCCESS;
+    }
+
+    if (error == METIS_OK) {
+        assembleProcessGraph(graph);
+        std::cout << "The graph has been successfully partitioned...\n";
+        return EXIT_SUCCESS;
+    }
+    else {
+        std::cout << "Warning! An error code (" << error << ") has been returned "
+                     "by the partitioning algorithm...\n";
+        return EXIT_FAILURE;
+    }
+
+}
+
+int DecompositionMetis::partition(Graph &graph, int32_t* weights, int32_t num_constraints,
+                                  real_t* ubvec, real_t* tpwgts) {
+
+    if (!node_layout.empty() && getNumParts() > 1)
+        return partitionHierarchically(graph, weights, num_constraints, ubvec, tpwgts);
+    return partitionFlat(graph, weights, num_constraints, ubvec, tpwgts, getNumParts(), part);
+}
+
+int DecompositionMetis::partitionFlat(Graph &graph, int32_t* weights, int32_t num_constraints,
+                                      real_t* ubvec, real_t* tpwgts, int32_t num_partitions,
+                                      std::vector<int32_t>& result) {
+
     /* idx_t is a typedef of int32_t used by METIS */
     idx_t ncon;
     idx_t nparts;
@@ -36,99 +75,291 @@ int DecompositionMetis::decompose(Graph &graph, int32_t* weights) {
     idx_t nvtxs;
     idx_t *xadj;
     idx_t *adjncy;
-    int error = METIS_ERROR;
-
-    /*
-     * Hints
-     * Step1: 
-     *  Get data:
-     *   - get the number of nodes in the graph:        graph.getRows()
-     *   - get the raw pointer to the array of offsets: graph.getOffsets().data()
-     *   - get the raw pointer to the adjacency list:   graph.getNodes().data()
-     *   - get the raw pointer to the partitioning:     part.data()
-     *   - get the number of processes:                 getNumprocs()
-     *
-     * Step 2:
-     *   Execute partitioning:
-     *    - keep the number of balancing constraints equal to 1
-     *    - note that `nvtxs` has to be defined
-     */
-    NOT_IMPLEMENTED
-
-    part.resize(nvtxs);
-
-    if (getNumProcs() == 1) {
-        std::cout << "Warning! Serial execution, nothing will be done...\n";
+    idx_t *adjwgt;
+    idx_t options[METIS_NOPTIONS];
 
+    nvtxs = graph.getRows();
+    ncon = num_constraints;
+    nparts = num_partitions;
+    xadj = graph.getOffsets().data();
+    adjncy = graph.getNodes().data();
+    adjwgt = graph.getEdgeWeights().empty() ? NULL : graph.getEdgeWeights().data();
+
+    result.resize(nvtxs);
+
+    if (nparts == 1) {
         for (int n = 0; n < nvtxs; ++n) {
-            part[n] = 0;
+            result[n] = 0;
         }
-        return EXIT_SUCCESS;
+        return METIS_OK;
     }
 
-    // error = METIS_PartGraphKway(...);
-    // Keep the following arguments NULL: 
-    // - the number of balancing constraints is 1
-    // - the size of the vertices for computing the total communication volume
-    // - the weights of the edges
-    // - desired weight for each partition and constraint
-    // - the allowed load imbalance tolerance for each constraint
-    // - an array of options
-    NOT_IMPLEMENTED
+    if (config.native)
+        return partitionNatively(graph, weights, num_constraints, ubvec, tpwgts, nparts, result);
 
-    if (error == METIS_OK) {
-        assembleMapOfProcesses(graph);
-        std::cout << "The graph has been successfully partitioned...\n";
-        return EXIT_SUCCESS;
+    /* Unset options keep their default values */
+    METIS_SetDefaultOptions(options);
+    options[METIS_OPTION_NUMBERING] = 0;
+    if (config.min_volume)
+        options[METIS_OPTION_OBJTYPE] = METIS_OBJTYPE_VOL;
+    if (config.contiguous)
+        options[METIS_OPTION_CONTIG] = 1;
+    if (config.ufactor != EMPTY)
+        options[METIS_OPTION_UFACTOR] = config.ufactor;
+    if (config.niter != EMPTY)
+        options[METIS_OPTION_NITER] = config.niter;
+
+    /* Keep the sizes of vertices default, NULL target weights and tolerances are replaced by
+     * METIS with uniform partitions and 1.03 (1.001 for ncon == 1) respectively. Weights of
+     * edges are used if the graph has them (e.g. read from a file). */
+    if (config.recursive) {
+        return METIS_PartGraphRecursive(&nvtxs, &ncon, xadj, adjncy, weights, NULL, adjwgt, &nparts,
+                                        tpwgts, ubvec, options, &edgecut, result.data());
     }
-    else {
-        std::cout << "Warning! An error code (" << error << ") has been returned "
-                     "by the partitioning algorithm...\n";
-        return EXIT_FAILURE;
+    return METIS_PartGraphKway(&nvtxs, &ncon, xadj, adjncy, weights, NULL, adjwgt, &nparts,
+                               tpwgts, ubvec, options, &edgecut, result.data());
+}
+
+int DecompositionMetis::partitionHierarchically(Graph &graph, int32_t* weights, int32_t num_constraints,
+                                                real_t* ubvec, real_t* tpwgts) {
+
+    int32_t nparts = getNumParts();
+    int32_t num_nodes = 0;
+    std::vector<std::vector<int32_t> > parts_of_nodes;
+    std::vector<std::vector<int32_t> > vertices_of_nodes;
+    std::vector<real_t> node_tpwgts;
+    std::vector<int32_t> node_part;
+    std::vector<int32_t> flat_part;
+    int64_t cut, node_cut, flat_cut, flat_node_cut;
+    int error;
+
+    if ((int32_t) node_layout.size() != nparts) {
+        std::cerr << "Error! The node layout has " << node_layout.size() << " partitions instead of "
+                  << nparts << "..." << std::endl;
+        return METIS_ERROR_INPUT;
+    }
+
+    for (int32_t pid = 0; pid < nparts; ++pid)
+        num_nodes = std::max(num_nodes, node_layout[pid] + 1);
+    parts_of_nodes.resize(num_nodes);
+    for (int32_t pid = 0; pid < nparts; ++pid)
+        parts_of_nodes[node_layout[pid]].push_back(pid);
+
+    /* Each node gets the sum of the targets of its partitions */
+    node_tpwgts.assign((int64_t) num_nodes * num_constraints, 0.);
+    for (int32_t pid = 0; pid < nparts; ++pid) {
+        for (int32_t con = 0; con < num_constraints; ++con) {
+            node_tpwgts[(int64_t) node_layout[pid] * num_constraints + con]
+                    += (tpwgts != NULL) ? tpwgts[(int64_t) pid * num_constraints + con] : 1. / nparts;
+        }
+    }
+
+    error = partitionFlat(graph, weights, num_constraints, ubvec, node_tpwgts.data(), num_nodes, node_part);
+    if (error != METIS_OK)
+        return error;
+
+    /* Bucket the vertices by node in a single pass, in ascending order within each node */
+    vertices_of_nodes.resize(num_nodes);
+    for (int32_t v = 0; v < graph.getRows(); ++v)
+        vertices_of_nodes[node_part[v]].push_back(v);
+
+    /* Split the subgraph of each node into its partitions */
+    part.resize(graph.getRows());
+    for (int32_t node = 0; node < num_nodes; ++node) {
+        std::vector<int32_t> &parts = parts_of_nodes[node];
+        std::vector<int32_t> &vertices = vertices_of_nodes[node];
+        std::vector<int32_t> sub_weights;
+        std::vector<real_t> sub_tpwgts;
+        std::vector<int32_t> sub_part;
+        Graph subgraph(ADJ_LIST);
+
+        if (vertices.empty())
+            continue;
+
+        graph.extractSubgraph(vertices, subgraph);
+        for (size_t n = 0; n < vertices.size(); ++n) {
+            for (int32_t con = 0; con < num_constraints; ++con)
+                sub_weights.push_back(weights[(int64_t) vertices[n] * num_constraints + con]);
+        }
+        for (size_t n = 0; n < parts.size(); ++n) {
+            for (int32_t con = 0; con < num_constraints; ++con) {
+                real_t target = (tpwgts != NULL) ? tpwgts[(int64_t) parts[n] * num_constraints + con] : 1. / nparts;
+                sub_tpwgts.push_back(target / node_tpwgts[(int64_t) node * num_constraints + con]);
+            }
+        }
+
+        error = partitionFlat(subgraph, sub_weights.data(), num_constraints, ubvec, sub_tpwgts.data(),
+                              parts.size(), sub_part);
+        if (error != METIS_OK)
+            return error;
+        for (size_t n = 0; n < vertices.size(); ++n)
+            part[vertices[n]] = parts[sub_part[n]];
     }
 
+    /* Compare with the flat partitioning, which does not know about the nodes */
+    error = partitionFlat(graph, weights, num_constraints, ubvec, tpwgts, nparts, flat_part);
+    if (error != METIS_OK)
+        return error;
+    computeCuts(graph, part, cut, node_cut);
+    computeCuts(graph, flat_part, flat_cut, flat_node_cut);
+    std::cout << "Node-aware partitioning (nodes: " << num_nodes << "): inter-node cut " << node_cut
+              << " (flat k-way " << flat_node_cut << "), total cut " << cut << " (flat k-way " << flat_cut << ")\n";
+    return METIS_OK;
 }
 
-void  DecompositionMetis::assembleMapOfProcesses(Graph &graph) {
+void DecompositionMetis::computeCuts(Graph &graph, const std::vector<int32_t>& partitioning, int64_t& cut,
+                                     int64_t& node_cut) {
 
-    // Traverse through the partitioned domain and check for neighbors with a different PIDs
+    bool has_weights = !graph.getEdgeWeights().empty();
+
+    /* Each edge is stored twice */
+    cut = 0;
+    node_cut = 0;
     for (int32_t row = 0; row < graph.getRows(); ++row) {
-        int current_rank = part[row];
         for (int32_t ckey = graph.getOffsets()[row]; ckey < graph.getOffsets()[row + 1]; ++ckey) {
-            int node = graph.getNodes()[ckey];
-            int ngb_rank = part[node];
-            if (ngb_rank != current_rank) {
-                map_of_procs[current_rank].push_back(ngb_rank);
+            int32_t ngb = graph.getNodes()[ckey];
+            int64_t weight = has_weights ? graph.getEdgeWeights()[ckey] : 1;
+            if (partitioning[row] == partitioning[ngb])
+                continue;
+            cut += weight;
+            if (node_layout[partitioning[row]] != node_layout[partitioning[ngb]])
+                node_cut += weight;
+        }
+    }
+    cut /= 2;
+    node_cut /= 2;
+}
+
+int DecompositionMetis::partitionNatively(Graph &graph, int32_t* weights, int32_t num_constraints,
+                                          real_t* ubvec, real_t* tpwgts, int32_t nparts,
+                                          std::vector<int32_t>& result) {
+
+    NativePartitioner partitioner;
+    std::vector<int32_t> first_weights;
+    std::vector<double> fractions;
+    double start = getWallTime();
+
+    if (num_constraints > 1) {
+        std::cout << "Warning! The native partitioner balances the first constraint only...\n";
+        first_weights.resize(graph.getRows());
+        for (int32_t n = 0; n < graph.getRows(); ++n)
+            first_weights[n] = weights[(int64_t) n * num_constraints];
+        weights = first_weights.data();
+    }
+    if (tpwgts != NULL) {
+        for (int32_t pid = 0; pid < nparts; ++pid)
+            fractions.push_back(tpwgts[pid * num_constraints]);
+    }
+
+    if (ubvec != NULL)
+        partitioner.setTolerance(ubvec[0]);
+    else if (config.ufactor != EMPTY)
+        partitioner.setTolerance(1. + config.ufactor / 1000.);
+    if (config.niter != EMPTY)
+        partitioner.setNumRounds(config.niter);
+
+    if (partitioner.partition(graph, weights, nparts, fractions, result) == EXIT_FAILURE)
+        return METIS_ERROR_INPUT;
+
+    std::cout << "Native partitioner: " << partitioner.getNumLevels() << " levels, edge cut "
+              << partitioner.getEdgeCut() << ", " << getWallTime() - start << "s\n";
+    return METIS_OK;
+}
+
+void DecompositionMetis::reportBalance(int32_t* weights, int32_t ncon, real_t* tpwgts) {
+
+    int32_t nparts = getNumParts();
+    std::vector<double> part_weights((int64_t) nparts * ncon, 0.);
+    std::vector<double> total(ncon, 0.);
+
+    if (part.empty())
+        return;
+
+    for (size_t n = 0; n < part.size(); ++n) {
+        for (int32_t con = 0; con < ncon; ++con) {
+            part_weights[(int64_t) part[n] * ncon + con] += weights[(int64_t) n * ncon + con];
+            total[con] += weights[(int64_t) n * ncon + con];
+        }
+    }
+
+    std::cout << "Achieved balance (max. weight / target weight):\n";
+    for (int32_t con = 0; con < ncon; ++con) {
+        double imbalance = 0.;
+        int32_t worst = 0;
+        for (int32_t pid = 0; pid < nparts; ++pid) {
+            double target = total[con] * ((tpwgts != NULL) ? tpwgts[pid * ncon + con] : 1. / nparts);
+            double ratio = (target > 0.) ? part_weights[(int64_t) pid * ncon + con] / target : 0.;
+            if (ratio > imbalance) {
+                imbalance = ratio;
+                worst = pid;
             }
         }
+        std::cout << "  constraint " << con << ": " << imbalance << " (partition " << worst << ")\n";
     }
+}
 
-    // Remove all duplicates
-    for (auto it = map_of_procs.begin(); it != map_of_procs.end(); ++it) {
-        int32_t id = it->first;
-        std::sort(map_of_procs[id].begin(), map_of_procs[id].end());
-        map_of_procs[id].erase(std::unique(map_of_procs[id].begin(),
-                                                map_of_procs[id].end()),
-                               map_of_procs[id].end());
+void DecompositionMetis::assembleProcessGraph(Graph &graph) {
+
+    process_graph.build(graph, part.data(), getNumParts());
+}
+
+void DecompositionMetis::reportLinks(int num_components, int value_size) {
+
+    int32_t max_src = EMPTY, max_dst = EMPTY, max_cells = 0;
+    int32_t min_src = EMPTY, min_dst = EMPTY, min_cells = 0;
+    int64_t num_links = 0;
+    int64_t cell_bytes = (int64_t) num_components * value_size;
+
+    for (int32_t pid = 0; pid < process_graph.getNumProcs(); ++pid) {
+        int32_t *ngbs = process_graph.getNeighbors(pid);
+        int32_t *cells = process_graph.getCells(pid);
+        for (int32_t n = 0; n < process_graph.getNumNeighbors(pid); ++n) {
+            if (max_src == EMPTY || cells[n] > max_cells) {
+                max_src = pid; max_dst = ngbs[n]; max_cells = cells[n];
+            }
+            if (min_src == EMPTY || cells[n] < min_cells) {
+                min_src = pid; min_dst = ngbs[n]; min_cells = cells[n];
+            }
+            ++num_links;
+        }
+    }
+
+    if (num_links == 0) {
+        std::cout << "There are no links between processes...\n";
+        return;
     }
+
+    std::cout << "Number of directed links: " << num_links << "\n"
+              << "Heaviest link: " << max_src << " -> " << max_dst << ", " << max_cells
+              << " cells (" << max_cells * cell_bytes << " bytes)\n"
+              << "Lightest link: " << min_src << " -> " << min_dst << ", " << min_cells
+              << " cells (" << min_cells * cell_bytes << " bytes)\n";
 }
 
 void DecompositionMetis::print(const std::string file_name, const IndicesIJ elts_glob) {
 
+    print(file_name, IndicesIJK(elts_glob));
+}
+
+void DecompositionMetis::print(const std::string file_name, const IndicesIJK elts_glob) {
+
     if (!part.empty()) {
         std::ofstream out_str;
-        int32_t id = 0;
+        int64_t id = 0;
 
         out_str.open(file_name, std::ios::out);
 
         if (out_str.is_open()) {
-            out_str << "\n";
-            for (int32_t j = 0; j < elts_glob.j; ++j) {
-                for (int32_t i = 0; i < elts_glob.i; ++i) {
-                    id = j + elts_glob.j * i;
-                    out_str << part[id] << " ";
-                }
+            /* Print layer by layer in k-th direction */
+            for (int32_t k = 0; k < elts_glob.k; ++k) {
                 out_str << "\n";
+                for (int32_t j = 0; j < elts_glob.j; ++j) {
+                    for (int32_t i = 0; i < elts_glob.i; ++i) {
+                        id = k + elts_glob.k * (j + (int64_t) elts_glob.j * i);
+                        out_str << part[id] << " ";
+                    }
+                    out_str << "\n";
+                }
             }
             out_str << "\n";
         }
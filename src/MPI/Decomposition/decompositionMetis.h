@@ -24,36 +24,156 @@
 #define UNBALANCED_WORKLOAD_DECOMPOSITIONMETIS_H
 
 #include <metis.h>
-#include <map>
 #include <vector>
 
 #include "../../graph.h"
+#include "../../processGraph.h"
 #include "../../field.h"
 
+/*!
+ * @brief Options passed to METIS, the defaults of METIS are used for unset (EMPTY) values.
+ */
+struct MetisConfig {
+    bool recursive = false;     // Use recursive bisection instead of the k-way partitioning
+    bool min_volume = false;    // Minimize the total communication volume instead of the edge cut
+    bool contiguous = false;    // Force contiguous partitions
+    int ufactor = EMPTY;        // Allowed load imbalance, 1 + ufactor / 1000
+    int niter = EMPTY;          // Number of refinement iterations
+    bool native = false;        // Use the built-in multilevel partitioner (see NativePartitioner) instead of METIS
+};
+
 class DecompositionMetis {
+    friend class Autotuner;
 public:
-    DecompositionMetis() { }
+    DecompositionMetis() : num_parts(EMPTY) { }
 
     ~DecompositionMetis() { part.clear(); }
 
     int decompose(Graph& graph, int32_t* weights);
 
+    /*!
+     * @brief Decompose the graph balancing several constraints at once.
+     * @param graph Graph to be partitioned.
+     * @param weights Weights of vertices, \e ncon consecutive values per vertex.
+     * @param ncon Number of balancing constraints.
+     * @param ubvec Allowed load imbalance for each constraint, e.g. 1.05 (NULL for default).
+     * @param tpwgts Desired fraction of each constraint for each partition, \e ncon consecutive
+     *               values per partition; fractions of each constraint sum up to 1 (NULL for uniform).
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int decompose(Graph& graph, int32_t* weights, int32_t ncon, real_t* ubvec, real_t* tpwgts);
+
+    /*!
+     * @brief Print the achieved balance of each constraint.
+     * The imbalance is the maximum ratio between the weight of a partition and its target weight.
+     * @param weights Weights of vertices, \e ncon consecutive values per vertex.
+     * @param ncon Number of balancing constraints.
+     * @param tpwgts Desired fraction of each constraint for each partition (NULL for uniform).
+     */
+    void reportBalance(int32_t* weights, int32_t ncon, real_t* tpwgts);
+
+    /*!
+     * @brief Set options of METIS used by the subsequent decompositions.
+     */
+    inline void setConfig(const MetisConfig &new_config) {
+        config = new_config;
+    }
+
+    inline MetisConfig& getConfig() {
+        return config;
+    }
+
+    /*!
+     * @brief Set number of subdomains, e.g. for a dry run (the number of processes by default).
+     */
+    inline void setNumParts(int parts) {
+        num_parts = parts;
+    }
+
+    /*!
+     * @brief Partition the graph into the nodes first and into the partitions of each node second,
+     * instead of into all partitions at once. The partitions of a node get adjacent subdomains.
+     * @param node_of_parts Node of each partition (empty for the flat partitioning).
+     */
+    inline void setNodeLayout(const std::vector<int32_t>& node_of_parts) {
+        node_layout = node_of_parts;
+    }
+
+    /*!
+     * @brief Get number of subdomains.
+     */
+    inline int getNumParts() {
+        return (num_parts != EMPTY) ? num_parts : getNumProcs();
+    }
+
     void print(const std::string file_name, const IndicesIJ elts_glob);
 
+    void print(const std::string file_name, const IndicesIJK elts_glob);
+
     inline std::vector<int32_t>& getPartitioning() {
         return part;
     }
 
-    inline std::map<int32_t, std::vector<int32_t> >& getMapOfProcs() {
-        return map_of_procs;
+    /*!
+     * @brief Get connectivity between processes.
+     * Weights of the graph are the numbers of faces shared by each pair of processes, the numbers
+     * of cells sent to each neighbor, i.e. the halo message sizes (in cells), are stored as well.
+     */
+    inline ProcessGraph& getProcessGraph() {
+        return process_graph;
     }
 
+    /*!
+     * @brief Print the heaviest and the lightest links between processes, i.e. the largest and the
+     * smallest halo messages.
+     * @param num_components Number of values of each cell.
+     * @param value_size Size of a value on the wire, in bytes.
+     */
+    void reportLinks(int num_components, int value_size);
+
 private:
-    void assembleMapOfProcesses(Graph &graph);
+    /*!
+     * @brief Call METIS with the current configuration, the graph of processes is not assembled.
+     * @return Returns METIS_OK on success and an error code of METIS otherwise.
+     */
+    int partition(Graph& graph, int32_t* weights, int32_t ncon, real_t* ubvec, real_t* tpwgts);
+
+    /*!
+     * @brief Partition the graph into \e nparts partitions at once.
+     * @param result [out] Partition of each vertex.
+     */
+    int partitionFlat(Graph& graph, int32_t* weights, int32_t ncon, real_t* ubvec, real_t* tpwgts,
+                      int32_t nparts, std::vector<int32_t>& result);
+
+    /*!
+     * @brief Partition the graph into the nodes, then the subgraph of each node into its partitions.
+     * The target weight of a node is the sum of the ones of its partitions. The cut between the
+     * nodes is reported along with the one of the flat partitioning.
+     */
+    int partitionHierarchically(Graph& graph, int32_t* weights, int32_t ncon, real_t* ubvec, real_t* tpwgts);
+
+    /*!
+     * @brief Call the built-in partitioner, it balances the first constraint only.
+     * The tolerance and the number of refinement rounds are taken from \e ubvec (or \e ufactor)
+     * and \e niter respectively, other options of METIS are ignored.
+     * @return Returns METIS_OK on success and METIS_ERROR_INPUT otherwise.
+     */
+    int partitionNatively(Graph& graph, int32_t* weights, int32_t ncon, real_t* ubvec, real_t* tpwgts,
+                          int32_t nparts, std::vector<int32_t>& result);
+
+    /*!
+     * @brief Compute the total weight of the cut edges and of the ones cut between the nodes.
+     */
+    void computeCuts(Graph& graph, const std::vector<int32_t>& partitioning, int64_t& cut, int64_t& node_cut);
+
+    void assembleProcessGraph(Graph &graph);
 
 private:
-    std::map<int32_t, std::vector<int32_t> > map_of_procs;
+    ProcessGraph process_graph;   // connectivity between partitions
     std::vector<int32_t> part;    // partitions
+    MetisConfig config;           // options of METIS
+    int num_parts;                // number of partitions (EMPTY for the number of processes)
+    std::vector<int32_t> node_layout;     // node of each partition (empty for the flat partitioning)
 };
 
 
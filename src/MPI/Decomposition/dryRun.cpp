@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <utility>
+
+#include "dryRun.h"
+
+void DryRun::calibrateNetwork(const std::string file_name) {
+
+    const int num_sizes = 8;
+    const int num_repeats = 20;
+    int64_t sizes[num_sizes] = {8, 64, 512, 4096, 32768, 262144, 1048576, 4194304};
+    double times[num_sizes];
+    double values[2] = {0., 0.};
+    int my_rank = getMyRank();
+    int partner = (getNumProcs() > 1) ? 1 - my_rank : my_rank;
+    std::ifstream in_str(file_name);
+
+    /* All processes have to agree on skipping the ping-pong */
+    if (my_rank == 0 && !(in_str >> values[0] >> values[1]))
+        values[0] = values[1] = 0.;
+    MPI_Bcast(values, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (values[0] > 0. && values[1] > 0.) {
+        latency = values[0];
+        bandwidth = values[1];
+        printByRoot("Network: latency " + std::to_string(latency * 1.e6) + "us, bandwidth "
+                    + std::to_string(bandwidth / 1.e9) + "GB/s (read from " + file_name + ")");
+        return;
+    }
+
+    if (getNumProcs() == 1)
+        printByRoot("Warning! A single process measures messages to itself, put the values of the "
+                    "target machine into " + file_name + "...");
+
+    /* Processes other than 0 and 1 only wait */
+    if (my_rank < 2) {
+        std::vector<char> buffer(sizes[num_sizes - 1]);
+        std::vector<char> echo(sizes[num_sizes - 1]);
+        for (int s = 0; s < num_sizes; ++s) {
+            int tag = 171;
+            double start = getWallTime();
+            for (int r = 0; r < num_repeats; ++r) {
+                if (my_rank == 0) {
+                    MPI_Sendrecv(buffer.data(), sizes[s], MPI_BYTE, partner, tag,
+                                 echo.data(), sizes[s], MPI_BYTE, partner, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                }
+                else {
+                    MPI_Recv(echo.data(), sizes[s], MPI_BYTE, partner, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                    MPI_Send(echo.data(), sizes[s], MPI_BYTE, partner, tag, MPI_COMM_WORLD);
+                }
+            }
+            /* A round trip consists of two messages */
+            times[s] = (getWallTime() - start) / num_repeats / 2.;
+        }
+    }
+
+    /* The smallest message gives the latency, the largest one the bandwidth */
+    if (my_rank == 0) {
+        values[0] = times[0];
+        values[1] = sizes[num_sizes - 1] / std::max(times[num_sizes - 1] - times[0], 1.e-12);
+        std::ofstream out_str(file_name);
+        out_str << std::setprecision(6) << values[0] << " " << values[1] << "\n";
+    }
+    MPI_Bcast(values, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    latency = values[0];
+    bandwidth = values[1];
+
+    printByRoot("Network: latency " + std::to_string(latency * 1.e6) + "us, bandwidth "
+                + std::to_string(bandwidth / 1.e9) + "GB/s (stored in " + file_name + ")");
+}
+
+void DryRun::predict(Graph &graph, Field &field, const int32_t* part, int num_parts, WeightModel &model,
+                     int value_size) {
+
+    predict(graph, field, [part](int32_t cell) { return part[cell]; }, num_parts, model, value_size);
+}
+
+void DryRun::predict(Graph &graph, Field &field, const StructuredOwnership &ownership, WeightModel &model,
+                     int value_size) {
+
+    predict(graph, field, [&ownership](int32_t cell) { return (int32_t) ownership.getOwner((int64_t) cell); },
+            ownership.getNumParts(), model, value_size);
+}
+
+void DryRun::predict(Graph &graph, Field &field, const std::function<int32_t(int32_t)> &get_part, int num_parts,
+                     WeightModel &model, int value_size) {
+
+    int32_t *offsets = graph.getOffsets().data();
+    int32_t *nodes = graph.getNodes().data();
+    int64_t cell_bytes = (int64_t) field.getNumComponents() * value_size;
+    std::vector<PartCost> costs(num_parts);
+    std::vector<std::vector<std::pair<int32_t, int64_t> > > messages(num_parts);  // (destination, bytes)
+    std::vector<int32_t> foreign;
+
+    /* Each cell is sent once to each neighboring subdomain, as in the halo exchange */
+    for (int32_t n = 0; n < graph.getRows(); ++n) {
+        double cost = model.getCost(field, field(n));
+        int32_t owner = get_part(n);
+
+        foreign.clear();
+        for (int32_t pos = offsets[n]; pos < offsets[n + 1]; ++pos) {
+            int32_t pid = get_part(nodes[pos]);
+            if (pid != owner && std::find(foreign.begin(), foreign.end(), pid) == foreign.end())
+                foreign.push_back(pid);
+        }
+
+        if (foreign.empty())
+            costs[owner].interior += cost;
+        else
+            costs[owner].boundary += cost;
+        for (size_t f = 0; f < foreign.size(); ++f)
+            messages[owner].push_back(std::make_pair(foreign[f], cell_bytes));
+    }
+
+    /* Merge the sent cells into a message per neighbor */
+    for (int32_t pid = 0; pid < num_parts; ++pid) {
+        std::vector<std::pair<int32_t, int64_t> > &msgs = messages[pid];
+        std::sort(msgs.begin(), msgs.end());
+        for (size_t m = 0; m < msgs.size(); ) {
+            int32_t dest = msgs[m].first;
+            int64_t num_bytes = 0;
+            for (; m < msgs.size() && msgs[m].first == dest; ++m)
+                num_bytes += msgs[m].second;
+            costs[pid].send += getMessageTime(num_bytes);
+            costs[dest].recv += getMessageTime(num_bytes);
+            costs[pid].num_messages++;
+            costs[pid].num_bytes += num_bytes;
+        }
+    }
+
+    /* Summary and the critical path */
+    int32_t critical = 0;
+    double sum_compute = 0., max_compute = 0., sum_halo = 0., max_halo = 0.;
+    std::ofstream out_str("dry_run.dat");
+    out_str << "# rank interior boundary halo messages bytes step (in seconds and bytes)\n";
+    for (int32_t pid = 0; pid < num_parts; ++pid) {
+        PartCost &c = costs[pid];
+        sum_compute += c.interior + c.boundary;
+        max_compute = std::max(max_compute, c.interior + c.boundary);
+        sum_halo += c.getHalo();
+        max_halo = std::max(max_halo, c.getHalo());
+        if (c.getStep() > costs[critical].getStep())
+            critical = pid;
+        out_str << pid << " " << c.interior << " " << c.boundary << " " << c.getHalo() << " "
+                << c.num_messages << " " << c.num_bytes << " " << c.getStep() << "\n";
+    }
+
+    PartCost &c = costs[critical];
+    double avg_compute = sum_compute / num_parts;
+    std::cout << "Dry run for " << num_parts << " processes:\n"
+              << "  compute: " << avg_compute << "s on average, " << max_compute << "s at most (imbalance "
+              << ((avg_compute > 0.) ? max_compute / avg_compute : 1.) << ")\n"
+              << "  halo:    " << sum_halo / num_parts << "s on average, " << max_halo << "s at most\n"
+              << "  step:    " << c.getStep() << "s, parallel efficiency "
+              << ((c.getStep() > 0.) ? 100. * avg_compute / c.getStep() : 100.) << "%\n"
+              << "  critical path: rank " << critical << ", interior " << c.interior << "s, boundary "
+              << c.boundary << "s, halo " << c.getHalo() << "s (" << c.num_messages << " messages, "
+              << c.num_bytes << " bytes)\n"
+              << "Predictions of all processes are written to dry_run.dat\n";
+}
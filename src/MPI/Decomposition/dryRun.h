@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_DRYRUN_H
+#define UNBALANCED_WORKLOAD_DRYRUN_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "../../common.h"
+#include "../../field.h"
+#include "../../graph.h"
+#include "../../weightModel.h"
+#include "structuredOwnership.h"
+
+/*!
+ * \class DryRun
+ * @brief Predicts the time step of a decomposition for any number of processes without running it.
+ * The compute time of a subdomain is the sum of the calibrated costs of its cells (see
+ * \e WeightModel), the halo time is given by the latency and bandwidth of point-to-point
+ * messages measured by a ping-pong:
+ *   halo = max(sum over sent messages, sum over received messages) of (latency + bytes / bandwidth).
+ * As in the time-stepping driver, the exchange overlaps the work on the interior cells:
+ *   step = max(interior, halo) + boundary.
+ * The slowest subdomain is the critical path of a step.
+ */
+class DryRun {
+public:
+    DryRun() : latency(0.), bandwidth(1.) { }
+
+    ~DryRun() { }
+
+    /*!
+     * @brief Measure latency and bandwidth, or read them from the file of a previous calibration.
+     * The ping-pong is run by processes 0 and 1, a single process sends messages to itself.
+     * Values of the target machine can be put into the file manually. Must be called by all processes.
+     * @param file_name File storing "latency bandwidth" (in s and bytes/s).
+     */
+    void calibrateNetwork(const std::string file_name);
+
+    /*!
+     * @brief Predict and print the time step of each subdomain.
+     * Predictions of all subdomains are written to the file "dry_run.dat".
+     * @param graph Graph of the whole domain.
+     * @param field Global field.
+     * @param part Subdomain of each cell.
+     * @param num_parts Number of subdomains.
+     * @param model Calibrated cost of cells.
+     * @param value_size Size of a field value in messages (see \e WireFormat).
+     */
+    void predict(Graph &graph, Field &field, const int32_t* part, int num_parts, WeightModel &model,
+                 int value_size);
+
+    /*!
+     * @brief Predict the time step of the structured decomposition, the subdomain of each cell is
+     * computed from \e ownership instead of being stored.
+     */
+    void predict(Graph &graph, Field &field, const StructuredOwnership &ownership, WeightModel &model,
+                 int value_size);
+
+    inline double getLatency() {
+        return latency;
+    }
+
+    inline double getBandwidth() {
+        return bandwidth;
+    }
+
+private:
+    /*!
+     * @brief Predict the time step, see \e predict().
+     * @param get_part Gets the subdomain of the cell.
+     */
+    void predict(Graph &graph, Field &field, const std::function<int32_t(int32_t)> &get_part, int num_parts,
+                 WeightModel &model, int value_size);
+
+    /*!
+     * @brief Predicted costs of a subdomain (in seconds).
+     */
+    struct PartCost {
+        double interior = 0.;       // Work on cells without foreign neighbors
+        double boundary = 0.;       // Work on cells with foreign neighbors
+        double send = 0.;
+        double recv = 0.;
+        int num_messages = 0;
+        int64_t num_bytes = 0;      // Sent bytes
+
+        inline double getHalo() const {
+            return std::max(send, recv);
+        }
+
+        inline double getStep() const {
+            return std::max(interior, getHalo()) + boundary;
+        }
+    };
+
+    /*!
+     * @brief Get time of a single message.
+     */
+    inline double getMessageTime(int64_t num_bytes) {
+        return latency + num_bytes / bandwidth;
+    }
+
+private:
+    double latency;         // Time of an empty message (s)
+    double bandwidth;       // Bytes per second
+};
+
+#endif //UNBALANCED_WORKLOAD_DRYRUN_H
@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <cmath>
+#include <cstdlib>
+
+#include "incrementalRefiner.h"
+
+void IncrementalRefiner::initialize(Graph& graph, const int32_t* partitioning, int32_t parts,
+                                    const int32_t* weights, int32_t ncon, const std::vector<double>& fractions) {
+
+    int32_t size = graph.getRows();
+    double sum = 0.;
+
+    this->graph = &graph;
+    num_parts = parts;
+    targets = fractions;
+    if ((int32_t) targets.size() != num_parts)
+        targets.assign(num_parts, 1.);
+    for (int32_t p = 0; p < num_parts; ++p)
+        sum += targets[p];
+    for (int32_t p = 0; p < num_parts; ++p)
+        targets[p] /= sum;
+
+    part.assign(partitioning, partitioning + size);
+    locked.assign(size, 0);
+    queued.assign(size, 0);
+    gains.resize(size);
+    destinations.resize(size);
+    origins.assign(size, EMPTY);
+    in_boundary.resize(size);
+    this->weights.resize(size);
+
+    #pragma omp parallel for schedule(static)
+    for (int32_t v = 0; v < size; ++v) {
+        in_boundary[v] = isBoundary(v);
+        this->weights[v] = weights[(int64_t) v * ncon];
+    }
+
+    boundary.clear();
+    for (int32_t v = 0; v < size; ++v) {
+        if (in_boundary[v])
+            boundary.push_back(v);
+    }
+
+    /* The weights of partitions are updated by the moves and by updateWeight() from now on */
+    part_weights.assign(num_parts, 0);
+    max_vertex = 0;
+    #pragma omp parallel
+    {
+        std::vector<int64_t> local_weights(num_parts, 0);
+        int64_t local_max = 0;
+
+        #pragma omp for schedule(static) nowait
+        for (int32_t v = 0; v < size; ++v) {
+            local_weights[part[v]] += getWeight(v);
+            local_max = std::max(local_max, getWeight(v));
+        }
+
+        #pragma omp critical
+        {
+            for (int32_t p = 0; p < num_parts; ++p)
+                part_weights[p] += local_weights[p];
+            max_vertex = std::max(max_vertex, local_max);
+        }
+    }
+
+    total = 0;
+    for (int32_t p = 0; p < num_parts; ++p)
+        total += part_weights[p];
+    limits.resize(num_parts);
+    caps.resize(num_parts);
+}
+
+void IncrementalRefiner::updateWeight(int32_t v, int32_t weight) {
+
+    part_weights[part[v]] += weight - weights[v];
+    total += weight - weights[v];
+    weights[v] = weight;
+    max_vertex = std::max<int64_t>(max_vertex, weight);
+}
+
+int IncrementalRefiner::refine(std::vector<Migration>& migrations) {
+
+    int64_t violation = 0;
+
+    cut_change = 0;
+    num_visited = 0;
+    migrations.clear();
+
+    /* No move may bring a partition above both the tolerance and its current weight */
+    setLimits(false);
+    for (int32_t p = 0; p < num_parts; ++p) {
+        caps[p] = std::max(limits[p], part_weights[p]);
+        violation += getOverweight(p);
+    }
+
+    /* Drop the cells which became interior since the last refinement */
+    size_t num_boundary = 0;
+    for (size_t n = 0; n < boundary.size(); ++n) {
+        int32_t v = boundary[n];
+        if (isBoundary(v))
+            boundary[num_boundary++] = v;
+        else
+            in_boundary[v] = 0;
+    }
+    boundary.resize(num_boundary);
+    num_visited += num_boundary;
+
+    /* Moves of a round might cut a partition off the one it should send the weight to */
+    for (int round = 0; round < max_diffusion_rounds && violation > 0; ++round) {
+        diffuse();
+        violation = 0;
+        for (int32_t p = 0; p < num_parts; ++p)
+            violation += getOverweight(p);
+    }
+    violation = runPasses(violation);
+
+    /* The cells are too coarse for the tolerance, the cut is still refined within the relaxed limits */
+    if (violation > 0) {
+        setLimits(true);
+        violation = 0;
+        for (int32_t p = 0; p < num_parts; ++p)
+            violation += getOverweight(p);
+        runPasses(violation);
+    }
+
+    /* Cells moved back and forth stay where they were */
+    std::sort(touched.begin(), touched.end());
+    for (size_t n = 0; n < touched.size(); ++n) {
+        int32_t v = touched[n];
+        if (part[v] != origins[v]) {
+            Migration migration = {v, origins[v], part[v]};
+            migrations.push_back(migration);
+        }
+        origins[v] = EMPTY;
+    }
+    touched.clear();
+
+    /* The result is judged by the tolerance, not by the relaxed limits */
+    setLimits(false);
+    violation = 0;
+    imbalance = 0.;
+    for (int32_t p = 0; p < num_parts; ++p) {
+        violation += getOverweight(p);
+        if (targets[p] > 0.)
+            imbalance = std::max(imbalance, part_weights[p] / (targets[p] * total));
+    }
+
+    return (violation == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int64_t IncrementalRefiner::runPasses(int64_t violation) {
+
+    std::vector<std::pair<int32_t, int32_t> > moves;    // (vertex, previous partition)
+
+    for (int pass = 0; pass < num_passes; ++pass) {
+        int64_t change = 0;
+        int64_t best_change = 0;
+        int64_t best_violation = violation;
+        int32_t since_best = 0;
+        size_t best_moves = 0;
+
+        queue.clear();
+        moves.clear();
+        size_t num_boundary = boundary.size();
+        for (size_t n = 0; n < num_boundary; ++n) {
+            int32_t v = boundary[n];
+            if (findMove(v, destinations[v], gains[v])) {
+                queue.insert(std::make_pair(-gains[v], v));
+                queued[v] = 1;
+            }
+        }
+
+        /* A pass stops after this number of moves without an improvement */
+        int32_t max_idle_moves = std::min<int32_t>(std::max<int32_t>(num_boundary / 100, 50), 500);
+
+        while (!queue.empty() && since_best < max_idle_moves) {
+            int32_t v = queue.begin()->second;
+            int32_t target;
+            int64_t gain;
+
+            queue.erase(queue.begin());
+            queued[v] = 0;
+
+            /* Weights of partitions might have changed since the move was found */
+            if (!findMove(v, target, gain))
+                continue;
+            if (target != destinations[v] || gain != gains[v]) {
+                destinations[v] = target;
+                gains[v] = gain;
+                queue.insert(std::make_pair(-gain, v));
+                queued[v] = 1;
+                continue;
+            }
+
+            int32_t from = part[v];
+            violation -= getOverweight(from) + getOverweight(target);
+            moveCell(v, target);
+            violation += getOverweight(from) + getOverweight(target);
+            locked[v] = 1;
+            change -= gain;
+            moves.push_back(std::make_pair(v, from));
+
+            /* Neighbors might have become boundary cells, their moves have changed */
+            for (int32_t pos = graph->getOffsets()[v]; pos < graph->getOffsets()[v + 1]; ++pos) {
+                int32_t u = graph->getNodes()[pos];
+                updateBoundary(u);
+                if (locked[u])
+                    continue;
+                if (queued[u]) {
+                    queue.erase(std::make_pair(-gains[u], u));
+                    queued[u] = 0;
+                }
+                if (findMove(u, destinations[u], gains[u])) {
+                    queue.insert(std::make_pair(-gains[u], u));
+                    queued[u] = 1;
+                }
+            }
+
+            if (violation < best_violation || (violation == best_violation && change < best_change)) {
+                best_change = change;
+                best_violation = violation;
+                best_moves = moves.size();
+                since_best = 0;
+            }
+            else {
+                ++since_best;
+            }
+        }
+
+        /* Roll back the moves made after the best state */
+        for (size_t n = moves.size(); n > best_moves; --n) {
+            int32_t v = moves[n - 1].first;
+            part_weights[part[v]] -= getWeight(v);
+            part_weights[moves[n - 1].second] += getWeight(v);
+            part[v] = moves[n - 1].second;
+        }
+        for (size_t n = 0; n < moves.size(); ++n)
+            locked[moves[n].first] = 0;
+        for (std::set<std::pair<int64_t, int32_t> >::iterator it = queue.begin(); it != queue.end(); ++it)
+            queued[it->second] = 0;
+        violation = best_violation;
+        cut_change += best_change;
+
+        if (best_moves == 0)
+            break;
+    }
+
+    return violation;
+}
+
+void IncrementalRefiner::setLimits(bool relaxed) {
+
+    for (int32_t p = 0; p < num_parts; ++p) {
+        limits[p] = (int64_t) (tolerance * targets[p] * total);
+        if (relaxed)
+            limits[p] = std::max(limits[p], (int64_t) std::ceil(targets[p] * total) + max_vertex);
+    }
+}
+
+void IncrementalRefiner::diffuse() {
+
+    std::vector<std::vector<int32_t> > cells(num_parts);    // Boundary cells of each partition
+    std::vector<std::pair<int32_t, int32_t> > pairs;        // Neighboring partitions (p < q)
+    std::vector<double> flows;                              // Flow of weight from p to q of each pair
+    std::vector<double> excess(num_parts);
+    std::vector<int32_t> degrees(num_parts, 0);
+
+    /* Graph of partitions */
+    for (size_t n = 0; n < boundary.size(); ++n) {
+        int32_t v = boundary[n];
+        cells[part[v]].push_back(v);
+        for (int32_t pos = graph->getOffsets()[v]; pos < graph->getOffsets()[v + 1]; ++pos) {
+            int32_t p = part[v];
+            int32_t q = part[graph->getNodes()[pos]];
+            if (p < q)
+                pairs.push_back(std::make_pair(p, q));
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+    flows.assign(pairs.size(), 0.);
+    for (size_t n = 0; n < pairs.size(); ++n) {
+        ++degrees[pairs[n].first];
+        ++degrees[pairs[n].second];
+    }
+
+    /* First order diffusion of the excess weights, converges to zero excess on every connected graph */
+    int32_t max_degree = *std::max_element(degrees.begin(), degrees.end());
+    double alpha = 1. / (max_degree + 1);
+    for (int32_t p = 0; p < num_parts; ++p)
+        excess[p] = part_weights[p] - targets[p] * total;
+    for (int iter = 0; iter < max_diffusion_iters; ++iter) {
+        /* Half of the tolerance is left for the granularity of the cells */
+        bool balanced = true;
+        for (int32_t p = 0; p < num_parts; ++p) {
+            if (excess[p] > 0.5 * (limits[p] - targets[p] * total))
+                balanced = false;
+        }
+        if (balanced)
+            break;
+        for (size_t n = 0; n < pairs.size(); ++n) {
+            double flow = alpha * (excess[pairs[n].first] - excess[pairs[n].second]);
+            flows[n] += flow;
+            excess[pairs[n].first] -= flow;
+            excess[pairs[n].second] += flow;
+        }
+        num_visited += pairs.size();
+    }
+
+    /* Carry out the flows, the cells most connected to the receiving partition first */
+    for (size_t n = 0; n < pairs.size(); ++n) {
+        int32_t from = (flows[n] > 0.) ? pairs[n].first : pairs[n].second;
+        int32_t to = (flows[n] > 0.) ? pairs[n].second : pairs[n].first;
+        double quota = std::fabs(flows[n]);
+        std::set<std::pair<int64_t, int32_t> > candidates;     // (-gain, vertex)
+
+        for (size_t c = 0; c < cells[from].size(); ++c) {
+            int32_t v = cells[from][c];
+            int64_t gain = 0;
+            bool adjacent = false;
+            if (part[v] != from)
+                continue;
+            for (int32_t pos = graph->getOffsets()[v]; pos < graph->getOffsets()[v + 1]; ++pos) {
+                int32_t p = part[graph->getNodes()[pos]];
+                adjacent |= (p == to);
+                gain += (p == to) ? getEdgeWeight(pos) : (p == from) ? -getEdgeWeight(pos) : 0;
+            }
+            if (adjacent) {
+                candidates.insert(std::make_pair(-gain, v));
+                gains[v] = gain;
+            }
+        }
+        num_visited += cells[from].size();
+
+        while (!candidates.empty() && quota >= 0.5 * getWeight(candidates.begin()->second)) {
+            int32_t v = candidates.begin()->second;
+            candidates.erase(candidates.begin());
+            if (part_weights[to] + getWeight(v) > getRoom(to))
+                continue;
+            quota -= getWeight(v);
+            cut_change -= gains[v];
+            moveCell(v, to);
+
+            /* Neighbors left in the sending partition are now adjacent to the receiving one */
+            for (int32_t pos = graph->getOffsets()[v]; pos < graph->getOffsets()[v + 1]; ++pos) {
+                int32_t u = graph->getNodes()[pos];
+                updateBoundary(u);
+                if (part[u] != from)
+                    continue;
+                if (!candidates.erase(std::make_pair(-gains[u], u))) {
+                    gains[u] = 0;
+                    for (int32_t upos = graph->getOffsets()[u]; upos < graph->getOffsets()[u + 1]; ++upos) {
+                        int32_t p = part[graph->getNodes()[upos]];
+                        gains[u] += (p == to) ? getEdgeWeight(upos) : (p == from) ? -getEdgeWeight(upos) : 0;
+                    }
+                    ++num_visited;
+                }
+                else {
+                    gains[u] += 2 * getEdgeWeight(pos);
+                }
+                candidates.insert(std::make_pair(-gains[u], u));
+            }
+        }
+    }
+}
+
+void IncrementalRefiner::moveCell(int32_t v, int32_t target) {
+
+    part_weights[part[v]] -= getWeight(v);
+    part_weights[target] += getWeight(v);
+    if (origins[v] == EMPTY) {
+        origins[v] = part[v];
+        touched.push_back(v);
+    }
+    part[v] = target;
+}
+
+bool IncrementalRefiner::findMove(int32_t v, int32_t& target, int64_t& gain) {
+
+    int32_t own = part[v];
+    int64_t internal = 0;
+    int32_t best = EMPTY;
+
+    ++num_visited;
+    connections.clear();
+    for (int32_t pos = graph->getOffsets()[v]; pos < graph->getOffsets()[v + 1]; ++pos) {
+        int32_t p = part[graph->getNodes()[pos]];
+        if (p == own) {
+            internal += getEdgeWeight(pos);
+            continue;
+        }
+        size_t n = 0;
+        while (n < connections.size() && connections[n].first != p)
+            ++n;
+        if (n == connections.size())
+            connections.push_back(std::make_pair(p, (int64_t) 0));
+        connections[n].second += getEdgeWeight(pos);
+    }
+
+    for (size_t n = 0; n < connections.size(); ++n) {
+        int32_t p = connections[n].first;
+        if (part_weights[p] + getWeight(v) > getRoom(p))
+            continue;
+        if (best == EMPTY || connections[n].second > connections[best].second
+            || (connections[n].second == connections[best].second
+                && part_weights[p] < part_weights[connections[best].first]))
+            best = n;
+    }
+    if (best == EMPTY)
+        return false;
+
+    target = connections[best].first;
+    gain = connections[best].second - internal;
+    return true;
+}
+
+void IncrementalRefiner::updateBoundary(int32_t v) {
+
+    if (!in_boundary[v] && isBoundary(v)) {
+        in_boundary[v] = 1;
+        boundary.push_back(v);
+    }
+}
+
+bool IncrementalRefiner::isBoundary(int32_t v) {
+
+    for (int32_t pos = graph->getOffsets()[v]; pos < graph->getOffsets()[v + 1]; ++pos) {
+        if (part[graph->getNodes()[pos]] != part[v])
+            return true;
+    }
+    return false;
+}
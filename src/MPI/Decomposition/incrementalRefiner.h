@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_INCREMENTALREFINER_H
+#define UNBALANCED_WORKLOAD_INCREMENTALREFINER_H
+
+#include <vector>
+#include <set>
+#include <cstdint>
+#include <algorithm>
+
+#include "../../General/macro.h"
+#include "../../graph.h"
+
+/*!
+ * @brief Cell changing its owner.
+ */
+struct Migration {
+    int32_t cell;       // Global ID of the cell
+    int32_t from;       // Previous owner
+    int32_t to;         // New owner
+};
+
+/*!
+ * \class IncrementalRefiner
+ * @brief Rebalances an existing partitioning after the weights of vertices have drifted.
+ * Instead of partitioning the graph from scratch, cells on the boundaries between partitions are
+ * moved by Fiduccia-Mattheyses passes until all partitions fit into the tolerance, the cut being
+ * kept as low as possible. If the neighbors of an overweight partition are full as well, the flow
+ * of weight between neighboring partitions is found by diffusion on the graph of partitions first
+ * and carried out by moving the boundary cells most connected to the receiving partition. The list
+ * of boundary cells is kept between the refinements and updated by the moves, and the weights of the
+ * partitions are updated from the cells whose weights changed, so the cost of a refinement is
+ * proportional to the number of boundary and changed cells, not to the size of the graph.
+ * If a partition cannot be brought within the tolerance, e.g. because its cells are too heavy, the
+ * limits are relaxed by the weight of the heaviest cell; no move then lets a partition exceed both the
+ * tolerance and the weight it had before the refinement.
+ */
+class IncrementalRefiner {
+public:
+    IncrementalRefiner() : graph(NULL), num_parts(0), tolerance(1.03), num_passes(4), total(0), max_vertex(0),
+                           cut_change(0), num_visited(0), imbalance(0.) { }
+
+    ~IncrementalRefiner() { }
+
+    /*!
+     * @brief Take over the partitioning and the weights, find the cells on the boundaries between
+     * partitions and sum up the weights of the partitions. This is the only step whose cost is
+     * proportional to the size of the graph.
+     * @param graph Graph of the domain, it must outlive the refiner.
+     * @param partitioning Partition of each vertex.
+     * @param parts Number of partitions.
+     * @param weights Weights of vertices, \e ncon consecutive values per vertex, only the first
+     *                constraint is balanced.
+     * @param ncon Number of constraints.
+     * @param fractions Desired fraction of the total weight of each partition (empty for uniform).
+     */
+    void initialize(Graph& graph, const int32_t* partitioning, int32_t parts, const int32_t* weights,
+                    int32_t ncon, const std::vector<double>& fractions = std::vector<double>());
+
+    /*!
+     * @brief Change the weight of a vertex, the weight of its partition is updated at once.
+     * The weight of the heaviest vertex is not lowered when it gets lighter, so the relaxed limits
+     * might be slightly wider than necessary.
+     */
+    void updateWeight(int32_t v, int32_t weight);
+
+    /*!
+     * @brief Rebalance the partitioning for the updated weights, the partitioning is changed in place.
+     * @param migrations [out] Cells that changed their owner, in ascending order of IDs.
+     * @return Returns EXIT_SUCCESS if all partitions fit into the tolerance and EXIT_FAILURE otherwise.
+     */
+    int refine(std::vector<Migration>& migrations);
+
+    /*!
+     * @brief Set allowed load imbalance, i.e. the maximum ratio of the weight of a partition to its target.
+     */
+    inline void setTolerance(double value) {
+        tolerance = value;
+    }
+
+    /*!
+     * @brief Set maximum number of Fiduccia-Mattheyses passes of each refinement.
+     */
+    inline void setNumPasses(int passes) {
+        num_passes = passes;
+    }
+
+    inline std::vector<int32_t>& getPartitioning() {
+        return part;
+    }
+
+    /*!
+     * @brief Get the change of the edge cut by the last refinement.
+     */
+    inline int64_t getCutChange() {
+        return cut_change;
+    }
+
+    /*!
+     * @brief Get the number of vertices examined by the last refinement, a measure of its cost.
+     */
+    inline int64_t getNumVisited() {
+        return num_visited;
+    }
+
+    /*!
+     * @brief Get the maximum ratio of the weight of a partition to its target after the last refinement.
+     */
+    inline double getImbalance() {
+        return imbalance;
+    }
+
+private:
+    /*!
+     * @brief Move weight from overweight partitions towards lighter ones along the graph of partitions.
+     * The excess weights are diffused between neighboring partitions until all of them are within the
+     * tolerance, the accumulated flow of each pair is then carried out by moving cells from the sending
+     * partition, the ones with the most edges to the receiving partition first.
+     */
+    void diffuse();
+
+    /*!
+     * @brief Run the Fiduccia-Mattheyses passes, each one is rolled back to its best state.
+     * @param violation Total overweight of the partitions before the passes.
+     * @return Returns the total overweight of the partitions after the passes.
+     */
+    int64_t runPasses(int64_t violation);
+
+    /*!
+     * @brief Set the maximum weight of each partition.
+     * @param relaxed Allow the weight of the heaviest vertex above the target instead of the tolerance.
+     */
+    void setLimits(bool relaxed);
+
+    /*!
+     * @brief Move the cell to another partition and record its original owner.
+     */
+    void moveCell(int32_t v, int32_t target);
+
+    /*!
+     * @brief Find the neighboring partition the vertex is connected to most strongly and which has
+     * room for it.
+     * @param target [out] Partition to move the vertex to.
+     * @param gain [out] Decrease of the edge cut by the move.
+     * @return Returns false if there is no such partition.
+     */
+    bool findMove(int32_t v, int32_t& target, int64_t& gain);
+
+    /*!
+     * @brief Add the vertex to the list of boundary cells if it has a neighbor in another partition.
+     */
+    void updateBoundary(int32_t v);
+
+    /*!
+     * @brief Check if the vertex has a neighbor in another partition.
+     */
+    bool isBoundary(int32_t v);
+
+    inline int64_t getWeight(int32_t v) {
+        return weights[v];
+    }
+
+    inline int64_t getEdgeWeight(int32_t pos) {
+        return graph->getEdgeWeights().empty() ? 1 : graph->getEdgeWeights()[pos];
+    }
+
+    inline int64_t getOverweight(int32_t p) {
+        return std::max<int64_t>(part_weights[p] - limits[p], 0);
+    }
+
+    /*!
+     * @brief Get the maximum weight a move may bring the partition to.
+     */
+    inline int64_t getRoom(int32_t p) {
+        return std::min(limits[p], caps[p]);
+    }
+
+    static const int max_diffusion_iters = 10000;   // Maximum number of iterations of the diffusion
+    static const int max_diffusion_rounds = 4;      // Maximum number of diffusions of each refinement
+
+private:
+    Graph* graph;                       // Graph of the domain
+    int32_t num_parts;                  // Number of partitions
+    double tolerance;                   // Allowed load imbalance
+    int num_passes;                     // Maximum number of passes of each refinement
+    int64_t total;                      // Total weight of all vertices
+    int64_t max_vertex;                 // Upper bound of the weight of the heaviest vertex
+    std::vector<double> targets;        // Target fraction of each partition
+    std::vector<int32_t> part;          // Partition of each vertex
+    std::vector<int32_t> boundary;      // Boundary cells, might contain cells which became interior
+    std::vector<char> in_boundary;      // Whether the cell is listed in \e boundary
+    std::vector<char> locked;           // Cells moved during the current pass
+    std::vector<char> queued;           // Cells with a move in the queue
+    std::vector<int64_t> gains;         // Gain of the queued move of each cell
+    std::vector<int32_t> destinations;  // Partition of the queued move of each cell
+    std::vector<int32_t> origins;       // Owner before the refinement of each moved cell (EMPTY otherwise)
+    std::vector<int32_t> touched;       // Cells moved at least once by the current refinement
+    std::vector<int32_t> weights;       // Balanced weight of each vertex
+    std::vector<int64_t> part_weights;  // Weight of each partition
+    std::vector<int64_t> limits;        // Maximum weight of each partition
+    std::vector<int64_t> caps;          // Larger of the tolerance and the weight before the refinement
+    std::set<std::pair<int64_t, int32_t> > queue;           // (-gain, vertex), i.e. the best move first
+    std::vector<std::pair<int32_t, int64_t> > connections;  // Scratch of findMove(): (partition, weight of edges)
+    int64_t cut_change;                 // Change of the edge cut by the last refinement
+    int64_t num_visited;                // Vertices examined by the last refinement
+    double imbalance;                   // Imbalance after the last refinement
+};
+
+#endif //UNBALANCED_WORKLOAD_INCREMENTALREFINER_H
@@ -0,0 +1,881 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <set>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "nativePartitioner.h"
+
+/*!
+ * @brief Hash of an undirected edge, breaks ties between equally heavy edges.
+ */
+static inline uint64_t hashEdge(int32_t a, int32_t b) {
+
+    uint64_t x = ((uint64_t) std::min(a, b) << 32) | (uint32_t) std::max(a, b);
+
+    /* Finalizer of splitmix64 */
+    x ^= x >> 30;
+    x *= UINT64_C(0xbf58476d1ce4e5b9);
+    x ^= x >> 27;
+    x *= UINT64_C(0x94d049bb133111eb);
+    x ^= x >> 31;
+    return x;
+}
+
+/*!
+ * @brief Get the maximum weight of each side of a bisection.
+ * A side may exceed its target by the tolerance, or by a single vertex if vertices are heavy.
+ */
+static void getSideLimits(int64_t total, double fraction, double tol, int64_t max_vertex, int64_t limits[2]) {
+
+    double targets[2] = {fraction * total, (1. - fraction) * total};
+
+    for (int s = 0; s < 2; ++s) {
+        limits[s] = std::max((int64_t) (tol * targets[s]), (int64_t) std::ceil(targets[s]) + max_vertex);
+    }
+}
+
+static inline int64_t getViolation(const int64_t weights[2], const int64_t limits[2]) {
+
+    return std::max<int64_t>(weights[0] - limits[0], 0) + std::max<int64_t>(weights[1] - limits[1], 0);
+}
+
+int NativePartitioner::partition(Graph& graph, const int32_t* weights, int32_t num_parts,
+                                 const std::vector<double>& fractions, std::vector<int32_t>& part) {
+
+    std::vector<Level> levels(1);
+    int32_t num_vertices = graph.getRows();
+    int64_t total = 0;
+    double sum = 0.;
+
+    if (num_parts < 1 || (!fractions.empty() && (int32_t) fractions.size() != num_parts))
+        return EXIT_FAILURE;
+
+    nparts = num_parts;
+    targets = fractions;
+    if (targets.empty())
+        targets.assign(nparts, 1.);
+    for (int32_t p = 0; p < nparts; ++p)
+        sum += targets[p];
+    for (int32_t p = 0; p < nparts; ++p)
+        targets[p] /= sum;
+
+    /* The original graph is copied, since the coarser levels are stored in the same way */
+    Level &finest = levels[0];
+    finest.offsets.assign(graph.getOffsets().begin(), graph.getOffsets().begin() + num_vertices + 1);
+    finest.nodes.assign(graph.getNodes().begin(), graph.getNodes().begin() + finest.offsets[num_vertices]);
+    if (graph.getEdgeWeights().empty())
+        finest.edge_weights.assign(finest.nodes.size(), 1);
+    else
+        finest.edge_weights.assign(graph.getEdgeWeights().begin(), graph.getEdgeWeights().begin() + finest.nodes.size());
+    if (weights != NULL)
+        finest.vertex_weights.assign(weights, weights + num_vertices);
+    else
+        finest.vertex_weights.assign(num_vertices, 1);
+
+    part.assign(num_vertices, 0);
+    num_levels = 1;
+    edge_cut = 0;
+    if (nparts == 1)
+        return EXIT_SUCCESS;
+
+    /* Coarsen until the initial partitioning is cheap (as METIS does), merged vertices stay well below
+     * the size of a partition */
+    int32_t coarsen_to = std::max<int32_t>(num_vertices / (20. * std::log2((double) nparts)), 30 * nparts);
+    for (int32_t v = 0; v < num_vertices; ++v)
+        total += finest.vertex_weights[v];
+    int64_t max_weight = std::max<int64_t>(1.5 * total / coarsen_to, 1);
+
+    while (levels.back().getSize() > coarsen_to) {
+        std::vector<int32_t> mate;
+        Level coarse;
+
+        match(levels.back(), max_weight, mate);
+        int32_t coarse_size = contract(levels.back(), mate, coarse);
+
+        /* Matching stalls e.g. on stars or if all vertices are heavy */
+        if (coarse_size > 0.95 * levels.back().getSize()) {
+            levels.back().coarse.clear();
+            break;
+        }
+        levels.push_back(std::move(coarse));
+    }
+
+    /* Partition the coarsest graph */
+    Level &coarsest = levels.back();
+    std::vector<int32_t> coarse_part(coarsest.getSize(), 0);
+    std::vector<int32_t> vertices(coarsest.getSize());
+    std::vector<int32_t> local(coarsest.getSize(), EMPTY);
+    for (int32_t v = 0; v < coarsest.getSize(); ++v)
+        vertices[v] = v;
+    bisectRecursively(coarsest, vertices, 0, nparts, local, coarse_part);
+    refine(coarsest, coarse_part);
+
+    /* Project the partitioning back and refine it at each level */
+    for (int l = (int) levels.size() - 2; l >= 0; --l) {
+        Level &fine = levels[l];
+        std::vector<int32_t> fine_part(fine.getSize());
+
+        #pragma omp parallel for schedule(static)
+        for (int32_t v = 0; v < fine.getSize(); ++v) {
+            fine_part[v] = coarse_part[fine.coarse[v]];
+        }
+        refine(fine, fine_part);
+        coarse_part.swap(fine_part);
+    }
+
+    part.swap(coarse_part);
+    num_levels = levels.size();
+    edge_cut = computeEdgeCut(levels[0], part);
+    return EXIT_SUCCESS;
+}
+
+void NativePartitioner::match(const Level& level, int64_t max_weight, std::vector<int32_t>& mate) {
+
+    int32_t size = level.getSize();
+    std::vector<int32_t> proposal(size);
+
+    mate.assign(size, EMPTY);
+
+    for (int round = 0; round < num_match_rounds; ++round) {
+        int64_t num_matched = 0;
+
+        #pragma omp parallel for schedule(static)
+        for (int32_t v = 0; v < size; ++v) {
+            int32_t best = EMPTY;
+            double best_rating = 0.;
+            uint64_t best_hash = 0;
+
+            if (mate[v] == EMPTY) {
+                for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                    int32_t u = level.nodes[pos];
+                    double w = level.edge_weights[pos];
+                    if (u == v || mate[u] != EMPTY
+                        || (int64_t) level.vertex_weights[v] + level.vertex_weights[u] > max_weight)
+                        continue;
+
+                    /* Heavy edges between light vertices first, it keeps the merged vertices compact */
+                    double rating = w * w / ((double) std::max(level.vertex_weights[v], 1)
+                                             * std::max(level.vertex_weights[u], 1));
+                    uint64_t hash = hashEdge(v, u);
+                    if (best == EMPTY || rating > best_rating || (rating == best_rating && hash > best_hash)) {
+                        best = u;
+                        best_rating = rating;
+                        best_hash = hash;
+                    }
+                }
+            }
+            proposal[v] = best;
+        }
+
+        #pragma omp parallel for schedule(static) reduction(+:num_matched)
+        for (int32_t v = 0; v < size; ++v) {
+            if (proposal[v] != EMPTY && proposal[proposal[v]] == v) {
+                mate[v] = proposal[v];
+                ++num_matched;
+            }
+        }
+
+        if (num_matched == 0)
+            break;
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int32_t v = 0; v < size; ++v) {
+        if (mate[v] == EMPTY)
+            mate[v] = v;
+    }
+}
+
+int32_t NativePartitioner::contract(Level& fine, const std::vector<int32_t>& mate, Level& coarse) {
+
+    int32_t size = fine.getSize();
+    int32_t coarse_size = 0;
+    std::vector<int32_t> representative;
+
+    /* The lower vertex of each pair represents it, so coarse vertices keep the original order */
+    fine.coarse.resize(size);
+    for (int32_t v = 0; v < size; ++v) {
+        if (mate[v] >= v) {
+            fine.coarse[v] = coarse_size++;
+            representative.push_back(v);
+        }
+    }
+    for (int32_t v = 0; v < size; ++v) {
+        if (mate[v] < v)
+            fine.coarse[v] = fine.coarse[mate[v]];
+    }
+
+    coarse.vertex_weights.resize(coarse_size);
+    coarse.offsets.assign(coarse_size + 1, 0);
+
+    /* Count distinct neighbors of each coarse vertex */
+    #pragma omp parallel
+    {
+        std::vector<int32_t> marker(coarse_size, EMPTY);
+
+        #pragma omp for schedule(static)
+        for (int32_t c = 0; c < coarse_size; ++c) {
+            int32_t pair[2] = {representative[c], mate[representative[c]]};
+            int32_t num_merged = (pair[0] != pair[1]) ? 2 : 1;
+            int32_t degree = 0;
+
+            coarse.vertex_weights[c] = 0;
+            for (int k = 0; k < num_merged; ++k) {
+                coarse.vertex_weights[c] += fine.vertex_weights[pair[k]];
+                for (int32_t pos = fine.offsets[pair[k]]; pos < fine.offsets[pair[k] + 1]; ++pos) {
+                    int32_t cu = fine.coarse[fine.nodes[pos]];
+                    if (cu != c && marker[cu] != c) {
+                        marker[cu] = c;
+                        ++degree;
+                    }
+                }
+            }
+            coarse.offsets[c + 1] = degree;
+        }
+    }
+
+    for (int32_t c = 0; c < coarse_size; ++c)
+        coarse.offsets[c + 1] += coarse.offsets[c];
+    coarse.nodes.resize(coarse.offsets[coarse_size]);
+    coarse.edge_weights.resize(coarse.offsets[coarse_size]);
+
+    /* Merge the edges, each thread visits its coarse vertices in ascending order, so positions
+     * left in the array by the previous vertices are always below the current range */
+    #pragma omp parallel
+    {
+        std::vector<int32_t> position(coarse_size, EMPTY);
+
+        #pragma omp for schedule(static)
+        for (int32_t c = 0; c < coarse_size; ++c) {
+            int32_t pair[2] = {representative[c], mate[representative[c]]};
+            int32_t num_merged = (pair[0] != pair[1]) ? 2 : 1;
+            int32_t begin = coarse.offsets[c];
+            int32_t end = begin;
+
+            for (int k = 0; k < num_merged; ++k) {
+                for (int32_t pos = fine.offsets[pair[k]]; pos < fine.offsets[pair[k] + 1]; ++pos) {
+                    int32_t cu = fine.coarse[fine.nodes[pos]];
+                    if (cu == c)
+                        continue;
+                    if (position[cu] < begin) {
+                        position[cu] = end;
+                        coarse.nodes[end] = cu;
+                        coarse.edge_weights[end] = fine.edge_weights[pos];
+                        ++end;
+                    }
+                    else {
+                        coarse.edge_weights[position[cu]] += fine.edge_weights[pos];
+                    }
+                }
+            }
+        }
+    }
+
+    return coarse_size;
+}
+
+void NativePartitioner::bisectRecursively(const Level& level, std::vector<int32_t>& vertices, int32_t first,
+                                          int32_t count, std::vector<int32_t>& local, std::vector<int32_t>& part) {
+
+    int32_t num_left = count / 2;
+    double left_target = 0.;
+    double all_target = 0.;
+    Level sub;
+    std::vector<int8_t> side;
+    std::vector<int32_t> left;
+    std::vector<int32_t> right;
+
+    if (count == 1 || vertices.empty()) {
+        for (size_t n = 0; n < vertices.size(); ++n)
+            part[vertices[n]] = first;
+        return;
+    }
+
+    for (int32_t p = first; p < first + count; ++p) {
+        all_target += targets[p];
+        if (p < first + num_left)
+            left_target += targets[p];
+    }
+
+    /* Extract the subgraph induced by the vertices */
+    for (size_t n = 0; n < vertices.size(); ++n)
+        local[vertices[n]] = n;
+    sub.offsets.push_back(0);
+    for (size_t n = 0; n < vertices.size(); ++n) {
+        int32_t v = vertices[n];
+        sub.vertex_weights.push_back(level.vertex_weights[v]);
+        for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+            int32_t u = level.nodes[pos];
+            if (u != v && local[u] != EMPTY) {
+                sub.nodes.push_back(local[u]);
+                sub.edge_weights.push_back(level.edge_weights[pos]);
+            }
+        }
+        sub.offsets.push_back(sub.nodes.size());
+    }
+    for (size_t n = 0; n < vertices.size(); ++n)
+        local[vertices[n]] = EMPTY;
+
+    bisect(sub, (all_target > 0.) ? left_target / all_target : 0.5, side);
+
+    for (size_t n = 0; n < vertices.size(); ++n) {
+        if (side[n] == 0)
+            left.push_back(vertices[n]);
+        else
+            right.push_back(vertices[n]);
+    }
+    std::vector<int32_t>().swap(vertices);
+    sub = Level();
+
+    bisectRecursively(level, left, first, num_left, local, part);
+    bisectRecursively(level, right, first + num_left, count - num_left, local, part);
+}
+
+void NativePartitioner::bisect(Level& level, double fraction, std::vector<int8_t>& side) {
+
+    int32_t size = level.getSize();
+    int64_t total = 0;
+    int64_t limits[2];
+    int64_t best_cut = -1;
+    int64_t best_violation = 0;
+    std::vector<int8_t> trial;
+    std::vector<char> visited;
+    std::vector<int32_t> queue;
+    std::vector<int64_t> degrees(size);
+    std::vector<int64_t> connected;
+    std::set<std::pair<int64_t, int32_t> > frontier;   // (increase of the cut, vertex)
+    int32_t seeds[num_bisection_tries];
+
+    /* The imbalance accumulates over the levels of the recursion */
+    double tol = 1. + (tolerance - 1.) / std::max(1., std::ceil(std::log2((double) nparts)));
+
+    for (int32_t v = 0; v < size; ++v)
+        total += level.vertex_weights[v];
+
+    /* Large graphs are bisected in the multilevel way as well: coarsen, bisect, project and refine */
+    if (size > bisection_coarsen_to) {
+        std::vector<int32_t> mate;
+        std::vector<int8_t> coarse_side;
+        Level coarse;
+
+        match(level, std::max<int64_t>(1.5 * total / bisection_coarsen_to, 1), mate);
+        if (contract(level, mate, coarse) <= 0.95 * size) {
+            bisect(coarse, fraction, coarse_side);
+            side.resize(size);
+            for (int32_t v = 0; v < size; ++v)
+                side[v] = coarse_side[level.coarse[v]];
+            refineBisection(level, fraction, tol, side);
+            return;
+        }
+    }
+    getSideLimits(total, fraction, tol, getMaxVertexWeight(level), limits);
+
+    /* The first seed is a pseudo-peripheral vertex, i.e. the last one reached by two breadth-first searches */
+    seeds[0] = 0;
+    for (int sweep = 0; sweep < 2; ++sweep) {
+        visited.assign(size, 0);
+        queue.assign(1, seeds[0]);
+        visited[seeds[0]] = 1;
+        for (size_t head = 0; head < queue.size(); ++head) {
+            int32_t v = queue[head];
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                if (!visited[level.nodes[pos]]) {
+                    visited[level.nodes[pos]] = 1;
+                    queue.push_back(level.nodes[pos]);
+                }
+            }
+        }
+        seeds[0] = queue.back();
+    }
+    for (int t = 1; t < num_bisection_tries; ++t)
+        seeds[t] = (int64_t) size * t / num_bisection_tries;
+
+    /* Growing a side by a vertex increases the cut by its degree minus twice its edges to the side */
+    for (int32_t v = 0; v < size; ++v) {
+        degrees[v] = 0;
+        for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos)
+            degrees[v] += level.edge_weights[pos];
+    }
+
+    for (int t = 0; t < std::min<int32_t>(num_bisection_tries, size); ++t) {
+        int64_t weights[2] = {0, total};
+        int32_t next = 0;
+
+        /* Grow the side 0 greedily from the seed, the vertex increasing the cut the least first;
+         * continue in another component if needed */
+        trial.assign(size, 1);
+        visited.assign(size, 0);
+        connected.assign(size, 0);
+        frontier.clear();
+        frontier.insert(std::make_pair(degrees[seeds[t]], seeds[t]));
+        visited[seeds[t]] = 1;
+        while (weights[0] < fraction * total) {
+            if (frontier.empty()) {
+                while (next < size && visited[next])
+                    ++next;
+                if (next == size)
+                    break;
+                visited[next] = 1;
+                frontier.insert(std::make_pair(degrees[next], next));
+            }
+            int32_t v = frontier.begin()->second;
+            frontier.erase(frontier.begin());
+            trial[v] = 0;
+            weights[0] += level.vertex_weights[v];
+            weights[1] -= level.vertex_weights[v];
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                int32_t u = level.nodes[pos];
+                if (trial[u] == 0)
+                    continue;
+                if (visited[u])
+                    frontier.erase(std::make_pair(degrees[u] - 2 * connected[u], u));
+                connected[u] += level.edge_weights[pos];
+                visited[u] = 1;
+                frontier.insert(std::make_pair(degrees[u] - 2 * connected[u], u));
+            }
+        }
+
+        refineBisection(level, fraction, tol, trial);
+
+        int64_t cut = 0;
+        weights[0] = weights[1] = 0;
+        for (int32_t v = 0; v < size; ++v) {
+            weights[trial[v]] += level.vertex_weights[v];
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                if (trial[level.nodes[pos]] != trial[v])
+                    cut += level.edge_weights[pos];
+            }
+        }
+        int64_t violation = getViolation(weights, limits);
+
+        if (best_cut < 0 || violation < best_violation || (violation == best_violation && cut < best_cut)) {
+            best_cut = cut;
+            best_violation = violation;
+            side = trial;
+        }
+    }
+}
+
+void NativePartitioner::refineBisection(const Level& level, double fraction, double tol, std::vector<int8_t>& side) {
+
+    int32_t size = level.getSize();
+    int64_t total = 0;
+    int64_t limits[2];
+    std::vector<int64_t> gain(size);
+    std::vector<char> locked(size);
+    std::vector<char> queued(size);
+    std::vector<int32_t> moves;
+    std::set<std::pair<int64_t, int32_t> > queues[2];   // (-gain, vertex), i.e. the best move first
+
+    /* A pass stops after this number of moves without an improvement */
+    int32_t max_idle_moves = std::min(std::max(size / 100, 25), 200);
+
+    for (int32_t v = 0; v < size; ++v)
+        total += level.vertex_weights[v];
+    getSideLimits(total, fraction, tol, getMaxVertexWeight(level), limits);
+
+    for (int pass = 0; pass < num_fm_passes; ++pass) {
+        int64_t weights[2] = {0, 0};
+        int64_t cut = 0;
+        int32_t since_best = 0;
+        size_t best_moves = 0;
+
+        queues[0].clear();
+        queues[1].clear();
+        moves.clear();
+        locked.assign(size, 0);
+
+        for (int32_t v = 0; v < size; ++v) {
+            bool boundary = false;
+            gain[v] = 0;
+            weights[side[v]] += level.vertex_weights[v];
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                if (side[level.nodes[pos]] != side[v]) {
+                    gain[v] += level.edge_weights[pos];
+                    cut += level.edge_weights[pos];
+                    boundary = true;
+                }
+                else {
+                    gain[v] -= level.edge_weights[pos];
+                }
+            }
+            /* Interior vertices join the queues once a neighbor moves */
+            if (boundary)
+                queues[side[v]].insert(std::make_pair(-gain[v], v));
+            queued[v] = boundary;
+        }
+        cut /= 2;
+
+        int64_t best_cut = cut;
+        int64_t best_violation = getViolation(weights, limits);
+
+        while (since_best < max_idle_moves) {
+            int from = EMPTY;
+
+            /* An overweight side has to shed vertices, otherwise take the best move keeping the balance */
+            for (int s = 0; s < 2; ++s) {
+                if (queues[s].empty())
+                    continue;
+                int32_t v = queues[s].begin()->second;
+                bool overweight = weights[s] > limits[s];
+                bool fits = weights[1 - s] + level.vertex_weights[v] <= limits[1 - s];
+                if (!overweight && !fits)
+                    continue;
+                if (from == EMPTY) {
+                    from = s;
+                }
+                else if (overweight != (weights[from] > limits[from])) {
+                    if (overweight)
+                        from = s;
+                }
+                else if (gain[v] > gain[queues[from].begin()->second]) {
+                    from = s;
+                }
+            }
+            if (from == EMPTY)
+                break;
+
+            int32_t v = queues[from].begin()->second;
+            queues[from].erase(queues[from].begin());
+            locked[v] = 1;
+            side[v] = 1 - from;
+            weights[from] -= level.vertex_weights[v];
+            weights[1 - from] += level.vertex_weights[v];
+            cut -= gain[v];
+            moves.push_back(v);
+
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                int32_t u = level.nodes[pos];
+                if (locked[u] || u == v)
+                    continue;
+                if (queued[u])
+                    queues[side[u]].erase(std::make_pair(-gain[u], u));
+                gain[u] += (side[u] == side[v]) ? -2 * level.edge_weights[pos] : 2 * level.edge_weights[pos];
+                queues[side[u]].insert(std::make_pair(-gain[u], u));
+                queued[u] = 1;
+            }
+
+            int64_t violation = getViolation(weights, limits);
+            if (violation < best_violation || (violation == best_violation && cut < best_cut)) {
+                best_cut = cut;
+                best_violation = violation;
+                best_moves = moves.size();
+                since_best = 0;
+            }
+            else {
+                ++since_best;
+            }
+        }
+
+        /* Roll back the moves made after the best state */
+        for (size_t n = moves.size(); n > best_moves; --n) {
+            side[moves[n - 1]] = 1 - side[moves[n - 1]];
+        }
+
+        if (best_moves == 0)
+            break;
+    }
+}
+
+void NativePartitioner::refine(const Level& level, std::vector<int32_t>& part) {
+
+    int32_t size = level.getSize();
+    int64_t total = 0;
+    int64_t max_vertex = getMaxVertexWeight(level);
+    std::vector<int64_t> part_weights(nparts, 0);
+    std::vector<int64_t> limits(nparts);
+    std::vector<int32_t> desired(size);
+    std::vector<int64_t> gains(size);
+
+    for (int32_t v = 0; v < size; ++v) {
+        part_weights[part[v]] += level.vertex_weights[v];
+        total += level.vertex_weights[v];
+    }
+    for (int32_t p = 0; p < nparts; ++p) {
+        limits[p] = std::max((int64_t) (tolerance * targets[p] * total),
+                             (int64_t) std::ceil(targets[p] * total) + max_vertex);
+    }
+
+    for (int round = 0; round < num_rounds; ++round) {
+        int64_t num_moves = 0;
+
+        for (int direction = 0; direction < 2; ++direction) {
+
+            #pragma omp parallel
+            {
+                std::vector<std::pair<int32_t, int64_t> > connections;     // (partition, weight of edges)
+
+                #pragma omp for schedule(static)
+                for (int32_t v = 0; v < size; ++v) {
+                    int32_t own = part[v];
+                    int64_t internal = 0;
+                    int32_t best = EMPTY;
+                    int64_t best_gain = 0;
+
+                    connections.clear();
+                    for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                        int32_t p = part[level.nodes[pos]];
+                        if (p == own) {
+                            internal += level.edge_weights[pos];
+                            continue;
+                        }
+                        size_t n = 0;
+                        while (n < connections.size() && connections[n].first != p)
+                            ++n;
+                        if (n == connections.size())
+                            connections.push_back(std::make_pair(p, (int64_t) 0));
+                        connections[n].second += level.edge_weights[pos];
+                    }
+
+                    bool overweight = part_weights[own] > limits[own];
+                    for (size_t n = 0; n < connections.size(); ++n) {
+                        int32_t p = connections[n].first;
+                        int64_t gain = connections[n].second - internal;
+                        if ((direction == 0) != (p > own) || part_weights[p] + level.vertex_weights[v] > limits[p])
+                            continue;
+                        if (gain <= 0 && !overweight)
+                            continue;
+                        if (best == EMPTY || gain > best_gain
+                            || (gain == best_gain && part_weights[p] < part_weights[best])) {
+                            best = p;
+                            best_gain = gain;
+                        }
+                    }
+                    desired[v] = best;
+                    gains[v] = best_gain;
+                }
+            }
+
+            /* Apply the moves in the order of vertices, so the result does not depend on the number of threads */
+            for (int32_t v = 0; v < size; ++v) {
+                int32_t p = desired[v];
+                int32_t own = part[v];
+                if (p == EMPTY || part_weights[p] + level.vertex_weights[v] > limits[p])
+                    continue;
+                if (gains[v] <= 0 && part_weights[own] <= limits[own])
+                    continue;
+                part_weights[own] -= level.vertex_weights[v];
+                part_weights[p] += level.vertex_weights[v];
+                part[v] = p;
+                ++num_moves;
+            }
+        }
+
+        if (num_moves == 0)
+            break;
+    }
+
+    refineBoundary(level, part, part_weights, limits);
+}
+
+void NativePartitioner::refineBoundary(const Level& level, std::vector<int32_t>& part,
+                                       std::vector<int64_t>& part_weights, const std::vector<int64_t>& limits) {
+
+    int32_t size = level.getSize();
+    std::vector<char> is_boundary(size);
+    std::vector<char> locked(size, 0);
+    std::vector<char> queued(size, 0);
+    std::vector<int64_t> gains(size);
+    std::vector<int32_t> destinations(size);
+    std::vector<int32_t> boundary;
+    std::vector<std::pair<int32_t, int32_t> > moves;    // (vertex, previous partition)
+    std::set<std::pair<int64_t, int32_t> > queue;       // (-gain, vertex), i.e. the best move first
+
+    for (int pass = 0; pass < num_fm_passes; ++pass) {
+        int64_t violation = 0;
+        int64_t cut_change = 0;
+        int32_t since_best = 0;
+        size_t best_moves = 0;
+
+        #pragma omp parallel for schedule(static)
+        for (int32_t v = 0; v < size; ++v) {
+            is_boundary[v] = 0;
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                if (part[level.nodes[pos]] != part[v]) {
+                    is_boundary[v] = 1;
+                    break;
+                }
+            }
+        }
+
+        boundary.clear();
+        queue.clear();
+        moves.clear();
+        for (int32_t v = 0; v < size; ++v) {
+            if (is_boundary[v])
+                boundary.push_back(v);
+        }
+        for (size_t n = 0; n < boundary.size(); ++n) {
+            int32_t v = boundary[n];
+            if (findMove(level, part, part_weights, limits, v, destinations[v], gains[v])) {
+                queue.insert(std::make_pair(-gains[v], v));
+                queued[v] = 1;
+            }
+        }
+        for (int32_t p = 0; p < nparts; ++p)
+            violation += std::max<int64_t>(part_weights[p] - limits[p], 0);
+
+        int64_t best_change = 0;
+        int64_t best_violation = violation;
+
+        /* A pass stops after this number of moves without an improvement */
+        int32_t max_idle_moves = std::min<int32_t>(std::max<int32_t>(boundary.size() / 100, 50), 500);
+
+        while (!queue.empty() && since_best < max_idle_moves) {
+            int32_t v = queue.begin()->second;
+            int32_t target;
+            int64_t gain;
+
+            queue.erase(queue.begin());
+            queued[v] = 0;
+
+            /* Weights of partitions might have changed since the move was found */
+            if (!findMove(level, part, part_weights, limits, v, target, gain))
+                continue;
+            if (target != destinations[v] || gain != gains[v]) {
+                destinations[v] = target;
+                gains[v] = gain;
+                queue.insert(std::make_pair(-gain, v));
+                queued[v] = 1;
+                continue;
+            }
+
+            int32_t from = part[v];
+            int64_t weight = level.vertex_weights[v];
+            violation -= std::max<int64_t>(part_weights[from] - limits[from], 0)
+                         + std::max<int64_t>(part_weights[target] - limits[target], 0);
+            part_weights[from] -= weight;
+            part_weights[target] += weight;
+            violation += std::max<int64_t>(part_weights[from] - limits[from], 0)
+                         + std::max<int64_t>(part_weights[target] - limits[target], 0);
+            part[v] = target;
+            locked[v] = 1;
+            cut_change -= gain;
+            moves.push_back(std::make_pair(v, from));
+
+            for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+                int32_t u = level.nodes[pos];
+                if (locked[u])
+                    continue;
+                if (queued[u]) {
+                    queue.erase(std::make_pair(-gains[u], u));
+                    queued[u] = 0;
+                }
+                if (findMove(level, part, part_weights, limits, u, destinations[u], gains[u])) {
+                    queue.insert(std::make_pair(-gains[u], u));
+                    queued[u] = 1;
+                }
+            }
+
+            if (violation < best_violation || (violation == best_violation && cut_change < best_change)) {
+                best_change = cut_change;
+                best_violation = violation;
+                best_moves = moves.size();
+                since_best = 0;
+            }
+            else {
+                ++since_best;
+            }
+        }
+
+        /* Roll back the moves made after the best state */
+        for (size_t n = moves.size(); n > best_moves; --n) {
+            int32_t v = moves[n - 1].first;
+            part_weights[part[v]] -= level.vertex_weights[v];
+            part_weights[moves[n - 1].second] += level.vertex_weights[v];
+            part[v] = moves[n - 1].second;
+        }
+        for (size_t n = 0; n < moves.size(); ++n)
+            locked[moves[n].first] = 0;
+        for (std::set<std::pair<int64_t, int32_t> >::iterator it = queue.begin(); it != queue.end(); ++it)
+            queued[it->second] = 0;
+
+        if (best_moves == 0)
+            break;
+    }
+}
+
+bool NativePartitioner::findMove(const Level& level, const std::vector<int32_t>& part,
+                                 const std::vector<int64_t>& part_weights, const std::vector<int64_t>& limits,
+                                 int32_t v, int32_t& target, int64_t& gain) {
+
+    int32_t own = part[v];
+    int64_t internal = 0;
+    int32_t best = EMPTY;
+
+    connections.clear();
+    for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+        int32_t p = part[level.nodes[pos]];
+        if (p == own) {
+            internal += level.edge_weights[pos];
+            continue;
+        }
+        size_t n = 0;
+        while (n < connections.size() && connections[n].first != p)
+            ++n;
+        if (n == connections.size())
+            connections.push_back(std::make_pair(p, (int64_t) 0));
+        connections[n].second += level.edge_weights[pos];
+    }
+
+    for (size_t n = 0; n < connections.size(); ++n) {
+        int32_t p = connections[n].first;
+        if (part_weights[p] + level.vertex_weights[v] > limits[p])
+            continue;
+        if (best == EMPTY || connections[n].second > connections[best].second
+            || (connections[n].second == connections[best].second
+                && part_weights[p] < part_weights[connections[best].first]))
+            best = n;
+    }
+    if (best == EMPTY)
+        return false;
+
+    target = connections[best].first;
+    gain = connections[best].second - internal;
+    return true;
+}
+
+int64_t NativePartitioner::computeEdgeCut(const Level& level, const std::vector<int32_t>& part) {
+
+    int64_t cut = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:cut)
+    for (int32_t v = 0; v < level.getSize(); ++v) {
+        for (int32_t pos = level.offsets[v]; pos < level.offsets[v + 1]; ++pos) {
+            if (part[level.nodes[pos]] != part[v])
+                cut += level.edge_weights[pos];
+        }
+    }
+    return cut / 2;
+}
+
+int64_t NativePartitioner::getMaxVertexWeight(const Level& level) {
+
+    int64_t max_weight = 0;
+
+    for (int32_t v = 0; v < level.getSize(); ++v)
+        max_weight = std::max<int64_t>(max_weight, level.vertex_weights[v]);
+    return max_weight;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_NATIVEPARTITIONER_H
+#define UNBALANCED_WORKLOAD_NATIVEPARTITIONER_H
+
+#include <vector>
+#include <cstdint>
+
+#include "../../General/macro.h"
+#include "../../graph.h"
+
+/*!
+ * \class NativePartitioner
+ * @brief Multilevel k-way graph partitioner working directly on the CSR of \e Graph.
+ * The graph is coarsened by heavy-edge matching until it has a few dozen vertices per partition.
+ * The coarsest graph is partitioned by recursive bisection, where each bisection is grown from
+ * several seeds and refined by Fiduccia-Mattheyses. The partitioning is then projected back level
+ * by level and refined at each one by size-constrained label propagation. Matching, contraction,
+ * projection and the gains of the refinement are computed with OpenMP; the result does not depend
+ * on the number of threads.
+ */
+class NativePartitioner {
+public:
+    NativePartitioner() : tolerance(1.03), num_rounds(8), num_levels(0), edge_cut(0) { }
+
+    ~NativePartitioner() { }
+
+    /*!
+     * @brief Partition the graph.
+     * @param graph Graph to be partitioned, weights of edges are used if the graph has them.
+     * @param weights Weights of vertices (NULL for unit weights).
+     * @param num_parts Number of partitions.
+     * @param fractions Desired fraction of the total weight of each partition (empty for uniform).
+     * @param part [out] Partition of each vertex.
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int partition(Graph& graph, const int32_t* weights, int32_t num_parts, const std::vector<double>& fractions,
+                  std::vector<int32_t>& part);
+
+    /*!
+     * @brief Set allowed load imbalance, i.e. the maximum ratio of the weight of a partition to its target.
+     */
+    inline void setTolerance(double value) {
+        tolerance = value;
+    }
+
+    /*!
+     * @brief Set maximum number of refinement rounds at each level.
+     */
+    inline void setNumRounds(int rounds) {
+        num_rounds = rounds;
+    }
+
+    /*!
+     * @brief Get the total weight of the cut edges of the last partitioning.
+     */
+    inline int64_t getEdgeCut() {
+        return edge_cut;
+    }
+
+    /*!
+     * @brief Get the number of levels of the last partitioning, including the original graph.
+     */
+    inline int getNumLevels() {
+        return num_levels;
+    }
+
+private:
+    /*!
+     * @brief Graph of a single level (CSR), the original graph is the level 0.
+     */
+    struct Level {
+        std::vector<int32_t> offsets;
+        std::vector<int32_t> nodes;
+        std::vector<int32_t> edge_weights;
+        std::vector<int32_t> vertex_weights;
+        std::vector<int32_t> coarse;            // Vertex of the next level each vertex is merged into
+
+        inline int32_t getSize() const {
+            return vertex_weights.size();
+        }
+    };
+
+    /*!
+     * @brief Match vertices along the heaviest edges.
+     * Each unmatched vertex proposes to its heaviest unmatched neighbor (ties are broken by a hash of
+     * the edge), mutual proposals are matched. A few rounds of proposals are made.
+     * @param level Graph to be coarsened.
+     * @param max_weight Maximum weight of a merged vertex.
+     * @param mate [out] Matched neighbor of each vertex, or the vertex itself.
+     */
+    void match(const Level& level, int64_t max_weight, std::vector<int32_t>& mate);
+
+    /*!
+     * @brief Merge matched vertices, edges between merged vertices are summed up.
+     * @return Number of vertices of the coarse graph.
+     */
+    int32_t contract(Level& fine, const std::vector<int32_t>& mate, Level& coarse);
+
+    /*!
+     * @brief Split the vertices into partitions [first, first + count) by recursive bisection.
+     * @param level Coarsest graph.
+     * @param vertices Vertices to be split.
+     * @param local Local index of each vertex of the level, EMPTY on input and output.
+     */
+    void bisectRecursively(const Level& level, std::vector<int32_t>& vertices, int32_t first, int32_t count,
+                           std::vector<int32_t>& local, std::vector<int32_t>& part);
+
+    /*!
+     * @brief Split the graph into two sides, the side 0 gets \e fraction of the total weight.
+     * Graphs larger than \e bisection_coarsen_to vertices are coarsened first, the bisection of the
+     * coarse graph is projected back and refined. Small graphs are split by growing the side 0
+     * from several seeds, adding the vertex that increases the cut the least first; the best split
+     * after the refinement is kept.
+     */
+    void bisect(Level& level, double fraction, std::vector<int8_t>& side);
+
+    /*!
+     * @brief Refine the bisection by Fiduccia-Mattheyses passes.
+     * Moves minimize the violation of the balance first and the cut second; each pass is rolled
+     * back to its best state.
+     */
+    void refineBisection(const Level& level, double fraction, double tol, std::vector<int8_t>& side);
+
+    /*!
+     * @brief Refine the k-way partitioning by size-constrained label propagation.
+     * Each vertex moves to the neighboring partition it is connected to most strongly, or leaves
+     * an overweight partition. Gains are computed in parallel; moves are applied in the order of
+     * vertices, towards higher partitions in the first half of a round and towards lower ones in
+     * the second half, so two neighbors never swap their partitions.
+     */
+    void refine(const Level& level, std::vector<int32_t>& part);
+
+    /*!
+     * @brief Refine the k-way partitioning by Fiduccia-Mattheyses passes over the boundary vertices.
+     * Vertices are moved one at a time, the best move first, negative gains included; each pass is
+     * rolled back to its best state (the least violation of the balance first, the least cut second).
+     * The cost is proportional to the number of boundary vertices and their moves.
+     * @param part_weights Weight of each partition, updated by the moves.
+     * @param limits Maximum weight of each partition.
+     */
+    void refineBoundary(const Level& level, std::vector<int32_t>& part, std::vector<int64_t>& part_weights,
+                        const std::vector<int64_t>& limits);
+
+    /*!
+     * @brief Find the neighboring partition the vertex is connected to most strongly and which has
+     * room for it.
+     * @param target [out] Partition to move the vertex to.
+     * @param gain [out] Decrease of the edge cut by the move.
+     * @return Returns false if there is no such partition.
+     */
+    bool findMove(const Level& level, const std::vector<int32_t>& part, const std::vector<int64_t>& part_weights,
+                  const std::vector<int64_t>& limits, int32_t v, int32_t& target, int64_t& gain);
+
+    int64_t computeEdgeCut(const Level& level, const std::vector<int32_t>& part);
+
+    int64_t getMaxVertexWeight(const Level& level);
+
+    static const int num_match_rounds = 16;     // Rounds of proposals of the matching
+    static const int num_bisection_tries = 4;   // Seeds of each bisection
+    static const int num_fm_passes = 4;         // Maximum number of passes of each bisection
+    static const int bisection_coarsen_to = 200;    // Size of the graph split directly by a bisection
+
+private:
+    double tolerance;               // Allowed load imbalance
+    int num_rounds;                 // Maximum number of refinement rounds at each level
+    int num_levels;                 // Number of levels of the last partitioning
+    int64_t edge_cut;               // Edge cut of the last partitioning
+    int32_t nparts;                 // Number of partitions
+    std::vector<double> targets;    // Target fraction of each partition
+    std::vector<std::pair<int32_t, int64_t> > connections;     // Scratch of findMove(): (partition, weight of edges)
+};
+
+#endif //UNBALANCED_WORKLOAD_NATIVEPARTITIONER_H
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "structuredOwnership.h"
+
+StructuredOwnership::StructuredOwnership(const IndicesIJK num_procs, const IndicesIJK elts_glob)
+        : num_subdomains(num_procs), elts_glob(elts_glob),
+          elts_loc(elts_glob.i / num_procs.i, elts_glob.j / num_procs.j, elts_glob.k / num_procs.k) { }
+
+void StructuredOwnership::getCoords(int rank, IndicesIJK &proc_ind) const {
+
+    proc_ind.k = rank % num_subdomains.k;
+    rank /= num_subdomains.k;
+    proc_ind.j = rank % num_subdomains.j;
+    proc_ind.i = rank / num_subdomains.j;
+}
+
+void StructuredOwnership::getRange(int rank, IndicesIJK &beg, IndicesIJK &end) const {
+
+    IndicesIJK proc_ind;
+
+    getCoords(rank, proc_ind);
+    beg = IndicesIJK(proc_ind.i * elts_loc.i, proc_ind.j * elts_loc.j, proc_ind.k * elts_loc.k);
+    end.i = (proc_ind.i + 1 < num_subdomains.i) ? beg.i + elts_loc.i : elts_glob.i;
+    end.j = (proc_ind.j + 1 < num_subdomains.j) ? beg.j + elts_loc.j : elts_glob.j;
+    end.k = (proc_ind.k + 1 < num_subdomains.k) ? beg.k + elts_loc.k : elts_glob.k;
+}
+
+IndicesIJK StructuredOwnership::getExtents(int rank) const {
+
+    IndicesIJK beg, end;
+
+    getRange(rank, beg, end);
+    return IndicesIJK(end.i - beg.i, end.j - beg.j, end.k - beg.k);
+}
+
+int64_t StructuredOwnership::getNumCells(int rank) const {
+
+    IndicesIJK extents = getExtents(rank);
+
+    return (int64_t) extents.i * extents.j * extents.k;
+}
+
+void StructuredOwnership::getCells(int rank, std::vector<int32_t> &cells) const {
+
+    IndicesIJK beg, end;
+
+    getRange(rank, beg, end);
+    cells.clear();
+    cells.reserve(getNumCells(rank));
+    for (int i = beg.i; i < end.i; ++i) {
+        for (int j = beg.j; j < end.j; ++j) {
+            for (int k = beg.k; k < end.k; ++k) {
+                cells.push_back(k + elts_glob.k * (j + (int64_t) elts_glob.j * i));
+            }
+        }
+    }
+}
+
+void StructuredOwnership::fill(std::vector<int32_t> &part) const {
+
+    part.resize((int64_t) elts_glob.i * elts_glob.j * elts_glob.k);
+    for (int pid = 0; pid < getNumParts(); ++pid) {
+        IndicesIJK beg, end;
+        getRange(pid, beg, end);
+        for (int i = beg.i; i < end.i; ++i) {
+            for (int j = beg.j; j < end.j; ++j) {
+                for (int k = beg.k; k < end.k; ++k) {
+                    part[k + elts_glob.k * (j + (int64_t) elts_glob.j * i)] = pid;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_STRUCTUREDOWNERSHIP_H
+#define UNBALANCED_WORKLOAD_STRUCTUREDOWNERSHIP_H
+
+#include <vector>
+#include <cstdint>
+
+#include "../../General/structs.h"
+
+/*!
+ * \class StructuredOwnership
+ * @brief Ownership of the cells of a structured decomposition in closed form.
+ * Cells and subdomains are enumerated as k + n.k * (j + n.j * i). Each direction is split into
+ * equal ranges, the last subdomain of a direction receives the remainder of the division. The
+ * owner, the extents and the offsets of any subdomain are computed in O(1) without storing
+ * anything per cell.
+ */
+class StructuredOwnership {
+public:
+    StructuredOwnership() : num_subdomains(1, 1, 1), elts_glob(1, 1, 1), elts_loc(1, 1, 1) { }
+
+    /*!
+     * @param num_procs Number of subdomains in each direction.
+     * @param elts_glob Global number of elements/cells in each direction.
+     */
+    StructuredOwnership(const IndicesIJK num_procs, const IndicesIJK elts_glob);
+
+    ~StructuredOwnership() { }
+
+    /*!
+     * @brief Get the subdomain owning the cell (i,j,k).
+     */
+    inline int getOwner(int i, int j, int k) const {
+        return getIndex(k, elts_loc.k, num_subdomains.k)
+               + num_subdomains.k * (getIndex(j, elts_loc.j, num_subdomains.j)
+                                     + num_subdomains.j * getIndex(i, elts_loc.i, num_subdomains.i));
+    }
+
+    /*!
+     * @brief Get the subdomain owning the cell by its global ID.
+     */
+    inline int getOwner(int64_t cell) const {
+        int k = cell % elts_glob.k;
+        cell /= elts_glob.k;
+        return getOwner((int) (cell / elts_glob.j), (int) (cell % elts_glob.j), k);
+    }
+
+    /*!
+     * @brief Get coordinates of the subdomain in the grid of subdomains.
+     */
+    void getCoords(int rank, IndicesIJK &proc_ind) const;
+
+    /*!
+     * @brief Get the range of global indices of the subdomain in each direction.
+     * @param beg [out] Indices of the very first cell.
+     * @param end [out] Indices following the very last cell.
+     */
+    void getRange(int rank, IndicesIJK &beg, IndicesIJK &end) const;
+
+    /*!
+     * @brief Get number of cells of the subdomain in each direction.
+     */
+    IndicesIJK getExtents(int rank) const;
+
+    /*!
+     * @brief Get number of cells of the subdomain.
+     */
+    int64_t getNumCells(int rank) const;
+
+    /*!
+     * @brief Get global IDs of the cells of the subdomain in ascending order.
+     */
+    void getCells(int rank, std::vector<int32_t> &cells) const;
+
+    /*!
+     * @brief Fill in the partitioning of the whole domain, for the consumers which need it explicitly.
+     */
+    void fill(std::vector<int32_t> &part) const;
+
+    /*!
+     * @brief Get number of subdomains.
+     */
+    inline int getNumParts() const {
+        return num_subdomains.i * num_subdomains.j * num_subdomains.k;
+    }
+
+    inline const IndicesIJK& getProcessGrid() const {
+        return num_subdomains;
+    }
+
+    inline const IndicesIJK& getGlobalSize() const {
+        return elts_glob;
+    }
+
+private:
+    /*!
+     * @brief Get index of the subdomain in one direction, the last one owns the remainder.
+     * @param ind Global index of the cell in the direction.
+     * @param elts Number of cells of the subdomains except for the last one.
+     * @param num Number of subdomains in the direction.
+     */
+    static inline int getIndex(int ind, int elts, int num) {
+        if (elts == 0)
+            return num - 1;
+        int proc_ind = ind / elts;
+        return (proc_ind < num) ? proc_ind : num - 1;
+    }
+
+private:
+    IndicesIJK num_subdomains;  // Number of subdomains in each direction
+    IndicesIJK elts_glob;       // Global number of cells in each direction
+    IndicesIJK elts_loc;        // Number of cells of the subdomains in each direction, except for the last ones
+};
+
+#endif //UNBALANCED_WORKLOAD_STRUCTUREDOWNERSHIP_H
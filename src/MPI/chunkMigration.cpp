@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <sstream>
+#include <iomanip>
+
+#include "chunkMigration.h"
+
+void ChunkMigration::initialize(Graph& graph, std::vector<int32_t>& partitioning,
+                                const std::vector<int32_t>& chunk_of_cells, const std::vector<int32_t>& chunk_owners) {
+
+    this->graph = &graph;
+    glob_part = &partitioning;
+    chunks = chunk_of_cells;
+    owners = chunk_owners;
+    num_moves = 0;
+    num_cells = 0;
+
+    glob_part->resize(chunks.size());
+    for (size_t cell = 0; cell < chunks.size(); ++cell)
+        (*glob_part)[cell] = owners[chunks[cell]];
+    collectLocalChunks();
+}
+
+int32_t ChunkMigration::rebalance(Field& field, Halo& halo) {
+
+    int num_procs = getNumProcs();
+    std::vector<double> costs(owners.size(), 0.);
+    std::vector<ChunkMove> moves;
+    int32_t counts[2] = {0, 0};        // Moved chunks and cells
+
+    /* Each chunk is measured by its owner only */
+    for (size_t n = 0; n < local_chunks.size(); ++n)
+        costs[local_chunks[n]] += cell_costs[n];
+    MPI_Allreduce(MPI_IN_PLACE, costs.data(), costs.size(), MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    double imbalance = ChunkMapper::getImbalance(costs, num_procs, owners);
+
+    if (getMyRank() == root_pid) {
+        mapper.remap(costs, num_procs, owners, moves);
+        counts[0] = moves.size();
+        for (size_t cell = 0; cell < chunks.size(); ++cell)
+            counts[1] += (owners[chunks[cell]] != (*glob_part)[cell]);
+    }
+    broadcastFromRoot(counts, 2, root_pid);
+    if (counts[0] == 0)
+        return 0;
+    broadcastFromRoot(owners.data(), owners.size(), root_pid);
+
+    /* Cells of the moved chunks go directly to their new owners */
+    std::vector<int32_t> new_part(chunks.size());
+    for (size_t cell = 0; cell < chunks.size(); ++cell)
+        new_part[cell] = owners[chunks[cell]];
+    field.migrate(glob_part->data(), new_part.data(), chunks.size());
+    glob_part->swap(new_part);
+
+    /* Chunks and the graph are known by all processes, so each one extracts the rows of its new cells */
+    LocalGraph local_graph;
+    local_graph.extract(*graph, glob_part->data(), getMyRank(), field.getGlobalIDs());
+    halo.build(local_graph, field.getNumComponents(), halo.getWireFormat().getPrecision());
+    collectLocalChunks();
+
+    num_moves += counts[0];
+    num_cells += counts[1];
+
+    std::ostringstream balance;
+    balance << std::fixed << std::setprecision(3) << imbalance << " -> "
+            << ChunkMapper::getImbalance(costs, num_procs, owners);
+    printByRoot("Migrated " + std::to_string(counts[0]) + " chunks (" + std::to_string(counts[1])
+                + " cells), measured imbalance " + balance.str());
+    return counts[0];
+}
+
+void ChunkMigration::collectLocalChunks() {
+
+    int my_rank = getMyRank();
+
+    local_chunks.clear();
+    for (size_t cell = 0; cell < chunks.size(); ++cell) {
+        if ((*glob_part)[cell] == my_rank)
+            local_chunks.push_back(chunks[cell]);
+    }
+    cell_costs.assign(local_chunks.size(), 0.);
+}
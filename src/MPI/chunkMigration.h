@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_CHUNKMIGRATION_H
+#define UNBALANCED_WORKLOAD_CHUNKMIGRATION_H
+
+#include <vector>
+
+#include "../common.h"
+#include "../graph.h"
+#include "../field.h"
+#include "halo.h"
+#include "Decomposition/chunkMapper.h"
+
+/*!
+ * \class ChunkMigration
+ * @brief Rebalances an over-decomposed domain at run time by moving whole chunks between processes.
+ * The cost of each local cell is measured during the steps and summed up per chunk. Once the
+ * measured load of the processes exceeds the tolerance, the root process remaps a few chunks (see
+ * \e ChunkMapper::remap()), the cells of the moved chunks are sent directly to their new owners and
+ * the halo is rebuilt. Chunks and their owners are known by all processes.
+ */
+class ChunkMigration {
+public:
+    ChunkMigration() : graph(NULL), glob_part(NULL), root_pid(0), num_moves(0), num_cells(0) { }
+
+    ~ChunkMigration() { }
+
+    /*!
+     * @brief Set up the chunks, the partitioning of cells is derived from their owners.
+     * @param graph Graph of the domain.
+     * @param partitioning [out] Partitioning of cells, i.e. the owner of the chunk of each cell. It is
+     *                     updated by the migrations and must outlive this object.
+     * @param chunk_of_cells Chunk of each cell.
+     * @param chunk_owners Process of each chunk.
+     */
+    void initialize(Graph& graph, std::vector<int32_t>& partitioning, const std::vector<int32_t>& chunk_of_cells,
+                    const std::vector<int32_t>& chunk_owners);
+
+    /*!
+     * @brief Get costs of the local cells measured since the last migration, to be increased by the work.
+     */
+    inline std::vector<double>& getCellCosts() {
+        return cell_costs;
+    }
+
+    /*!
+     * @brief Migrate chunks if the measured load is out of balance, has to be called by all processes.
+     * @param field Local field, redistributed by the migration.
+     * @param halo Halo of the field, rebuilt after the migration.
+     * @return Number of moved chunks.
+     */
+    int32_t rebalance(Field& field, Halo& halo);
+
+    /*!
+     * @brief Set allowed imbalance of the measured load.
+     */
+    inline void setTolerance(double value) {
+        mapper.setTolerance(value);
+    }
+
+    /*!
+     * @brief Get the total number of moved chunks.
+     */
+    inline int64_t getNumMoves() {
+        return num_moves;
+    }
+
+    /*!
+     * @brief Get the total number of moved cells.
+     */
+    inline int64_t getNumMovedCells() {
+        return num_cells;
+    }
+
+private:
+    /*!
+     * @brief Find the chunk of each local cell and reset the measured costs.
+     */
+    void collectLocalChunks();
+
+private:
+    Graph* graph;                       // Graph of the domain
+    std::vector<int32_t>* glob_part;    // Partitioning of cells
+    std::vector<int32_t> chunks;        // Chunk of each cell
+    std::vector<int32_t> owners;        // Process of each chunk
+    std::vector<int32_t> local_chunks;  // Chunk of each local cell
+    std::vector<double> cell_costs;     // Measured cost of each local cell
+    ChunkMapper mapper;
+    int root_pid;                       // Process remapping the chunks
+    int64_t num_moves;                  // Total number of moved chunks
+    int64_t num_cells;                  // Total number of moved cells
+};
+
+#endif //UNBALANCED_WORKLOAD_CHUNKMIGRATION_H
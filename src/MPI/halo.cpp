@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "halo.h"
+
+void Halo::build(const LocalGraph& local_graph, int num_comps, WirePrecision precision) {
+
+    int my_rank = local_graph.getRank();
+    const std::vector<int32_t> &loc_offsets = local_graph.getOffsets();
+    const std::vector<int32_t> &loc_nodes = local_graph.getNodes();
+    std::vector<int32_t> ghost_id(local_graph.getHaloCells().size(), EMPTY);
+    std::vector<std::pair<int, int32_t> > rcv_pairs;    // (owner, global ID) of ghost cells
+    std::vector<std::pair<int, int32_t> > snd_pairs;    // (destination, local ID) of sent cells
+
+    clear();
+    num_components = num_comps;
+    wire = WireFormat(precision);
+
+    /* Local cells keep the order of global IDs, i.e. the order of the rows of the local graph */
+    num_local = local_graph.getNumRows();
+
+    for (int32_t row = 0; row < num_local; ++row) {
+        for (int32_t ckey = loc_offsets[row]; ckey < loc_offsets[row + 1]; ++ckey) {
+            int32_t col = loc_nodes[ckey];
+            int owner = local_graph.getOwner(col);
+            if (owner != my_rank) {
+                rcv_pairs.push_back(std::make_pair(owner, col));
+                snd_pairs.push_back(std::make_pair(owner, row));
+            }
+        }
+    }
+
+    std::sort(rcv_pairs.begin(), rcv_pairs.end());
+    rcv_pairs.erase(std::unique(rcv_pairs.begin(), rcv_pairs.end()), rcv_pairs.end());
+    std::sort(snd_pairs.begin(), snd_pairs.end());
+    snd_pairs.erase(std::unique(snd_pairs.begin(), snd_pairs.end()), snd_pairs.end());
+
+    /* Ghost cells follow the local ones */
+    int32_t num_ghosts = rcv_pairs.size();
+    rcv_offsets.push_back(0);
+    for (int32_t n = 0; n < num_ghosts; ++n) {
+        ghost_id[local_graph.getHaloID(rcv_pairs[n].second)] = num_local + n;
+        if (n > 0 && rcv_pairs[n].first != rcv_pairs[n - 1].first)
+            rcv_offsets.push_back(n);
+        if (n == 0 || rcv_pairs[n].first != rcv_pairs[n - 1].first)
+            neighbors.push_back(rcv_pairs[n].first);
+    }
+    rcv_offsets.push_back(num_ghosts);
+
+    /* The graph is symmetric, so cells are sent to the same processes ghosts are received from */
+    int32_t num_sent = snd_pairs.size();
+    snd_offsets.assign(1, 0);
+    for (int32_t n = 0, nid = 0; n < num_sent; ++n) {
+        while (snd_pairs[n].first != neighbors[nid]) {
+            snd_offsets.push_back(n);
+            ++nid;
+        }
+        snd_cells.push_back(snd_pairs[n].second);
+    }
+    snd_offsets.push_back(num_sent);
+
+    /* Local subgraph and the split into interior and boundary cells */
+    offsets.push_back(0);
+    for (int32_t row = 0; row < num_local; ++row) {
+        bool is_boundary = false;
+        for (int32_t ckey = loc_offsets[row]; ckey < loc_offsets[row + 1]; ++ckey) {
+            int32_t hid = local_graph.getHaloID(loc_nodes[ckey]);
+            int32_t col = (hid == EMPTY) ? local_graph.getLocalID(loc_nodes[ckey]) : ghost_id[hid];
+            nodes.push_back(col);
+            if (col >= num_local)
+                is_boundary = true;
+        }
+        offsets.push_back(nodes.size());
+        if (is_boundary)
+            boundary.push_back(row);
+        else
+            interior.push_back(row);
+    }
+
+    snd_buffer.resize(snd_cells.size() * num_components);
+    ghosts.resize(rcv_pairs.size() * num_components);
+    if (precision != WIRE_DOUBLE) {
+        snd_wire.resize(wire.getBytes(snd_buffer.size()));
+        rcv_wire.resize(wire.getBytes(ghosts.size()));
+    }
+    requests.resize(2 * neighbors.size());
+}
+
+void Halo::build(const StructuredOwnership& ownership, int stencil, int num_comps, WirePrecision precision) {
+
+    LocalGraph local_graph;
+
+    local_graph.generate(ownership, getMyRank(), stencil);
+    build(local_graph, num_comps, precision);
+}
+
+void Halo::clear() {
+
+    num_local = 0;
+    offsets.clear();
+    nodes.clear();
+    interior.clear();
+    boundary.clear();
+    neighbors.clear();
+    snd_offsets.clear();
+    snd_cells.clear();
+    rcv_offsets.clear();
+    snd_buffer.clear();
+    ghosts.clear();
+    snd_wire.clear();
+    rcv_wire.clear();
+    requests.clear();
+}
+
+void Halo::begin(Field &field) {
+
+    int tag = 170;
+    int num_ngbs = neighbors.size();
+    bool convert = wire.getPrecision() != WIRE_DOUBLE;
+    int value_size = wire.getValueSize();
+
+    /* Post receives first, so the incoming messages do not need to be buffered */
+    for (int n = 0; n < num_ngbs; ++n) {
+        int64_t first = (int64_t) rcv_offsets[n] * num_components;
+        int count = (rcv_offsets[n + 1] - rcv_offsets[n]) * num_components;
+        if (convert)
+            MPI_Irecv(rcv_wire.data() + first * value_size, count * value_size, MPI_BYTE,
+                      neighbors[n], tag, MPI_COMM_WORLD, &requests[n]);
+        else
+            MPI_Irecv(ghosts.data() + first, count, MPI_DOUBLE, neighbors[n], tag, MPI_COMM_WORLD, &requests[n]);
+    }
+
+    field.pack(snd_cells.data(), snd_cells.size(), snd_buffer.data());
+    if (convert)
+        wire.encode(snd_buffer.data(), snd_buffer.size(), snd_wire.data());
+
+    for (int n = 0; n < num_ngbs; ++n) {
+        int64_t first = (int64_t) snd_offsets[n] * num_components;
+        int count = (snd_offsets[n + 1] - snd_offsets[n]) * num_components;
+        if (convert)
+            MPI_Isend(snd_wire.data() + first * value_size, count * value_size, MPI_BYTE,
+                      neighbors[n], tag, MPI_COMM_WORLD, &requests[num_ngbs + n]);
+        else
+            MPI_Isend(snd_buffer.data() + first, count, MPI_DOUBLE, neighbors[n], tag, MPI_COMM_WORLD,
+                      &requests[num_ngbs + n]);
+    }
+}
+
+double Halo::end() {
+
+    double start = getWallTime();
+    double wait_time;
+
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    wait_time = getWallTime() - start;
+
+    if (wire.getPrecision() != WIRE_DOUBLE)
+        wire.decode(rcv_wire.data(), ghosts.size(), ghosts.data());
+    return wait_time;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_HALO_H
+#define UNBALANCED_WORKLOAD_HALO_H
+
+#include <vector>
+
+#include "../common.h"
+#include "../localGraph.h"
+#include "../field.h"
+#include "wireFormat.h"
+
+/*!
+ * \class Halo
+ * @brief Exchange of ghost cells between neighboring processes.
+ * Local cells are the cells owned by the process in ascending order of their global IDs, i.e.
+ * the order produced by \e Field::distribute(). Ghost cells are stored right after the local
+ * ones, grouped by the owner (in ascending order of ranks) and sorted by the global ID within
+ * each group. Since the graph is symmetric, the owner sends its cells in the same order without
+ * any negotiation. All components of the field are exchanged in a single message per neighbor.
+ * Messages may be sent in a reduced precision (see \e WireFormat), ghost cells are converted
+ * back to doubles by \e end().
+ */
+class Halo {
+public:
+    Halo() : num_local(0), num_components(1) { }
+
+    ~Halo() { clear(); }
+
+    /*!
+     * @brief Build the local subgraph, the lists of interior and boundary cells and the
+     * communication pattern.
+     * @param local_graph Rows of the local cells and owners of the halo cells (see \e Field::distribute())
+     * @param num_comps Number of components of the exchanged field
+     * @param precision Precision of the exchanged values
+     */
+    void build(const LocalGraph& local_graph, int num_comps = 1, WirePrecision precision = WIRE_DOUBLE);
+
+    /*!
+     * @brief Build the halo of the structured decomposition from the range of the local subdomain and
+     * the owners of its neighbors, see \e LocalGraph::generate().
+     * @param ownership Ownership of the cells, known by all processes
+     * @param stencil Stencil of the graph: 7 (face neighbors) or 27 (all neighbors)
+     */
+    void build(const StructuredOwnership& ownership, int stencil, int num_comps = 1,
+               WirePrecision precision = WIRE_DOUBLE);
+
+    void clear();
+
+    /*!
+     * @brief Post the nonblocking exchange of the ghost cells.
+     * @param field Field of the local cells.
+     */
+    void begin(Field &field);
+
+    /*!
+     * @brief Complete the exchange posted by \e begin() and convert the ghost cells.
+     * @return Time spent in \e MPI_Waitall.
+     */
+    double end();
+
+    /*!
+     * @brief Get number of local cells.
+     */
+    inline int32_t getNumLocal() {
+        return num_local;
+    }
+
+    /*!
+     * @brief Get cells that do not depend on ghost cells.
+     */
+    inline std::vector<int32_t>& getInterior() {
+        return interior;
+    }
+
+    /*!
+     * @brief Get cells that depend on at least one ghost cell.
+     */
+    inline std::vector<int32_t>& getBoundary() {
+        return boundary;
+    }
+
+    /*!
+     * @brief Get offsets of the local subgraph (CSR).
+     */
+    inline std::vector<int32_t>& getOffsets() {
+        return offsets;
+    }
+
+    /*!
+     * @brief Get neighbors of the local cells, IDs starting from \e getNumLocal() refer to ghost cells.
+     */
+    inline std::vector<int32_t>& getNodes() {
+        return nodes;
+    }
+
+    /*!
+     * @brief Get a component of the ghost cell received by the last exchange.
+     * @param comp Index of the component.
+     * @param ghost Index of the ghost cell, i.e. its ID minus \e getNumLocal().
+     */
+    inline double getGhost(int comp, int32_t ghost) {
+        return ghosts[(int64_t) ghost * num_components + comp];
+    }
+
+    /*!
+     * @brief Get neighboring processes.
+     */
+    inline std::vector<int>& getNeighbors() {
+        return neighbors;
+    }
+
+    /*!
+     * @brief Get the wire format, it keeps the conversion errors of the exchanges.
+     */
+    inline WireFormat& getWireFormat() {
+        return wire;
+    }
+
+private:
+    int32_t num_local;                  // Number of local cells
+    int num_components;                 // Number of components of the exchanged field
+    std::vector<int32_t> offsets;       // Local subgraph (CSR)
+    std::vector<int32_t> nodes;
+    std::vector<int32_t> interior;      // Cells without ghost neighbors
+    std::vector<int32_t> boundary;      // Cells with ghost neighbors
+    std::vector<int> neighbors;         // Neighboring processes
+    std::vector<int32_t> snd_offsets;   // Range of sent cells for each neighbor
+    std::vector<int32_t> snd_cells;     // Local IDs of sent cells
+    std::vector<int32_t> rcv_offsets;   // Range of ghost cells for each neighbor
+    std::vector<double> snd_buffer;
+    std::vector<double> ghosts;
+    WireFormat wire;                    // Conversion of the messages
+    std::vector<char> snd_wire;         // Converted messages (unless sent as doubles)
+    std::vector<char> rcv_wire;
+    std::vector<MPI_Request> requests;
+};
+
+#endif //UNBALANCED_WORKLOAD_HALO_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <map>
+
+#include "nodeLayout.h"
+
+void NodeLayout::discover() {
+
+    MPI_Comm node_comm;
+    int leader = getMyRank();
+    int root_pid = 0;
+    std::vector<int32_t> leaders(getNumProcs());
+
+    /* The lowest rank of the node is its rank 0, since the ranks keep their order */
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, getMyRank(), MPI_INFO_NULL, &node_comm);
+    MPI_Bcast(&leader, 1, MPI_INT, 0, node_comm);
+    MPI_Comm_free(&node_comm);
+
+    MPI_Gather(&leader, 1, MPI_INT, leaders.data(), 1, MPI_INT, root_pid, MPI_COMM_WORLD);
+    broadcastFromRoot(leaders.data(), leaders.size(), root_pid);
+    assignNodes(leaders);
+}
+
+void NodeLayout::emulate(int num_ranks, int ranks_per_node) {
+
+    std::vector<int32_t> leaders(num_ranks);
+
+    for (int rank = 0; rank < num_ranks; ++rank)
+        leaders[rank] = rank - rank % ranks_per_node;
+    assignNodes(leaders);
+}
+
+void NodeLayout::assignNodes(const std::vector<int32_t>& leaders) {
+
+    std::map<int32_t, int32_t> node_of_leaders;
+    int32_t num_ranks = leaders.size();
+
+    node_of_ranks.resize(leaders.size());
+    ranks_of_nodes.clear();
+    for (int32_t rank = 0; rank < num_ranks; ++rank) {
+        if (node_of_leaders.find(leaders[rank]) == node_of_leaders.end()) {
+            int32_t node = node_of_leaders.size();
+            node_of_leaders[leaders[rank]] = node;
+            ranks_of_nodes.push_back(std::vector<int32_t>());
+        }
+        node_of_ranks[rank] = node_of_leaders[leaders[rank]];
+        ranks_of_nodes[node_of_ranks[rank]].push_back(rank);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_NODELAYOUT_H
+#define UNBALANCED_WORKLOAD_NODELAYOUT_H
+
+#include <vector>
+#include <cstdint>
+
+#include "../common.h"
+
+/*!
+ * \class NodeLayout
+ * @brief Assignment of processes to the nodes (shared memory domains) of the machine.
+ * Nodes are numbered in the order of their lowest ranks, the ranks of each node are in ascending order.
+ */
+class NodeLayout {
+public:
+    NodeLayout() { }
+
+    ~NodeLayout() { }
+
+    /*!
+     * @brief Discover the nodes via \e MPI_Comm_split_type(), must be called by all processes.
+     */
+    void discover();
+
+    /*!
+     * @brief Group consecutive ranks into nodes of the given size instead of discovering them, e.g.
+     * to emulate a cluster on a single machine or to plan a dry run.
+     * @param num_ranks Total number of ranks.
+     * @param ranks_per_node Number of ranks of each node, the last node might have fewer.
+     */
+    void emulate(int num_ranks, int ranks_per_node);
+
+    inline int getNumNodes() {
+        return ranks_of_nodes.size();
+    }
+
+    /*!
+     * @brief Get the node of each rank.
+     */
+    inline std::vector<int32_t>& getNodeOfRanks() {
+        return node_of_ranks;
+    }
+
+    /*!
+     * @brief Get the ranks of the node in ascending order.
+     */
+    inline std::vector<int32_t>& getRanks(int node) {
+        return ranks_of_nodes[node];
+    }
+
+private:
+    /*!
+     * @brief Number the nodes by their lowest ranks and list the ranks of each node.
+     * @param leaders Lowest rank of the node of each rank.
+     */
+    void assignNodes(const std::vector<int32_t>& leaders);
+
+private:
+    std::vector<int32_t> node_of_ranks;                 // Node of each rank
+    std::vector<std::vector<int32_t> > ranks_of_nodes;  // Ranks of each node
+};
+
+#endif //UNBALANCED_WORKLOAD_NODELAYOUT_H
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "reductionBatch.h"
+
+MPI_Datatype ReductionBatch::entry_type = MPI_DATATYPE_NULL;
+MPI_Op ReductionBatch::combine_op = MPI_OP_NULL;
+
+void ReductionBatch::add(double &value, Operation op) {
+
+    Entry entry;
+    entry.value.real = value;
+    entry.type = TYPE_DOUBLE;
+    entry.op = op;
+    entries.push_back(entry);
+    targets.push_back(&value);
+}
+
+void ReductionBatch::add(int &value, Operation op) {
+
+    Entry entry;
+    entry.value.integer = value;
+    entry.type = TYPE_INT;
+    entry.op = op;
+    entries.push_back(entry);
+    targets.push_back(&value);
+}
+
+void ReductionBatch::add(int64_t &value, Operation op) {
+
+    Entry entry;
+    entry.value.integer = value;
+    entry.type = TYPE_INT64;
+    entry.op = op;
+    entries.push_back(entry);
+    targets.push_back(&value);
+}
+
+void ReductionBatch::flush() {
+
+    if (entries.empty())
+        return;
+
+    createTypes();
+    MPI_Allreduce(MPI_IN_PLACE, entries.data(), entries.size(), entry_type, combine_op, MPI_COMM_WORLD);
+    writeBack();
+}
+
+void ReductionBatch::start() {
+
+    if (entries.empty())
+        return;
+
+    createTypes();
+    MPI_Iallreduce(MPI_IN_PLACE, entries.data(), entries.size(), entry_type, combine_op, MPI_COMM_WORLD,
+                   &request);
+    active = true;
+}
+
+bool ReductionBatch::test() {
+
+    int completed = 1;
+
+    if (active) {
+        MPI_Test(&request, &completed, MPI_STATUS_IGNORE);
+        if (completed) {
+            active = false;
+            writeBack();
+        }
+    }
+    return completed;
+}
+
+void ReductionBatch::wait() {
+
+    if (active) {
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
+        active = false;
+        writeBack();
+    }
+}
+
+void ReductionBatch::clear() {
+
+    wait();
+    entries.clear();
+    targets.clear();
+}
+
+void ReductionBatch::combine(void *in, void *inout, int *len, MPI_Datatype * /* datatype */) {
+
+    Entry *src = static_cast<Entry*>(in);
+    Entry *dst = static_cast<Entry*>(inout);
+
+    for (int n = 0; n < *len; ++n) {
+        if (src[n].type == TYPE_DOUBLE) {
+            double a = src[n].value.real;
+            double &b = dst[n].value.real;
+            b = (src[n].op == OP_SUM) ? a + b : (src[n].op == OP_MIN) ? std::min(a, b) : std::max(a, b);
+        }
+        else {
+            int64_t a = src[n].value.integer;
+            int64_t &b = dst[n].value.integer;
+            b = (src[n].op == OP_SUM) ? a + b : (src[n].op == OP_MIN) ? std::min(a, b) : std::max(a, b);
+        }
+    }
+}
+
+void ReductionBatch::createTypes() {
+
+    /* Both are kept until MPI_Finalize, the batches are reduced by the same operation */
+    if (entry_type == MPI_DATATYPE_NULL) {
+        MPI_Type_contiguous(sizeof(Entry), MPI_BYTE, &entry_type);
+        MPI_Type_commit(&entry_type);
+        MPI_Op_create(&ReductionBatch::combine, 1, &combine_op);
+    }
+}
+
+void ReductionBatch::writeBack() {
+
+    for (size_t n = 0; n < entries.size(); ++n) {
+        if (entries[n].type == TYPE_DOUBLE)
+            *static_cast<double*>(targets[n]) = entries[n].value.real;
+        else if (entries[n].type == TYPE_INT)
+            *static_cast<int*>(targets[n]) = entries[n].value.integer;
+        else
+            *static_cast<int64_t*>(targets[n]) = entries[n].value.integer;
+    }
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_REDUCTIONBATCH_H
+#define UNBALANCED_WORKLOAD_REDUCTIONBATCH_H
+
+#include <vector>
+
+#include "../common.h"
+
+/*!
+ * \class ReductionBatch
+ * @brief Fuses global reductions of several values into a single one.
+ * Values of mixed types are queued together with their operations and reduced by a single
+ * \e MPI_Allreduce (or \e MPI_Iallreduce) over packed entries with a user-defined operation.
+ * Results are written back to the queued variables, so they must stay alive until the batch
+ * is completed.
+ */
+class ReductionBatch {
+public:
+    enum Operation {
+        OP_SUM,
+        OP_MIN,
+        OP_MAX,
+    };
+
+    ReductionBatch() : active(false) { }
+
+    ~ReductionBatch() { clear(); }
+
+    /*!
+     * @brief Queue the value.
+     * @param value Variable storing the local value and receiving the global one.
+     * @param op Reduction operation.
+     */
+    void add(double &value, Operation op);
+
+    void add(int &value, Operation op);
+
+    void add(int64_t &value, Operation op);
+
+    /*!
+     * @brief Reduce all queued values and write the results back.
+     */
+    void flush();
+
+    /*!
+     * @brief Start the nonblocking reduction of all queued values.
+     * Local values are copied, so the variables can be modified until \e wait() is called.
+     */
+    void start();
+
+    /*!
+     * @brief Check if the nonblocking reduction is completed, results are written back if so.
+     */
+    bool test();
+
+    /*!
+     * @brief Complete the nonblocking reduction and write the results back.
+     */
+    void wait();
+
+    /*!
+     * @brief Remove all queued values, the active reduction (if any) is completed first.
+     */
+    void clear();
+
+    inline int getSize() {
+        return entries.size();
+    }
+
+private:
+    /*!
+     * @brief Packed value together with its type and operation.
+     */
+    struct Entry {
+        union {
+            double real;
+            int64_t integer;
+        } value;
+        int32_t type;       // One of TYPE_*
+        int32_t op;         // One of Operation
+    };
+
+    enum Type {
+        TYPE_DOUBLE,
+        TYPE_INT,
+        TYPE_INT64,
+    };
+
+    /*!
+     * @brief User-defined reduction operation combining the entries one by one.
+     */
+    static void combine(void *in, void *inout, int *len, MPI_Datatype *datatype);
+
+    /*!
+     * @brief Create the MPI datatype and operation on the first use.
+     */
+    static void createTypes();
+
+    /*!
+     * @brief Copy the results into the queued variables.
+     */
+    void writeBack();
+
+private:
+    std::vector<Entry> entries;
+    std::vector<void*> targets;     // Variables receiving the results
+    MPI_Request request;
+    bool active;                    // A nonblocking reduction is in progress
+
+    static MPI_Datatype entry_type;
+    static MPI_Op combine_op;
+};
+
+#endif //UNBALANCED_WORKLOAD_REDUCTIONBATCH_H
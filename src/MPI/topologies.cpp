@@ -22,67 +22,383 @@
 
 #include <algorithm>
 #include <map>
+#include <climits>
+#include <cstdlib>
 
 #include "topologies.h"
 
-void Topologies::createCartTopology(IndicesIJ struct_part) {
+void Topologies::createCartTopology(IndicesIJ struct_part, IndicesIJ periodic) {
 
-    int ndims;
-    int dims[2];
-    int periods[2];
-    int reorder;
+    int sizes[2] = {struct_part.i, struct_part.j};
+    int periodic_dims[2] = {periodic.i, periodic.j};
 
-    /*
-     * Define the above variables and create a Cartesian topology
-     * Hints:
-     *  - use already declared private variable `comm` to store the communicator
-     */
-    NOT_IMPLEMENTED
+    createCartTopology(2, sizes, periodic_dims);
+}
+
+void Topologies::createCartTopology(IndicesIJK struct_part, IndicesIJK periodic) {
+
+    int sizes[3] = {struct_part.i, struct_part.j, struct_part.k};
+    int periodic_dims[3] = {periodic.i, periodic.j, periodic.k};
+
+    createCartTopology(3, sizes, periodic_dims);
+}
+
+void Topologies::createCartTopology(int ndims, const int *sizes, const int *periodic) {
+
+    int cart_rank = EMPTY;
+
+    freeComms();
+    dims.assign(sizes, sizes + ndims);
+    periods.resize(ndims);
+    for (int d = 0; d < ndims; ++d) {
+        periods[d] = (periodic[d] != 0) ? 1 : 0;
+    }
+
+    /* The last dimension changes fastest, which matches the enumeration used by DecompositionStruct */
+    MPI_Cart_create(MPI_COMM_WORLD, ndims, dims.data(), periods.data(), reorder, &comm);
+
+    /* Processes outside of the grid are not part of the topology */
+    if (comm == MPI_COMM_NULL)
+        return;
+
+    coords.resize(ndims);
+    MPI_Comm_rank(comm, &cart_rank);
+    MPI_Cart_coords(comm, cart_rank, ndims, coords.data());
+
+    /* Neighbors across each face of the sub-domain */
+    lower_neighbors.resize(ndims);
+    upper_neighbors.resize(ndims);
+    for (int d = 0; d < ndims; ++d) {
+        MPI_Cart_shift(comm, d, 1, &lower_neighbors[d], &upper_neighbors[d]);
+    }
+
+    /* Each line keeps a single dimension, so the reductions along it involve only its processes */
+    line_comms.resize(ndims);
+    for (int d = 0; d < ndims; ++d) {
+        std::vector<int> remain_dims(ndims, 0);
+        remain_dims[d] = 1;
+        MPI_Cart_sub(comm, remain_dims.data(), &line_comms[d]);
+    }
+}
+
+void Topologies::reduceAlong(int dim, double *values, int count, MPI_Op op) {
+
+    MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_DOUBLE, op, line_comms[dim]);
+}
+
+void Topologies::reduceAlong(int dim, int *values, int count, MPI_Op op) {
+
+    MPI_Allreduce(MPI_IN_PLACE, values, count, MPI_INT, op, line_comms[dim]);
+}
+
+void Topologies::broadcastAlong(int dim, double *values, int count, int root_coord) {
+
+    MPI_Bcast(values, count, MPI_DOUBLE, root_coord, line_comms[dim]);
+}
+
+void Topologies::broadcastAlong(int dim, int *values, int count, int root_coord) {
+
+    MPI_Bcast(values, count, MPI_INT, root_coord, line_comms[dim]);
 }
 
 void Topologies::createGraphTopology(DecompositionMetis& decomp_metis, int root_pid) {
 
     std::vector<int> loc_map_of_ngb;
-    int reorder = 0;
+    std::vector<int> loc_map_of_sent;
+    std::vector<int> loc_map_of_received;
 
     /* Distribute the graph across all processes (at this point,
      * it is only stored by the root process) */
-    loc_map_of_ngb = distributeGraph(decomp_metis, root_pid);
+    loc_map_of_ngb = distributeGraph(decomp_metis, root_pid, loc_map_of_sent, loc_map_of_received);
+
+    /* Create a bidirected graph, i.e. sources == destinations, the message sizes differ by direction */
+    sources = destinations = loc_map_of_ngb;
+    source_weights = loc_map_of_received;
+    destination_weights = loc_map_of_sent;
+    createDistGraph();
+}
+
+void Topologies::createGraphTopology(const LocalGraph& local_graph) {
 
-    /*
-     * Create a distributed adjacent graph topology
-     * Hints:
-     *  - create bidirected graph, i.e. sources == destinations
-     *  - use already declared private variable `comm` to store the communicator
-     *  - get number of neighbors: loc_map_of_ngb.size()
-     *  - get a list of neighbors: loc_map_of_ngb.data()
-     */
-    NOT_IMPLEMENTED
+    /* Each process finds its own neighbors, the root process is not involved */
+    discoverNeighbors(local_graph);
+    createDistGraph();
 }
 
-void Topologies::testCartTopology() {
+void Topologies::createGraphTopology(const StructuredOwnership& ownership, int stencil) {
 
-    /*
-     * Get coordinates of the process by rank
-     * Get rank of the process by the coordinates
-     * Perform shift and test what processes are visible to the current one
-     */
-    NOT_IMPLEMENTED
+    int my_rank = getMyRank();
+    const IndicesIJK &grid = ownership.getProcessGrid();
+    IndicesIJK coords, beg, end;
+
+    sources.clear();
+    destinations.clear();
+    source_weights.clear();
+    destination_weights.clear();
+
+    ownership.getCoords(my_rank, coords);
+    ownership.getRange(my_rank, beg, end);
+
+    /* Only the adjacent subdomains share cells, they are visited in ascending order of ranks */
+    for (int pi = std::max(coords.i - 1, 0); pi <= std::min(coords.i + 1, grid.i - 1); ++pi) {
+        for (int pj = std::max(coords.j - 1, 0); pj <= std::min(coords.j + 1, grid.j - 1); ++pj) {
+            for (int pk = std::max(coords.k - 1, 0); pk <= std::min(coords.k + 1, grid.k - 1); ++pk) {
+                IndicesIJK off(pi - coords.i, pj - coords.j, pk - coords.k);
+                int ngb_rank = pk + grid.k * (pj + grid.j * pi);
+                IndicesIJK ngb_beg, ngb_end;
+                int ni, nj, nk;
+
+                if (ngb_rank == my_rank)
+                    continue;
+                ownership.getRange(ngb_rank, ngb_beg, ngb_end);
+
+                /* Local cells sent to the neighbor, i.e. the ones with at least one graph neighbor in it */
+                if (stencil == 7) {
+                    /* Only the neighbors across a face are reached, through the offset towards them */
+                    if (std::abs(off.i) + std::abs(off.j) + std::abs(off.k) != 1)
+                        continue;
+                    ni = std::min(end.i, ngb_end.i - off.i) - std::max(beg.i, ngb_beg.i - off.i);
+                    nj = std::min(end.j, ngb_end.j - off.j) - std::max(beg.j, ngb_beg.j - off.j);
+                    nk = std::min(end.k, ngb_end.k - off.k) - std::max(beg.k, ngb_beg.k - off.k);
+                }
+                else {
+                    /* All offsets, i.e. the cells within one layer of the neighbor in each direction */
+                    ni = std::min(end.i, ngb_end.i + 1) - std::max(beg.i, ngb_beg.i - 1);
+                    nj = std::min(end.j, ngb_end.j + 1) - std::max(beg.j, ngb_beg.j - 1);
+                    nk = std::min(end.k, ngb_end.k + 1) - std::max(beg.k, ngb_beg.k - 1);
+                }
+
+                if (ni > 0 && nj > 0 && nk > 0) {
+                    destinations.push_back(ngb_rank);
+                    destination_weights.push_back(ni * nj * nk);
+                }
+            }
+        }
+    }
+
+    /* The stencil is symmetric, so each neighbor sends as many cells as it receives by the same rule */
+    sources = destinations;
+    source_weights = destination_weights;
+    createDistGraph();
+}
+
+int Topologies::testCartTopology() {
+
+    int my_rank = getMyRank();
+    int ndims = dims.size();
+    int num_errors = 0;
+    bool is_member = (comm != MPI_COMM_NULL);
+    std::string dir_names = "ijk";
+
+    /* Print the coordinates and the neighbors (lower/upper, '-' at a boundary) process-by-process */
+    for (int n = 0; n < getNumProcs(); ++n) {
+        if (n == my_rank && is_member) {
+            std::cout << n << " : (";
+            for (int d = 0; d < ndims; ++d) {
+                std::cout << coords[d] << ((d < ndims - 1) ? ", " : ")");
+            }
+            for (int d = 0; d < ndims; ++d) {
+                std::cout << " " << dir_names[d] << ": ";
+                for (int side = 0; side < 2; ++side) {
+                    int ngb = (side == 0) ? lower_neighbors[d] : upper_neighbors[d];
+                    if (ngb == MPI_PROC_NULL)
+                        std::cout << "-";
+                    else
+                        std::cout << ngb;
+                    std::cout << ((side == 0) ? "/" : "");
+                }
+            }
+            std::cout << std::endl;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    if (is_member) {
+        int rank = EMPTY;
+        int cart_rank = EMPTY;
+
+        /* The coordinates point back to the process */
+        MPI_Comm_rank(comm, &cart_rank);
+        MPI_Cart_rank(comm, coords.data(), &rank);
+        if (rank != cart_rank) {
+            std::cerr << "Error! Process " << my_rank << " has the coordinates of " << rank << "..." << std::endl;
+            ++num_errors;
+        }
+
+        for (int d = 0; d < ndims; ++d) {
+            int lower = EMPTY;
+            int sum = coords[d];
+            int first = cart_rank;
+
+            /* Each process sends its rank up, so the received one has to be the lower neighbor */
+            MPI_Sendrecv(&cart_rank, 1, MPI_INT, upper_neighbors[d], 0,
+                         &lower, 1, MPI_INT, lower_neighbors[d], 0, comm, MPI_STATUS_IGNORE);
+            if (lower_neighbors[d] != MPI_PROC_NULL && lower != lower_neighbors[d]) {
+                std::cerr << "Error! Process " << my_rank << " received " << lower << " instead of "
+                          << lower_neighbors[d] << " along " << dir_names[d] << "..." << std::endl;
+                ++num_errors;
+            }
+
+            /* The coordinates along the line sum up to 0 + 1 + ... + (dims - 1) */
+            reduceAlong(d, &sum, 1, MPI_SUM);
+            if (sum != dims[d] * (dims[d] - 1) / 2) {
+                std::cerr << "Error! Sum of the coordinates along " << dir_names[d] << " is " << sum
+                          << " on process " << my_rank << "..." << std::endl;
+                ++num_errors;
+            }
+
+            /* The first process of the line sends its rank */
+            std::vector<int> first_coords(coords);
+            first_coords[d] = 0;
+            MPI_Cart_rank(comm, first_coords.data(), &rank);
+            broadcastAlong(d, &first, 1, 0);
+            if (first != rank) {
+                std::cerr << "Error! Process " << my_rank << " received " << first << " instead of "
+                          << rank << " from the first process along " << dir_names[d] << "..." << std::endl;
+                ++num_errors;
+            }
+        }
+    }
+
+    findGlobalSum(num_errors);
+    if (num_errors > 0) {
+        printByRoot("Cartesian topology failed " + std::to_string(num_errors) + " checks...");
+        return EXIT_FAILURE;
+    }
+    printByRoot("Cartesian topology passed all checks...");
+    return EXIT_SUCCESS;
 }
 
 void Topologies::testGraphTopology() {
 
-    /*
-     * Find the number of neighboring processes
-     * Find the list of neighboring processes
-     */
-    NOT_IMPLEMENTED
+    int my_rank = getMyRank();
+    int indegree = 0;
+    int outdegree = 0;
+    int weighted = 0;
+    std::vector<int> loc_sources;
+    std::vector<int> loc_destinations;
+    std::vector<int> loc_source_weights;
+    std::vector<int> loc_destination_weights;
+
+    /* Find the number of neighboring processes */
+    MPI_Dist_graph_neighbors_count(comm, &indegree, &outdegree, &weighted);
+
+    /* Find the list of neighboring processes and the weights of the links */
+    loc_sources.resize(indegree);
+    loc_destinations.resize(outdegree);
+    loc_source_weights.resize(indegree);
+    loc_destination_weights.resize(outdegree);
+    MPI_Dist_graph_neighbors(comm, indegree, loc_sources.data(), loc_source_weights.data(),
+                             outdegree, loc_destinations.data(), loc_destination_weights.data());
+
+    /* Print the neighbors process-by-process, the number of sent cells is given in brackets */
+    for (int n = 0; n < getNumProcs(); ++n) {
+        if (n == my_rank) {
+            std::cout << n << " : ";
+            for (size_t m = 0; m < loc_destinations.size(); ++m) {
+                std::cout << loc_destinations[m];
+                if (weighted)
+                    std::cout << "(" << loc_destination_weights[m] << ")";
+                std::cout << " ";
+            }
+            if (loc_sources != loc_destinations) {
+                std::cout << "(sources: ";
+                for (size_t m = 0; m < loc_sources.size(); ++m) {
+                    std::cout << loc_sources[m] << " ";
+                }
+                std::cout << ")";
+            }
+            std::cout << std::endl;
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
 }
 
-std::vector<int> Topologies::distributeGraph(DecompositionMetis& decomp_metis, int root_pid) {
+void Topologies::reportLinkWeights(int num_components, int value_size) {
 
-    /* Note that at this point the map of all processes is stored by the root process only */
-    std::map<int32_t, std::vector<int32_t> > *map_of_procs = &decomp_metis.getMapOfProcs();
+    /* MPI_2INT is a pair of {value, index} */
+    struct { int value; int index; } loc_max = {-1, getMyRank()}, loc_min = {INT_MAX, getMyRank()};
+    int max_ngb = EMPTY, min_ngb = EMPTY;
+    int glob_max_ngb = EMPTY, glob_min_ngb = EMPTY;
+    int num_links = destinations.size();
+    int64_t cell_bytes = (int64_t) num_components * value_size;
+
+    for (int n = 0; n < num_links; ++n) {
+        if (destination_weights[n] > loc_max.value) {
+            loc_max.value = destination_weights[n];
+            max_ngb = destinations[n];
+        }
+        if (destination_weights[n] < loc_min.value) {
+            loc_min.value = destination_weights[n];
+            min_ngb = destinations[n];
+        }
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &loc_max, 1, MPI_2INT, MPI_MAXLOC, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &loc_min, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+    findGlobalSum(num_links);
+
+    if (num_links == 0) {
+        printByRoot("There are no links between processes...");
+        return;
+    }
+
+    /* Only the owners of the extreme links know the opposite ends */
+    glob_max_ngb = (loc_max.index == getMyRank()) ? max_ngb : EMPTY;
+    glob_min_ngb = (loc_min.index == getMyRank()) ? min_ngb : EMPTY;
+    MPI_Allreduce(MPI_IN_PLACE, &glob_max_ngb, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &glob_min_ngb, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    printByRoot("Number of directed links: " + std::to_string(num_links));
+    printByRoot("Heaviest link: " + std::to_string(loc_max.index) + " -> " + std::to_string(glob_max_ngb)
+                + ", " + std::to_string(loc_max.value) + " cells ("
+                + std::to_string(loc_max.value * cell_bytes) + " bytes)");
+    printByRoot("Lightest link: " + std::to_string(loc_min.index) + " -> " + std::to_string(glob_min_ngb)
+                + ", " + std::to_string(loc_min.value) + " cells ("
+                + std::to_string(loc_min.value * cell_bytes) + " bytes)");
+}
+
+void Topologies::createDistGraph() {
+
+    freeComms();
+
+    /* An empty list of weights must be marked explicitly, otherwise it might be treated as unweighted */
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+                                   sources.size(), sources.data(),
+                                   sources.empty() ? MPI_WEIGHTS_EMPTY : source_weights.data(),
+                                   destinations.size(), destinations.data(),
+                                   destinations.empty() ? MPI_WEIGHTS_EMPTY : destination_weights.data(),
+                                   MPI_INFO_NULL, reorder, &comm);
+}
+
+void Topologies::freeComms() {
+
+    int finalized = 0;
+
+    MPI_Finalized(&finalized);
+    if (!finalized) {
+        for (size_t d = 0; d < line_comms.size(); ++d) {
+            if (line_comms[d] != MPI_COMM_NULL)
+                MPI_Comm_free(&line_comms[d]);
+        }
+        if (comm != MPI_COMM_WORLD && comm != MPI_COMM_NULL)
+            MPI_Comm_free(&comm);
+    }
+
+    comm = MPI_COMM_WORLD;
+    line_comms.clear();
+    dims.clear();
+    periods.clear();
+    coords.clear();
+    lower_neighbors.clear();
+    upper_neighbors.clear();
+}
+
+std::vector<int> Topologies::distributeGraph(DecompositionMetis& decomp_metis, int root_pid,
+                                             std::vector<int> &loc_sent, std::vector<int> &loc_received) {
+
+    /* Note that at this point the graph of all processes is stored by the root process only */
+    ProcessGraph *process_graph = &decomp_metis.getProcessGraph();
     std::vector<int> loc_neighb;
     int my_rank = getMyRank();
     int num_procs = getNumProcs();
@@ -93,13 +409,30 @@ std::vector<int> Topologies::distributeGraph(DecompositionMetis& decomp_metis, i
         /* Broadcast the map from the root process */
         int tag = 159;
         if (my_rank == root_pid) {
-            loc_neighb.resize(map_of_procs->at(my_rank).size());
-            loc_neighb = map_of_procs->at(my_rank);
+            std::vector<int> received;
 
             for (int pid = 0; pid < num_procs; ++pid) {
-                if (pid == root_pid)
+                int32_t num_ngbs = process_graph->getNumNeighbors(pid);
+                int32_t *ngbs = process_graph->getNeighbors(pid);
+
+                /* The cells received from a neighbor are the ones it sends, found in its sorted row */
+                received.resize(num_ngbs);
+                for (int32_t n = 0; n < num_ngbs; ++n) {
+                    int32_t *row = process_graph->getNeighbors(ngbs[n]);
+                    int32_t *end = row + process_graph->getNumNeighbors(ngbs[n]);
+                    int32_t *pos = std::lower_bound(row, end, pid);
+                    received[n] = (pos != end && *pos == pid) ? process_graph->getCells(ngbs[n])[pos - row] : 0;
+                }
+
+                if (pid == root_pid) {
+                    loc_neighb.assign(ngbs, ngbs + num_ngbs);
+                    loc_sent.assign(process_graph->getCells(pid), process_graph->getCells(pid) + num_ngbs);
+                    loc_received = received;
                     continue;
-                MPI_Send(map_of_procs->at(pid).data(), map_of_procs->at(pid).size(), MPI_INT, pid, tag, MPI_COMM_WORLD);
+                }
+                MPI_Send(ngbs, num_ngbs, MPI_INT, pid, tag, MPI_COMM_WORLD);
+                MPI_Send(process_graph->getCells(pid), num_ngbs, MPI_INT, pid, tag + 1, MPI_COMM_WORLD);
+                MPI_Send(received.data(), num_ngbs, MPI_INT, pid, tag + 2, MPI_COMM_WORLD);
             }
         } else {
             int recv_size;
@@ -118,6 +451,12 @@ std::vector<int> Topologies::distributeGraph(DecompositionMetis& decomp_metis, i
             loc_neighb.resize(recv_size);
 
             MPI_Recv(loc_neighb.data(), loc_neighb.size(), MPI_INT, root_pid, tag, MPI_COMM_WORLD, &status);
+
+            /* Weights have the same layout as the neighbors */
+            loc_sent.resize(recv_size);
+            MPI_Recv(loc_sent.data(), loc_sent.size(), MPI_INT, root_pid, tag + 1, MPI_COMM_WORLD, &status);
+            loc_received.resize(recv_size);
+            MPI_Recv(loc_received.data(), loc_received.size(), MPI_INT, root_pid, tag + 2, MPI_COMM_WORLD, &status);
         }
     }
 
@@ -134,4 +473,77 @@ std::vector<int> Topologies::distributeGraph(DecompositionMetis& decomp_metis, i
 //    }
 
     return loc_neighb;
-}
\ No newline at end of file
+}
+
+void Topologies::discoverNeighbors(const LocalGraph& local_graph) {
+
+    int my_rank = getMyRank();
+    int tag = 160;
+    int barrier_active = 0;
+    int done = 0;
+    std::map<int, int> halo_cells;
+    std::map<int, int> halo_cells_in;
+    std::vector<int32_t> marker(getNumProcs(), EMPTY);
+    std::vector<MPI_Request> snd_requests;
+    MPI_Request barrier_request;
+
+    sources.clear();
+    destinations.clear();
+    source_weights.clear();
+    destination_weights.clear();
+
+    /* Destinations are the owners of the neighbors of the local cells. A local cell is sent to each
+     * destination once, however many of its edges lead there, so the count is the size of the halo
+     * message. The marker stores the last cell counted for the process, it never has to be reset. */
+    for (int32_t row = 0; row < local_graph.getNumRows(); ++row) {
+        for (int32_t ckey = local_graph.getOffsets()[row]; ckey < local_graph.getOffsets()[row + 1]; ++ckey) {
+            int ngb_rank = local_graph.getOwner(local_graph.getNodes()[ckey]);
+            if (ngb_rank != my_rank && marker[ngb_rank] != row) {
+                marker[ngb_rank] = row;
+                ++halo_cells[ngb_rank];
+            }
+        }
+    }
+    for (auto it = halo_cells.begin(); it != halo_cells.end(); ++it) {
+        destinations.push_back(it->first);
+        destination_weights.push_back(it->second);
+    }
+
+    /* Notify the destinations. Synchronous sends complete only once they are matched by the receiver.
+     * The message carries the number of sent cells, which becomes the weight of the incoming link. */
+    snd_requests.resize(destinations.size());
+    for (size_t n = 0; n < destinations.size(); ++n) {
+        MPI_Issend(&destination_weights[n], 1, MPI_INT, destinations[n], tag, MPI_COMM_WORLD, &snd_requests[n]);
+    }
+
+    /* Receive notifications until all processes have reached the barrier */
+    while (!done) {
+        int flag = 0;
+        MPI_Status status;
+
+        MPI_Iprobe(MPI_ANY_SOURCE, tag, MPI_COMM_WORLD, &flag, &status);
+        if (flag) {
+            int recv_cells;
+            MPI_Recv(&recv_cells, 1, MPI_INT, status.MPI_SOURCE, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            halo_cells_in[status.MPI_SOURCE] = recv_cells;
+        }
+
+        if (barrier_active) {
+            MPI_Test(&barrier_request, &done, MPI_STATUS_IGNORE);
+        }
+        else {
+            int all_sent = 0;
+            MPI_Testall(snd_requests.size(), snd_requests.data(), &all_sent, MPI_STATUSES_IGNORE);
+            if (all_sent) {
+                MPI_Ibarrier(MPI_COMM_WORLD, &barrier_request);
+                barrier_active = 1;
+            }
+        }
+    }
+
+    /* Sources arrive in an arbitrary order, the map keeps them sorted */
+    for (auto it = halo_cells_in.begin(); it != halo_cells_in.end(); ++it) {
+        sources.push_back(it->first);
+        source_weights.push_back(it->second);
+    }
+}
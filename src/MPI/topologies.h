@@ -26,45 +26,245 @@
 #include "../common.h"
 #include "../General/structs.h"
 #include "../graph.h"
+#include "../localGraph.h"
 #include "Decomposition/decompositionMetis.h"
+#include "Decomposition/structuredOwnership.h"
 
 class Topologies {
 public:
-    Topologies() : comm(MPI_COMM_WORLD) { }
-    ~Topologies() { comm = MPI_COMM_WORLD; }
+    Topologies() : comm(MPI_COMM_WORLD), reorder(0) { }
+    ~Topologies() { freeComms(); }
+
+    /* Communicators are owned by the object, so it cannot be copied */
+    Topologies(const Topologies&) = delete;
+    Topologies& operator=(const Topologies&) = delete;
+
+    /*!
+     * @brief Create Cartesian topology along with the line sub-communicators of each dimension.
+     * @param struct_part Number of sub-domains in each direction
+     * @param periodic Non-zero for each periodic direction
+     */
+    void createCartTopology(IndicesIJ struct_part, IndicesIJ periodic = IndicesIJ(0, 0));
 
     /*!
-     * @brief Create Cartesian topology.
+     * @brief Create 3D Cartesian topology along with the line sub-communicators of each dimension.
      * @param struct_part Number of sub-domains in each direction
+     * @param periodic Non-zero for each periodic direction
      */
-    void createCartTopology(IndicesIJ struct_part);
+    void createCartTopology(IndicesIJK struct_part, IndicesIJK periodic = IndicesIJK(0, 0, 0));
 
     /*!
      * @brief Create distributed graph topology.
+     * Weights of the links are the numbers of cells sent and received, taken from the process graph
+     * (see \e ProcessGraph) assembled by the root process.
      */
     void createGraphTopology(DecompositionMetis& decomp_metis, int root_pid);
 
+    /*!
+     * @brief Create distributed graph topology without involving the root process.
+     * Each process discovers its neighbors from the cells it owns, see \e discoverNeighbors().
+     * Only the rows of the local cells and the owners of the halo cells are visited, so the cost
+     * grows with the number of local cells and their edges.
+     * @param local_graph Rows of the local cells and owners of the halo cells (see \e Field::distribute())
+     */
+    void createGraphTopology(const LocalGraph& local_graph);
+
+    /*!
+     * @brief Create distributed graph topology of the structured decomposition.
+     * Neighbors and the number of exchanged cells are computed in closed form from the ranges of the
+     * subdomains, neither the graph nor the partitioning of the whole domain is needed.
+     * @param ownership Ownership of the cells, known by all processes
+     * @param stencil Stencil of the graph: 7 (face neighbors) or 27 (all neighbors)
+     */
+    void createGraphTopology(const StructuredOwnership& ownership, int stencil);
+
     /*!
      * @brief A simple test for the Cartesian topology.
+     * Prints the coordinates and the neighbors of each process, then checks that the shifts are
+     * consistent with the ranks of the coordinates and that the reductions and broadcasts along
+     * each dimension give the expected values.
+     * @return Returns EXIT_SUCCESS if all checks passed on all processes and EXIT_FAILURE otherwise.
+     */
+    int testCartTopology();
+
+    /*!
+     * @brief Reduce values over the processes of the line along the dimension, i.e. the ones that
+     * differ only in the coordinate \e dim. All processes of the line get the result.
+     * @param dim Dimension of the line.
+     * @param values [in/out] Values to reduce.
+     * @param count Number of values.
+     * @param op Reduction operation.
+     */
+    void reduceAlong(int dim, double *values, int count, MPI_Op op);
+
+    void reduceAlong(int dim, int *values, int count, MPI_Op op);
+
+    /*!
+     * @brief Broadcast values over the processes of the line along the dimension.
+     * @param dim Dimension of the line.
+     * @param values [in/out] Values to broadcast.
+     * @param count Number of values.
+     * @param root_coord Coordinate along \e dim of the process sending the values.
+     */
+    void broadcastAlong(int dim, double *values, int count, int root_coord);
+
+    void broadcastAlong(int dim, int *values, int count, int root_coord);
+
+    /*!
+     * @brief Get number of dimensions of the Cartesian topology.
+     */
+    inline int getNumDims() {
+        return dims.size();
+    }
+
+    /*!
+     * @brief Get number of processes in each direction of the Cartesian topology.
+     */
+    inline std::vector<int>& getDims() {
+        return dims;
+    }
+
+    /*!
+     * @brief Get coordinates of the current process in the Cartesian topology.
+     * Note that the rank of the process in \e getComm() differs from the global one if it was reordered.
+     */
+    inline std::vector<int>& getCoords() {
+        return coords;
+    }
+
+    /*!
+     * @brief Get the neighbor in the direction, found with \e MPI_Cart_shift().
+     * @param dim Dimension of the shift.
+     * @param direction -1 for the lower neighbor, +1 for the upper one.
+     * @return Rank of the neighbor or MPI_PROC_NULL at a non-periodic boundary.
+     */
+    inline int getCartNeighbor(int dim, int direction) {
+        return (direction < 0) ? lower_neighbors[dim] : upper_neighbors[dim];
+    }
+
+    /*!
+     * @brief Get the sub-communicator of the line along the dimension, ranks in it equal the
+     * coordinates along \e dim.
      */
-    void testCartTopology();
+    inline MPI_Comm getLineComm(int dim) {
+        return line_comms[dim];
+    }
 
     /*!
      * @brief A simple test for the distributed graph topology.
      */
     void testGraphTopology();
 
+    /*!
+     * @brief Print the heaviest and the lightest links of the distributed graph topology.
+     * @param num_components Number of values of each cell.
+     * @param value_size Size of a value on the wire, in bytes.
+     */
+    void reportLinkWeights(int num_components, int value_size);
+
+    /*!
+     * @brief Allow MPI to reorder the ranks of the topologies created afterwards.
+     */
+    inline void setReorder(int value) {
+        reorder = value;
+    }
+
+    /*!
+     * @brief Get the communicator of the topology (MPI_COMM_NULL if the process is not part of it).
+     */
+    inline MPI_Comm getComm() {
+        return comm;
+    }
+
+    /*!
+     * @brief Get processes that send data to the current one.
+     */
+    inline std::vector<int>& getSources() {
+        return sources;
+    }
+
+    /*!
+     * @brief Get processes that receive data from the current one.
+     */
+    inline std::vector<int>& getDestinations() {
+        return destinations;
+    }
+
+    /*!
+     * @brief Get number of cells received from each source, i.e. size of the incoming halo messages
+     * in cells (ghost cells are counted once, however many edges lead to them). Use it to preallocate
+     * receiving buffers.
+     */
+    inline std::vector<int>& getSourceWeights() {
+        return source_weights;
+    }
+
+    /*!
+     * @brief Get number of cells sent to each destination, i.e. size of the outgoing halo messages
+     * in cells. Use it to preallocate sending buffers.
+     */
+    inline std::vector<int>& getDestinationWeights() {
+        return destination_weights;
+    }
+
 private:
+    /*!
+     * @brief Create Cartesian topology of any dimension.
+     * @param ndims Number of dimensions
+     * @param sizes Number of sub-domains in each direction
+     * @param periodic Non-zero for each periodic direction
+     */
+    void createCartTopology(int ndims, const int *sizes, const int *periodic);
+
     /*!
      * @brief Distribute the graph of processes interconnections.
      * @param decomp_metis Object of decomposition performed with METIS
      * @param root_pid ID of the root process that stores \e decomp_metis object
+     * @param loc_sent [out] Number of cells sent to each neighboring process
+     * @param loc_received [out] Number of cells received from each neighboring process
      * @return A vector of neighboring processes
      */
-    std::vector<int> distributeGraph(DecompositionMetis& decomp_metis, int root_pid);
+    std::vector<int> distributeGraph(DecompositionMetis& decomp_metis, int root_pid,
+                                     std::vector<int> &loc_sent, std::vector<int> &loc_received);
+
+    /*!
+     * @brief Discover neighboring processes using the nonblocking consensus (NBX) algorithm.
+     * Destinations are the owners of the graph neighbors of the local cells. Since the process
+     * graph is not necessarily symmetric, each process notifies its destinations with
+     * \e MPI_Issend and learns its sources from the incoming messages. Once all notifications
+     * were matched, the process enters \e MPI_Ibarrier; the exchange is over when the barrier
+     * completes on all processes.
+     * The number of local cells sent to the destination (each one once, however many edges lead
+     * there) is sent along with the notification and is stored as the weight of the link.
+     * @param local_graph Rows of the local cells and owners of the halo cells
+     */
+    void discoverNeighbors(const LocalGraph& local_graph);
+
+    /*!
+     * @brief Create the weighted distributed graph communicator from the lists of neighbors.
+     */
+    void createDistGraph();
+
+    /*!
+     * @brief Free the communicator of the topology and the line sub-communicators, and forget the
+     * Cartesian layout. Nothing is freed once MPI is finalized, e.g. by the destructor of an object
+     * living in main().
+     */
+    void freeComms();
 
 private:
     MPI_Comm comm;
+    int reorder;                            // Allow MPI to reorder the ranks
+    std::vector<int> sources;               // Processes sending to the current one
+    std::vector<int> destinations;          // Processes receiving from the current one
+    std::vector<int> source_weights;        // Number of cells received from each source
+    std::vector<int> destination_weights;   // Number of cells sent to each destination
+    std::vector<int> dims;                  // Number of processes in each direction (Cartesian topology)
+    std::vector<int> periods;               // Periodicity of each direction
+    std::vector<int> coords;                // Coordinates of the current process
+    std::vector<int> lower_neighbors;       // Neighbor in the negative direction of each dimension
+    std::vector<int> upper_neighbors;       // Neighbor in the positive direction of each dimension
+    std::vector<MPI_Comm> line_comms;       // Line sub-communicator of each dimension
 };
 
 
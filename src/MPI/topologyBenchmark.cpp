@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <set>
+#include <cmath>
+#include <sstream>
+#include <iomanip>
+
+#include "topologyBenchmark.h"
+
+int TopologyBenchmark::run(const LocalGraph& local_graph, const std::vector<int>& cart_dims) {
+
+    return run([&local_graph](Topologies &topology) { topology.createGraphTopology(local_graph); }, cart_dims);
+}
+
+int TopologyBenchmark::run(const StructuredOwnership& ownership, int stencil, const std::vector<int>& cart_dims) {
+
+    return run([&ownership, stencil](Topologies &topology) { topology.createGraphTopology(ownership, stencil); },
+               cart_dims);
+}
+
+int TopologyBenchmark::run(const std::function<void(Topologies&)> &create_graph_topology,
+                           const std::vector<int>& cart_dims) {
+
+    Topologies graph_topologies[2];
+    Topologies cart_topologies[2];
+    std::vector<Target> targets;
+    int num_cart_procs = 1;
+
+    for (size_t d = 0; d < cart_dims.size(); ++d) {
+        num_cart_procs *= cart_dims[d];
+    }
+    if (!cart_dims.empty() && num_cart_procs != getNumProcs()) {
+        printByRoot("Warning! Some processes are not part of the Cartesian grid, it is not benchmarked...");
+    }
+
+    for (int reorder = 0; reorder < 2; ++reorder) {
+        Target target;
+
+        /* The graph topology is always available */
+        graph_topologies[reorder].setReorder(reorder);
+        create_graph_topology(graph_topologies[reorder]);
+        target.name = reorder ? "graph (reorder)" : "graph";
+        target.comm = graph_topologies[reorder].getComm();
+        target.is_topology = true;
+        getGraphNeighbors(target);
+
+        /* Point-to-point on MPI_COMM_WORLD uses the same neighbors with the original ranks */
+        if (reorder == 0) {
+            Target world;
+            world.name = "world";
+            world.comm = MPI_COMM_WORLD;
+            world.is_topology = false;
+            world.sources = graph_topologies[0].getSources();
+            world.destinations = graph_topologies[0].getDestinations();
+            targets.push_back(world);
+        }
+        targets.push_back(target);
+    }
+
+    for (int reorder = 0; reorder < 2 && cart_dims.size() > 1 && num_cart_procs == getNumProcs(); ++reorder) {
+        Topologies &topology = cart_topologies[reorder];
+        Target target;
+
+        topology.setReorder(reorder);
+        if (cart_dims.size() == 2)
+            topology.createCartTopology(IndicesIJ(cart_dims[0], cart_dims[1]));
+        else
+            topology.createCartTopology(IndicesIJK(cart_dims[0], cart_dims[1], cart_dims[2]));
+        target.name = reorder ? "Cartesian (reorder)" : "Cartesian";
+        target.comm = topology.getComm();
+        target.is_topology = true;
+
+        /* The order of the neighborhood collectives: lower and upper neighbor of each dimension */
+        for (int d = 0; d < topology.getNumDims(); ++d) {
+            for (int direction = -1; direction <= 1; direction += 2) {
+                target.sources.push_back(topology.getCartNeighbor(d, direction));
+            }
+        }
+        target.destinations = target.sources;
+        targets.push_back(target);
+    }
+
+    for (size_t n = 0; n < targets.size(); ++n) {
+        printByRoot("\nCommunicator: " + targets[n].name);
+        benchPairs(targets[n]);
+        benchExchange(targets[n]);
+    }
+    return EXIT_SUCCESS;
+}
+
+void TopologyBenchmark::getGraphNeighbors(Target& target) {
+
+    int indegree = 0;
+    int outdegree = 0;
+    int weighted = 0;
+    std::vector<int> source_weights;
+    std::vector<int> destination_weights;
+
+    MPI_Dist_graph_neighbors_count(target.comm, &indegree, &outdegree, &weighted);
+    target.sources.resize(indegree);
+    target.destinations.resize(outdegree);
+    source_weights.resize(indegree);
+    destination_weights.resize(outdegree);
+    MPI_Dist_graph_neighbors(target.comm, indegree, target.sources.data(), source_weights.data(),
+                             outdegree, target.destinations.data(), destination_weights.data());
+}
+
+void TopologyBenchmark::benchPairs(const Target& target) {
+
+    int rank = EMPTY;
+    int my_rank = getMyRank();
+    int root_pid = 0;
+    std::set<int> neighbors;
+    std::vector<int> sizes = getMessageSizes();
+    std::vector<char> snd_buffer(max_msg_size, 1);
+    std::vector<char> rcv_buffer(max_msg_size);
+    std::vector<double> results;    // {rank, neighbor, global rank, global neighbor, latency, bandwidths}
+    int record_size = 5 + sizes.size();
+
+    MPI_Comm_rank(target.comm, &rank);
+    for (size_t n = 0; n < target.sources.size(); ++n)
+        neighbors.insert(target.sources[n]);
+    for (size_t n = 0; n < target.destinations.size(); ++n)
+        neighbors.insert(target.destinations[n]);
+    neighbors.erase(MPI_PROC_NULL);
+    neighbors.erase(rank);
+
+    /* Pairs are ordered by their lower rank first and the higher one second. In ascending order of
+     * the neighbors, each process visits its pairs in that order, so both sides meet at each pair. */
+    for (auto it = neighbors.begin(); it != neighbors.end(); ++it) {
+        int ngb = *it;
+        int ngb_global = EMPTY;
+        bool is_initiator = (rank < ngb);
+        double start = 0.;
+        double latency;
+
+        MPI_Sendrecv(&my_rank, 1, MPI_INT, ngb, tag, &ngb_global, 1, MPI_INT, ngb, tag, target.comm,
+                     MPI_STATUS_IGNORE);
+
+        /* Ping-pong of a single double, the latency is a half of the round trip */
+        for (int iter = -num_warmup; iter < num_latency_iters; ++iter) {
+            if (iter == 0)
+                start = MPI_Wtime();
+            if (is_initiator) {
+                MPI_Send(snd_buffer.data(), sizeof(double), MPI_BYTE, ngb, tag + 1, target.comm);
+                MPI_Recv(rcv_buffer.data(), sizeof(double), MPI_BYTE, ngb, tag + 1, target.comm, MPI_STATUS_IGNORE);
+            }
+            else {
+                MPI_Recv(rcv_buffer.data(), sizeof(double), MPI_BYTE, ngb, tag + 1, target.comm, MPI_STATUS_IGNORE);
+                MPI_Send(snd_buffer.data(), sizeof(double), MPI_BYTE, ngb, tag + 1, target.comm);
+            }
+        }
+        latency = (MPI_Wtime() - start) / (2. * num_latency_iters);
+
+        if (is_initiator) {
+            results.push_back(rank);
+            results.push_back(ngb);
+            results.push_back(my_rank);
+            results.push_back(ngb_global);
+            results.push_back(latency);
+        }
+
+        /* Both sides send at once, the bandwidth counts both directions */
+        for (size_t s = 0; s < sizes.size(); ++s) {
+            int num_iters = getNumIters(sizes[s]);
+            for (int iter = -1; iter < num_iters; ++iter) {
+                if (iter == 0)
+                    start = MPI_Wtime();
+                MPI_Sendrecv(snd_buffer.data(), sizes[s], MPI_BYTE, ngb, tag + 2,
+                             rcv_buffer.data(), sizes[s], MPI_BYTE, ngb, tag + 2, target.comm, MPI_STATUS_IGNORE);
+            }
+            if (is_initiator)
+                results.push_back(2. * sizes[s] * num_iters / (MPI_Wtime() - start));
+        }
+    }
+
+    /* Collect the pairs on the root process */
+    if (my_rank == root_pid) {
+        std::vector<double> latencies;
+        std::vector<std::vector<double> > bandwidths(sizes.size());
+        std::ostringstream header;
+
+        header << std::setw(16) << "Pair" << std::setw(14) << "latency (us)";
+        for (size_t s = 0; s < sizes.size(); ++s)
+            header << std::setw(12) << formatSize(sizes[s]);
+        printByRoot(header.str() + "  (bandwidth in MB/s)");
+
+        for (int pid = 0; pid < getNumProcs(); ++pid) {
+            std::vector<double> records;
+            if (pid == root_pid) {
+                records = results;
+            }
+            else {
+                MPI_Status status;
+                int recv_size = 0;
+                MPI_Probe(pid, tag + 3, MPI_COMM_WORLD, &status);
+                MPI_Get_count(&status, MPI_DOUBLE, &recv_size);
+                records.resize(recv_size);
+                MPI_Recv(records.data(), recv_size, MPI_DOUBLE, pid, tag + 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            }
+
+            for (size_t r = 0; r + record_size <= records.size(); r += record_size) {
+                const double *record = &records[r];
+                std::ostringstream line;
+                std::ostringstream pair;
+
+                /* Global ranks are shown only if the communicator reordered them */
+                pair << (int) record[0];
+                if (record[0] != record[2])
+                    pair << "(" << (int) record[2] << ")";
+                pair << " <-> " << (int) record[1];
+                if (record[1] != record[3])
+                    pair << "(" << (int) record[3] << ")";
+                line << std::setw(16) << pair.str() << std::setw(14) << std::fixed << std::setprecision(2)
+                     << record[4] * 1.e+6;
+                latencies.push_back(record[4] * 1.e+6);
+                for (size_t s = 0; s < sizes.size(); ++s) {
+                    line << std::setw(12) << std::setprecision(1) << record[5 + s] * 1.e-6;
+                    bandwidths[s].push_back(record[5 + s] * 1.e-6);
+                }
+                printByRoot(line.str());
+            }
+        }
+
+        if (latencies.empty()) {
+            printByRoot("There are no pairs of neighbors...");
+            return;
+        }
+        printPercentiles("Latency", latencies, "us");
+        for (size_t s = 0; s < sizes.size(); ++s)
+            printPercentiles("Bandwidth " + formatSize(sizes[s]), bandwidths[s], "MB/s");
+    }
+    else {
+        MPI_Send(results.data(), results.size(), MPI_DOUBLE, root_pid, tag + 3, MPI_COMM_WORLD);
+    }
+}
+
+void TopologyBenchmark::benchExchange(const Target& target) {
+
+    int root_pid = 0;
+    int num_procs = getNumProcs();
+    int num_sources = target.sources.size();
+    int num_destinations = target.destinations.size();
+    std::vector<int> sizes = getMessageSizes();
+    std::vector<char> snd_buffer((int64_t) max_msg_size * num_destinations, 1);
+    std::vector<char> rcv_buffer((int64_t) max_msg_size * num_sources);
+    std::vector<MPI_Request> requests(num_sources + num_destinations);
+    std::vector<double> times(num_procs);
+
+    for (size_t s = 0; s < sizes.size(); ++s) {
+        int size = sizes[s];
+        int num_iters = getNumIters(size);
+        double start = 0.;
+        double time;
+
+        /* Hand-written loop over the neighbors */
+        MPI_Barrier(target.comm);
+        for (int iter = -1; iter < num_iters; ++iter) {
+            if (iter == 0)
+                start = MPI_Wtime();
+            for (int n = 0; n < num_sources; ++n) {
+                MPI_Irecv(&rcv_buffer[(int64_t) n * size], size, MPI_BYTE, target.sources[n], tag + 4,
+                          target.comm, &requests[n]);
+            }
+            for (int n = 0; n < num_destinations; ++n) {
+                MPI_Isend(&snd_buffer[(int64_t) n * size], size, MPI_BYTE, target.destinations[n], tag + 4,
+                          target.comm, &requests[num_sources + n]);
+            }
+            MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+        }
+        time = (MPI_Wtime() - start) / num_iters * 1.e+6;
+        MPI_Gather(&time, 1, MPI_DOUBLE, times.data(), 1, MPI_DOUBLE, root_pid, MPI_COMM_WORLD);
+        if (getMyRank() == root_pid)
+            printPercentiles("Exchange " + formatSize(size) + ", Isend/Irecv", times, "us");
+
+        if (!target.is_topology)
+            continue;
+
+        /* The same exchange by the neighborhood collective */
+        MPI_Barrier(target.comm);
+        for (int iter = -1; iter < num_iters; ++iter) {
+            if (iter == 0)
+                start = MPI_Wtime();
+            MPI_Neighbor_alltoall(snd_buffer.data(), size, MPI_BYTE, rcv_buffer.data(), size, MPI_BYTE,
+                                  target.comm);
+        }
+        time = (MPI_Wtime() - start) / num_iters * 1.e+6;
+        MPI_Gather(&time, 1, MPI_DOUBLE, times.data(), 1, MPI_DOUBLE, root_pid, MPI_COMM_WORLD);
+        if (getMyRank() == root_pid)
+            printPercentiles("Exchange " + formatSize(size) + ", Neighbor_alltoall", times, "us");
+    }
+}
+
+void TopologyBenchmark::printPercentiles(const std::string& label, std::vector<double>& values,
+                                         const std::string& unit) {
+
+    const double percents[5] = {0., 50., 90., 99., 100.};
+    const char *names[5] = {"min", "p50", "p90", "p99", "max"};
+    std::ostringstream line;
+
+    /* Nearest-rank percentiles */
+    std::sort(values.begin(), values.end());
+    line << label << " (" << unit << "):" << std::fixed << std::setprecision(2);
+    for (int p = 0; p < 5; ++p) {
+        int64_t index = std::max<int64_t>((int64_t) std::ceil(percents[p] / 100. * values.size()) - 1, 0);
+        line << " " << names[p] << " " << values[index];
+    }
+    printByRoot(line.str());
+}
+
+std::vector<int> TopologyBenchmark::getMessageSizes() {
+
+    std::vector<int> sizes;
+
+    for (int size = min_msg_size; size <= max_msg_size; size *= 4) {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+int TopologyBenchmark::getNumIters(int size) {
+
+    int num_iters = bytes_per_size / size;
+
+    return (num_iters < min_iters) ? min_iters : num_iters;
+}
+
+std::string TopologyBenchmark::formatSize(int size) {
+
+    if (size >= (1 << 20))
+        return std::to_string(size >> 20) + "MiB";
+    return std::to_string(size >> 10) + "KiB";
+}
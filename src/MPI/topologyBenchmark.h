@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_TOPOLOGYBENCHMARK_H
+#define UNBALANCED_WORKLOAD_TOPOLOGYBENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "../common.h"
+#include "../localGraph.h"
+#include "topologies.h"
+
+/*!
+ * \class TopologyBenchmark
+ * @brief Communication benchmarks of the neighboring processes, executed by all processes.
+ * The halo neighbors are measured on MPI_COMM_WORLD, on the distributed graph topology and, for
+ * structured decompositions, on the Cartesian topology; both topologies are measured with and
+ * without reordering of the ranks. For each communicator the benchmark reports:
+ *  - the ping-pong latency and the exchange bandwidth of each pair of neighbors, measured one pair
+ *    at a time (pairs are visited in the same order by both sides, so nothing deadlocks);
+ *  - the time of the exchange with all neighbors at once, via \e MPI_Isend/MPI_Irecv loops and via
+ *    \e MPI_Neighbor_alltoall (topologies only).
+ * Pairs are printed by the root process along with the percentiles over all pairs/processes.
+ */
+class TopologyBenchmark {
+public:
+    TopologyBenchmark() { }
+
+    ~TopologyBenchmark() { }
+
+    /*!
+     * @brief Create the communicators and run the benchmarks.
+     * @param local_graph Rows of the local cells and owners of the halo cells.
+     * @param cart_dims Number of processes in each direction of the structured decomposition (empty
+     *                  if the decomposition is not structured).
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int run(const LocalGraph& local_graph, const std::vector<int>& cart_dims);
+
+    /*!
+     * @brief Create the communicators of the structured decomposition and run the benchmarks.
+     * The graph topology is computed in closed form from the ranges of the subdomains (see
+     * \e Topologies::createGraphTopology(const StructuredOwnership&, int)).
+     * @param ownership Ownership of the cells, known by all processes.
+     * @param stencil Stencil of the graph: 7 (face neighbors) or 27 (all neighbors).
+     * @param cart_dims Number of processes in each direction of the decomposition.
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int run(const StructuredOwnership& ownership, int stencil, const std::vector<int>& cart_dims);
+
+private:
+    /*!
+     * @brief Run the benchmarks, see \e run().
+     * @param create_graph_topology Creates the distributed graph topology of the halo neighbors.
+     */
+    int run(const std::function<void(Topologies&)> &create_graph_topology, const std::vector<int>& cart_dims);
+
+    /*!
+     * @brief Communicator under test along with the neighbors of the current process in it.
+     */
+    struct Target {
+        std::string name;
+        MPI_Comm comm;
+        bool is_topology;               // Supports the neighborhood collectives
+        std::vector<int> sources;       // Ranks in \e comm, MPI_PROC_NULL at the boundaries
+        std::vector<int> destinations;
+    };
+
+    /*!
+     * @brief Measure the latency and the bandwidth of each pair of neighbors and print them.
+     */
+    void benchPairs(const Target& target);
+
+    /*!
+     * @brief Measure the exchange with all neighbors via point-to-point loops and via the
+     * neighborhood collective, print the percentiles over the processes.
+     */
+    void benchExchange(const Target& target);
+
+    /*!
+     * @brief Get the neighbors of the distributed graph topology.
+     */
+    void getGraphNeighbors(Target& target);
+
+    /*!
+     * @brief Print the min, the median, the 90th and the 99th percentiles and the max of the values.
+     */
+    void printPercentiles(const std::string& label, std::vector<double>& values, const std::string& unit);
+
+    /*!
+     * @brief Get the sizes of the messages, from \e min_msg_size to \e max_msg_size.
+     */
+    std::vector<int> getMessageSizes();
+
+    /*!
+     * @brief Get the number of repetitions for a message, so each size moves about the same volume.
+     */
+    int getNumIters(int size);
+
+    static std::string formatSize(int size);
+
+private:
+    static const int num_warmup = 10;           // Untimed repetitions before each measurement
+    static const int num_latency_iters = 1000;  // Round trips of the ping-pong
+    static const int min_msg_size = 1024;       // Messages grow 4x from min to max size (bytes)
+    static const int max_msg_size = 1 << 20;
+    static const int bytes_per_size = 1 << 24;  // Volume sent by each measurement of a size
+    static const int min_iters = 8;
+    static const int tag = 170;
+};
+
+#endif //UNBALANCED_WORKLOAD_TOPOLOGYBENCHMARK_H
@@ -0,0 +1,1213 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define VIRTUAL_RANKS_RUNTIME
+#include "../common.h"
+#include "../General/macro.h"
+
+#ifdef USE_VIRTUAL_RANKS
+
+#include <vector>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <system_error>
+#include <cstring>
+#include <cstdlib>
+#include <omp.h>
+
+struct VirtualCollective;
+
+/*!
+ * @brief Message sent before the matching receive was posted.
+ */
+struct VirtualMessage {
+    int source;
+    int tag;
+    MPI_Comm comm;
+    std::vector<char> data;
+    std::shared_ptr<std::atomic<bool> > matched;    // Set once received, synchronous sends only
+};
+
+struct VirtualRequest {
+    enum Kind { SEND, RECV, COLLECTIVE };
+
+    VirtualRequest(Kind type) : kind(type), complete(false), buffer(NULL), capacity(0),
+                                source(MPI_ANY_SOURCE), tag(MPI_ANY_TAG), comm(MPI_COMM_NULL) { }
+
+    Kind kind;
+    std::atomic<bool> complete;                     // Receives only
+    MPI_Status status;
+    void *buffer;                                   // Posted receive
+    int64_t capacity;
+    int source;
+    int tag;
+    MPI_Comm comm;
+    std::shared_ptr<std::atomic<bool> > matched;    // Synchronous send
+    std::shared_ptr<VirtualCollective> collective;  // Nonblocking collective
+    std::function<void(VirtualCollective&)> extract;
+};
+
+/*!
+ * @brief Queues of a rank, guarded by the mutex. Only the owner waits for the condition.
+ */
+struct VirtualMailbox {
+    std::mutex mutex;
+    std::condition_variable arrived;
+    std::list<VirtualMessage> unexpected;
+    std::list<VirtualRequest*> posted;
+};
+
+/*!
+ * @brief Instance of a collective operation, shared by all ranks of the communicator.
+ */
+struct VirtualCollective {
+    VirtualCollective() : num_arrived(0), done(false) { }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    int num_arrived;
+    bool done;
+    std::vector<std::vector<char> > contributions;  // In the order of ranks
+    std::vector<char> result;
+};
+
+struct VirtualComm {
+    VirtualComm() : size(0) { }
+
+    int size;
+    std::vector<std::vector<int> > groups;          // Split communicator, ranks of the parent in each group
+    std::vector<int> group_of;                      // Group of each rank of the parent (EMPTY if none)
+    std::vector<int> ranks;                         // Rank of each rank of the parent within its group
+    std::vector<int> dims;                          // Cartesian topology
+    std::vector<int> periods;
+    std::vector<std::vector<int> > sources;         // Graph topology, adjacency of each rank
+    std::vector<std::vector<int> > source_weights;
+    std::vector<std::vector<int> > destinations;
+    std::vector<std::vector<int> > destination_weights;
+};
+
+struct VirtualType {
+    int count;
+    MPI_Datatype base;
+    int64_t size;
+};
+
+static const int max_types = 1024;
+static const int max_ops = 64;
+static const MPI_Op first_user_op = 16;
+static const int neighbor_tag = -16;            // Tags of the neighborhood collectives count down from it
+
+static int num_ranks = 1;
+static int ranks_per_node = 0;                  // Ranks of each emulated node (0 for a single node)
+static VirtualMailbox *mailboxes = NULL;
+static std::chrono::steady_clock::time_point start_time;
+
+/* Registries are only appended, so a handle can be used without the lock once it is created */
+static std::mutex registry_mutex;
+static VirtualType types[max_types];
+static int num_types = 0;
+static MPI_User_function *user_ops[max_ops];
+static int num_user_ops = 0;
+static std::map<MPI_Comm, std::shared_ptr<VirtualComm> > comms;
+
+static std::mutex collectives_mutex;
+static std::map<std::pair<std::pair<MPI_Comm, int>, int64_t>, std::shared_ptr<VirtualCollective> > collectives;
+
+static thread_local int my_rank = 0;
+static thread_local bool is_finalized = false;
+static thread_local MPI_Comm next_comm = MPI_COMM_WORLD + 1;    // Communicators are created collectively
+static thread_local std::map<MPI_Comm, int64_t> *next_collective = NULL;
+
+static void fail(const std::string& message) {
+
+    std::cout.flush();
+    std::cerr << "Error! Virtual rank " << my_rank << ": " << message << "..." << std::endl;
+    std::_Exit(EXIT_FAILURE);
+}
+
+static int64_t getTypeSize(MPI_Datatype datatype) {
+
+    if (datatype <= MPI_DATATYPE_NULL || datatype >= num_types)
+        fail("invalid datatype " + std::to_string(datatype));
+    return types[datatype].size;
+}
+
+/*!
+ * @brief Get the group of the calling rank in a split communicator, the communicator has to be locked.
+ */
+static int getGroup(const VirtualComm &comm) {
+
+    if (comm.groups.empty())
+        return 0;
+    if (comm.group_of[my_rank] == EMPTY)
+        fail("rank is not a member of the split communicator");
+    return comm.group_of[my_rank];
+}
+
+static int getCommSize(MPI_Comm comm) {
+
+    if (comm == MPI_COMM_WORLD)
+        return num_ranks;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::map<MPI_Comm, std::shared_ptr<VirtualComm> >::iterator it = comms.find(comm);
+    if (it == comms.end())
+        fail("invalid communicator " + std::to_string(comm));
+    if (!it->second->groups.empty())
+        return it->second->groups[getGroup(*it->second)].size();
+    return it->second->size;
+}
+
+/*!
+ * @brief Get the rank of the calling rank in the communicator and optionally its group.
+ * Ranks of communicators which are not split equal the ones of MPI_COMM_WORLD.
+ */
+static int getCommRank(MPI_Comm comm, int *group = NULL) {
+
+    if (group != NULL)
+        *group = 0;
+    if (comm == MPI_COMM_WORLD)
+        return my_rank;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::map<MPI_Comm, std::shared_ptr<VirtualComm> >::iterator it = comms.find(comm);
+    if (it == comms.end())
+        fail("invalid communicator " + std::to_string(comm));
+    if (it->second->groups.empty())
+        return my_rank;
+    if (group != NULL)
+        *group = getGroup(*it->second);
+    return it->second->ranks[my_rank];
+}
+
+/*!
+ * @brief Translate a rank of the communicator into the one of MPI_COMM_WORLD.
+ */
+static int getWorldRank(MPI_Comm comm, int rank) {
+
+    if (comm == MPI_COMM_WORLD)
+        return rank;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const VirtualComm &info = *comms[comm];
+    return info.groups.empty() ? rank : info.groups[getGroup(info)][rank];
+}
+
+static std::shared_ptr<VirtualComm> getComm(MPI_Comm comm) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    std::map<MPI_Comm, std::shared_ptr<VirtualComm> >::iterator it = comms.find(comm);
+    if (it == comms.end())
+        fail("communicator " + std::to_string(comm) + " has no topology");
+    return it->second;
+}
+
+/*!
+ * @brief Get the communicator created by the current collective call, the first rank creates it.
+ * All ranks number the communicators in the same order, thus get the same handle.
+ */
+static std::shared_ptr<VirtualComm> createComm(MPI_Comm &handle, int size) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    handle = next_comm++;
+    std::shared_ptr<VirtualComm> &comm = comms[handle];
+    if (!comm) {
+        comm = std::make_shared<VirtualComm>();
+        comm->size = size;
+    }
+    return comm;
+}
+
+/*!
+ * @brief Get the communicator created by splitting MPI_COMM_WORLD (or a communicator with the same
+ * ranks), the first rank creates it. The ranks of each group are ordered by their keys, then by
+ * their ranks in the parent; ranks with the color MPI_UNDEFINED get MPI_COMM_NULL.
+ * @param colors Color of each rank of the parent.
+ * @param keys Key of each rank of the parent.
+ */
+static std::shared_ptr<VirtualComm> createSplitComm(MPI_Comm &handle, const std::vector<int> &colors,
+                                                    const std::vector<int> &keys) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    handle = next_comm++;
+    std::shared_ptr<VirtualComm> &comm = comms[handle];
+    if (!comm) {
+        std::map<int, int> group_of_color;
+        std::vector<std::pair<std::pair<int, int>, int> > order;    // ((group, key), rank)
+
+        comm = std::make_shared<VirtualComm>();
+        comm->size = colors.size();
+        comm->group_of.assign(colors.size(), EMPTY);
+        comm->ranks.assign(colors.size(), EMPTY);
+        for (size_t r = 0; r < colors.size(); ++r) {
+            if (colors[r] == MPI_UNDEFINED)
+                continue;
+            if (group_of_color.find(colors[r]) == group_of_color.end()) {
+                int group = group_of_color.size();
+                group_of_color[colors[r]] = group;
+            }
+            order.push_back(std::make_pair(std::make_pair(group_of_color[colors[r]], keys[r]), r));
+        }
+        std::sort(order.begin(), order.end());
+        comm->groups.resize(group_of_color.size());
+        for (size_t n = 0; n < order.size(); ++n) {
+            int group = order[n].first.first;
+            int r = order[n].second;
+            comm->group_of[r] = group;
+            comm->ranks[r] = comm->groups[group].size();
+            comm->groups[group].push_back(r);
+        }
+    }
+    if (comm->group_of[my_rank] == EMPTY)
+        handle = MPI_COMM_NULL;
+    return comm;
+}
+
+static void checkRank(int rank, MPI_Comm comm) {
+
+    if (rank < 0 || rank >= getCommSize(comm))
+        fail("invalid rank " + std::to_string(rank));
+}
+
+static bool isMatching(int source, int tag, MPI_Comm comm, int msg_source, int msg_tag, MPI_Comm msg_comm) {
+
+    /* Negative tags are reserved for the neighborhood collectives, wildcards do not match them */
+    return (source == MPI_ANY_SOURCE || source == msg_source)
+           && ((tag == MPI_ANY_TAG && msg_tag >= 0) || tag == msg_tag) && comm == msg_comm;
+}
+
+/*!
+ * @brief Copy the message into the posted receive, the mailbox of the receiver has to be locked.
+ */
+static void deliver(VirtualRequest *request, const void *data, int64_t num_bytes, int source, int tag,
+                    const std::shared_ptr<std::atomic<bool> > &matched) {
+
+    if (num_bytes > request->capacity)
+        fail("message of " + std::to_string(num_bytes) + " bytes from rank " + std::to_string(source)
+             + " is truncated to " + std::to_string(request->capacity) + " bytes");
+
+    if (num_bytes > 0)
+        std::memcpy(request->buffer, data, num_bytes);
+    request->status.MPI_SOURCE = source;
+    request->status.MPI_TAG = tag;
+    request->status.MPI_ERROR = MPI_SUCCESS;
+    request->status.num_bytes = num_bytes;
+    if (matched)
+        *matched = true;
+    request->complete = true;
+}
+
+/*!
+ * @brief Send the message eagerly: it is either copied into the first matching posted receive or
+ * queued, so the send buffer can be reused right away.
+ */
+static void postSend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+                     const std::shared_ptr<std::atomic<bool> > &matched) {
+
+    int64_t num_bytes = count * getTypeSize(datatype);
+
+    if (dest == MPI_PROC_NULL) {
+        if (matched)
+            *matched = true;
+        return;
+    }
+    checkRank(dest, comm);
+    int source = getCommRank(comm);
+    VirtualMailbox &box = mailboxes[getWorldRank(comm, dest)];
+
+    std::lock_guard<std::mutex> lock(box.mutex);
+    for (std::list<VirtualRequest*>::iterator it = box.posted.begin(); it != box.posted.end(); ++it) {
+        if (isMatching((*it)->source, (*it)->tag, (*it)->comm, source, tag, comm)) {
+            deliver(*it, buf, num_bytes, source, tag, matched);
+            box.posted.erase(it);
+            box.arrived.notify_all();
+            return;
+        }
+    }
+
+    box.unexpected.push_back(VirtualMessage());
+    VirtualMessage &msg = box.unexpected.back();
+    msg.source = source;
+    msg.tag = tag;
+    msg.comm = comm;
+    msg.data.assign(static_cast<const char*>(buf), static_cast<const char*>(buf) + num_bytes);
+    msg.matched = matched;
+    box.arrived.notify_all();
+}
+
+static VirtualRequest* postRecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm) {
+
+    VirtualRequest *request = new VirtualRequest(VirtualRequest::RECV);
+    VirtualMailbox &box = mailboxes[my_rank];
+
+    request->buffer = buf;
+    request->capacity = count * getTypeSize(datatype);
+    request->source = source;
+    request->tag = tag;
+    request->comm = comm;
+
+    /* Receives from MPI_PROC_NULL complete right away */
+    if (source == MPI_PROC_NULL) {
+        deliver(request, NULL, 0, MPI_PROC_NULL, MPI_ANY_TAG, std::shared_ptr<std::atomic<bool> >());
+        return request;
+    }
+    if (source != MPI_ANY_SOURCE)
+        checkRank(source, comm);
+
+    std::lock_guard<std::mutex> lock(box.mutex);
+    for (std::list<VirtualMessage>::iterator it = box.unexpected.begin(); it != box.unexpected.end(); ++it) {
+        if (isMatching(source, tag, comm, it->source, it->tag, it->comm)) {
+            deliver(request, it->data.data(), it->data.size(), it->source, it->tag, it->matched);
+            box.unexpected.erase(it);
+            return request;
+        }
+    }
+    box.posted.push_back(request);
+    return request;
+}
+
+/*!
+ * @brief Join the next collective operation on the communicator.
+ * The contribution is copied, the last rank to arrive computes the result.
+ * @param data Contribution of the calling rank, might be NULL.
+ * @param combine Function computing the result from the contributions.
+ */
+static std::shared_ptr<VirtualCollective> joinCollective(MPI_Comm comm, const void *data, int64_t num_bytes,
+                                                         const std::function<void(VirtualCollective&)> &combine) {
+
+    int size = getCommSize(comm);
+    int group = 0;
+    int rank = getCommRank(comm, &group);
+    std::shared_ptr<VirtualCollective> collective;
+
+    /* Groups of a split communicator share its handle, but not its collectives */
+    if (next_collective == NULL)
+        next_collective = new std::map<MPI_Comm, int64_t>();
+    std::pair<std::pair<MPI_Comm, int>, int64_t> key(std::make_pair(comm, group), (*next_collective)[comm]++);
+
+    {
+        std::lock_guard<std::mutex> lock(collectives_mutex);
+        std::shared_ptr<VirtualCollective> &entry = collectives[key];
+        if (!entry) {
+            entry = std::make_shared<VirtualCollective>();
+            entry->contributions.resize(size);
+        }
+        collective = entry;
+    }
+
+    std::lock_guard<std::mutex> lock(collective->mutex);
+    if (data != NULL)
+        collective->contributions[rank].assign(static_cast<const char*>(data),
+                                                  static_cast<const char*>(data) + num_bytes);
+    if (++collective->num_arrived == size) {
+        if (combine)
+            combine(*collective);
+        collective->done = true;
+        collective->finished.notify_all();
+
+        std::lock_guard<std::mutex> map_lock(collectives_mutex);
+        collectives.erase(key);
+    }
+    return collective;
+}
+
+static void waitCollective(VirtualCollective &collective) {
+
+    std::unique_lock<std::mutex> lock(collective.mutex);
+    collective.finished.wait(lock, [&collective]() { return collective.done; });
+}
+
+template<typename T>
+static void applyBuiltin(MPI_Op op, const T *in, T *inout, int count) {
+
+    for (int n = 0; n < count; ++n) {
+        if (op == MPI_SUM)
+            inout[n] += in[n];
+        else if (op == MPI_MIN)
+            inout[n] = std::min(in[n], inout[n]);
+        else if (op == MPI_MAX)
+            inout[n] = std::max(in[n], inout[n]);
+        else
+            fail("unsupported operation " + std::to_string(op));
+    }
+}
+
+/*!
+ * @brief Apply \e inout = \e in op \e inout.
+ */
+static void applyOp(MPI_Op op, MPI_Datatype datatype, const void *in, void *inout, int count) {
+
+    if (op >= first_user_op && op < first_user_op + num_user_ops) {
+        user_ops[op - first_user_op](const_cast<void*>(in), inout, &count, &datatype);
+    }
+    else if (datatype == MPI_2INT && (op == MPI_MINLOC || op == MPI_MAXLOC)) {
+        const int *src = static_cast<const int*>(in);
+        int *dst = static_cast<int*>(inout);
+        for (int n = 0; n < count; ++n) {
+            bool better = (op == MPI_MINLOC) ? src[2 * n] < dst[2 * n] : src[2 * n] > dst[2 * n];
+            if (better || (src[2 * n] == dst[2 * n] && src[2 * n + 1] < dst[2 * n + 1])) {
+                dst[2 * n] = src[2 * n];
+                dst[2 * n + 1] = src[2 * n + 1];
+            }
+        }
+    }
+    else if (datatype == MPI_INT) {
+        applyBuiltin(op, static_cast<const int*>(in), static_cast<int*>(inout), count);
+    }
+    else if (datatype == MPI_DOUBLE) {
+        applyBuiltin(op, static_cast<const double*>(in), static_cast<double*>(inout), count);
+    }
+    else {
+        fail("unsupported operation " + std::to_string(op) + " on datatype " + std::to_string(datatype));
+    }
+}
+
+/*!
+ * @brief Reduce the contributions in the canonical order, i.e. c_0 op (c_1 op (... op c_{P-1})).
+ */
+static void reduceContributions(VirtualCollective &collective, int count, MPI_Datatype datatype, MPI_Op op) {
+
+    int last = collective.contributions.size() - 1;
+
+    collective.result = collective.contributions[last];
+    for (int r = last - 1; r >= 0; --r) {
+        applyOp(op, datatype, collective.contributions[r].data(), collective.result.data(), count);
+    }
+}
+
+static bool isComplete(VirtualRequest *request) {
+
+    if (request->kind == VirtualRequest::SEND)
+        return !request->matched || *request->matched;
+    if (request->kind == VirtualRequest::RECV)
+        return request->complete;
+
+    std::lock_guard<std::mutex> lock(request->collective->mutex);
+    return request->collective->done;
+}
+
+static void waitRequest(VirtualRequest *request) {
+
+    if (request->kind == VirtualRequest::RECV) {
+        VirtualMailbox &box = mailboxes[my_rank];
+        std::unique_lock<std::mutex> lock(box.mutex);
+        box.arrived.wait(lock, [request]() { return request->complete.load(); });
+    }
+    else if (request->kind == VirtualRequest::COLLECTIVE) {
+        waitCollective(*request->collective);
+    }
+    else {
+        while (!isComplete(request))
+            std::this_thread::yield();
+    }
+}
+
+/*!
+ * @brief Finish the completed request and free it.
+ */
+static void releaseRequest(MPI_Request *request, MPI_Status *status) {
+
+    VirtualRequest *req = *request;
+
+    if (req->kind == VirtualRequest::COLLECTIVE && req->extract)
+        req->extract(*req->collective);
+    if (status != MPI_STATUS_IGNORE) {
+        if (req->kind == VirtualRequest::RECV)
+            *status = req->status;
+        else
+            status->MPI_ERROR = MPI_SUCCESS;
+    }
+    delete req;
+    *request = MPI_REQUEST_NULL;
+}
+
+/*!
+ * @brief Find the first matching unexpected message, the mailbox has to be locked.
+ */
+static bool findMessage(VirtualMailbox &box, int source, int tag, MPI_Comm comm, MPI_Status *status) {
+
+    for (std::list<VirtualMessage>::iterator it = box.unexpected.begin(); it != box.unexpected.end(); ++it) {
+        if (isMatching(source, tag, comm, it->source, it->tag, it->comm)) {
+            if (status != MPI_STATUS_IGNORE) {
+                status->MPI_SOURCE = it->source;
+                status->MPI_TAG = it->tag;
+                status->MPI_ERROR = MPI_SUCCESS;
+                status->num_bytes = it->data.size();
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+static void runRank(int rank, int argc, char **argv, int *exit_code) {
+
+    my_rank = rank;
+    /* Ranks already outnumber the cores, threads of OpenMP are used only if requested explicitly */
+    if (std::getenv("OMP_NUM_THREADS") == NULL)
+        omp_set_num_threads(1);
+    *exit_code = virtualMain(argc, argv);
+    delete next_collective;
+    next_collective = NULL;
+}
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided) {
+
+    *provided = required;
+    return MPI_SUCCESS;
+}
+
+int MPI_Finalize() {
+
+    is_finalized = true;
+    return MPI_Barrier(MPI_COMM_WORLD);
+}
+
+int MPI_Finalized(int *flag) {
+
+    *flag = is_finalized ? 1 : 0;
+    return MPI_SUCCESS;
+}
+
+int MPI_Abort(MPI_Comm comm, int errorcode) {
+
+    std::cout.flush();
+    std::cerr << "MPI_Abort was called by virtual rank " << my_rank << std::endl;
+    std::_Exit(errorcode);
+}
+
+double MPI_Wtime() {
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+int MPI_Comm_rank(MPI_Comm comm, int *rank) {
+
+    *rank = getCommRank(comm);
+    if (*rank >= getCommSize(comm))
+        fail("rank is not a member of communicator " + std::to_string(comm));
+    return MPI_SUCCESS;
+}
+
+int MPI_Comm_size(MPI_Comm comm, int *size) {
+
+    *size = getCommSize(comm);
+    return MPI_SUCCESS;
+}
+
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm) {
+
+    std::vector<int> colors(num_ranks, 0);
+    std::vector<int> keys(num_ranks);
+
+    if (comm != MPI_COMM_WORLD || split_type != MPI_COMM_TYPE_SHARED)
+        fail("only MPI_COMM_WORLD can be split by the shared memory");
+
+    /* All ranks share the process, unless the nodes are emulated */
+    MPI_Gather(&key, 1, MPI_INT, keys.data(), 1, MPI_INT, 0, comm);
+    MPI_Bcast(keys.data(), num_ranks, MPI_INT, 0, comm);
+    for (int r = 0; r < num_ranks && ranks_per_node > 0; ++r)
+        colors[r] = r / ranks_per_node;
+    createSplitComm(*newcomm, colors, keys);
+    return MPI_SUCCESS;
+}
+
+int MPI_Comm_free(MPI_Comm *comm) {
+
+    if (*comm == MPI_COMM_WORLD || *comm == MPI_COMM_NULL)
+        fail("MPI_COMM_WORLD and MPI_COMM_NULL cannot be freed");
+
+    /* The descriptor is shared by the ranks and kept, only the handle of the caller is invalidated */
+    getCommSize(*comm);
+    *comm = MPI_COMM_NULL;
+    return MPI_SUCCESS;
+}
+
+int MPI_Type_contiguous(int count, MPI_Datatype oldtype, MPI_Datatype *newtype) {
+
+    int64_t size = count * getTypeSize(oldtype);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (int n = MPI_2INT + 1; n < num_types; ++n) {
+        if (types[n].count == count && types[n].base == oldtype) {
+            *newtype = n;
+            return MPI_SUCCESS;
+        }
+    }
+    if (num_types == max_types)
+        fail("too many datatypes");
+    types[num_types].count = count;
+    types[num_types].base = oldtype;
+    types[num_types].size = size;
+    *newtype = num_types++;
+    return MPI_SUCCESS;
+}
+
+int MPI_Type_commit(MPI_Datatype *datatype) {
+
+    getTypeSize(*datatype);
+    return MPI_SUCCESS;
+}
+
+int MPI_Op_create(MPI_User_function *function, int commute, MPI_Op *op) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (int n = 0; n < num_user_ops; ++n) {
+        if (user_ops[n] == function) {
+            *op = first_user_op + n;
+            return MPI_SUCCESS;
+        }
+    }
+    if (num_user_ops == max_ops)
+        fail("too many operations");
+    user_ops[num_user_ops] = function;
+    *op = first_user_op + num_user_ops++;
+    return MPI_SUCCESS;
+}
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm) {
+
+    postSend(buf, count, datatype, dest, tag, comm, std::shared_ptr<std::atomic<bool> >());
+    return MPI_SUCCESS;
+}
+
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+             MPI_Status *status) {
+
+    MPI_Request request = postRecv(buf, count, datatype, source, tag, comm);
+    return MPI_Wait(&request, status);
+}
+
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request *request) {
+
+    postSend(buf, count, datatype, dest, tag, comm, std::shared_ptr<std::atomic<bool> >());
+    *request = new VirtualRequest(VirtualRequest::SEND);
+    return MPI_SUCCESS;
+}
+
+int MPI_Issend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+               MPI_Request *request) {
+
+    std::shared_ptr<std::atomic<bool> > matched = std::make_shared<std::atomic<bool> >(false);
+
+    postSend(buf, count, datatype, dest, tag, comm, matched);
+    *request = new VirtualRequest(VirtualRequest::SEND);
+    (*request)->matched = matched;
+    return MPI_SUCCESS;
+}
+
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request *request) {
+
+    *request = postRecv(buf, count, datatype, source, tag, comm);
+    return MPI_SUCCESS;
+}
+
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status) {
+
+    MPI_Send(sendbuf, sendcount, sendtype, dest, sendtag, comm);
+    return MPI_Recv(recvbuf, recvcount, recvtype, source, recvtag, comm, status);
+}
+
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status) {
+
+    VirtualMailbox &box = mailboxes[my_rank];
+    std::unique_lock<std::mutex> lock(box.mutex);
+
+    box.arrived.wait(lock, [&]() { return findMessage(box, source, tag, comm, status); });
+    return MPI_SUCCESS;
+}
+
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status) {
+
+    VirtualMailbox &box = mailboxes[my_rank];
+    {
+        std::lock_guard<std::mutex> lock(box.mutex);
+        *flag = findMessage(box, source, tag, comm, status);
+    }
+    /* Polling loops would starve the other ranks otherwise */
+    if (!*flag)
+        std::this_thread::yield();
+    return MPI_SUCCESS;
+}
+
+int MPI_Get_count(const MPI_Status *status, MPI_Datatype datatype, int *count) {
+
+    int64_t size = getTypeSize(datatype);
+
+    *count = (status->num_bytes % size == 0) ? status->num_bytes / size : MPI_UNDEFINED;
+    return MPI_SUCCESS;
+}
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status) {
+
+    if (*request == MPI_REQUEST_NULL)
+        return MPI_SUCCESS;
+
+    waitRequest(*request);
+    releaseRequest(request, status);
+    return MPI_SUCCESS;
+}
+
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]) {
+
+    for (int n = 0; n < count; ++n) {
+        MPI_Wait(&requests[n], statuses == MPI_STATUSES_IGNORE ? MPI_STATUS_IGNORE : &statuses[n]);
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status) {
+
+    *flag = (*request == MPI_REQUEST_NULL) || isComplete(*request);
+    if (!*flag)
+        std::this_thread::yield();
+    else if (*request != MPI_REQUEST_NULL)
+        releaseRequest(request, status);
+    return MPI_SUCCESS;
+}
+
+int MPI_Testall(int count, MPI_Request requests[], int *flag, MPI_Status statuses[]) {
+
+    *flag = 1;
+    for (int n = 0; n < count && *flag; ++n) {
+        *flag = (requests[n] == MPI_REQUEST_NULL) || isComplete(requests[n]);
+    }
+
+    if (!*flag) {
+        std::this_thread::yield();
+        return MPI_SUCCESS;
+    }
+    for (int n = 0; n < count; ++n) {
+        if (requests[n] != MPI_REQUEST_NULL)
+            releaseRequest(&requests[n], statuses == MPI_STATUSES_IGNORE ? MPI_STATUS_IGNORE : &statuses[n]);
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Barrier(MPI_Comm comm) {
+
+    waitCollective(*joinCollective(comm, NULL, 0, std::function<void(VirtualCollective&)>()));
+    return MPI_SUCCESS;
+}
+
+int MPI_Ibarrier(MPI_Comm comm, MPI_Request *request) {
+
+    *request = new VirtualRequest(VirtualRequest::COLLECTIVE);
+    (*request)->collective = joinCollective(comm, NULL, 0, std::function<void(VirtualCollective&)>());
+    return MPI_SUCCESS;
+}
+
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+
+    int64_t num_bytes = count * getTypeSize(datatype);
+    std::shared_ptr<VirtualCollective> collective;
+
+    int rank = getCommRank(comm);
+
+    checkRank(root, comm);
+    collective = joinCollective(comm, rank == root ? buffer : NULL, num_bytes,
+                                [root](VirtualCollective &c) { c.result.swap(c.contributions[root]); });
+    waitCollective(*collective);
+    if (rank != root && num_bytes > 0)
+        std::memcpy(buffer, collective->result.data(), num_bytes);
+    return MPI_SUCCESS;
+}
+
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                  MPI_Comm comm) {
+
+    MPI_Request request;
+
+    MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, comm, &request);
+    return MPI_Wait(&request, MPI_STATUS_IGNORE);
+}
+
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                   MPI_Comm comm, MPI_Request *request) {
+
+    int64_t num_bytes = count * getTypeSize(datatype);
+
+    *request = new VirtualRequest(VirtualRequest::COLLECTIVE);
+    (*request)->collective = joinCollective(comm, sendbuf == MPI_IN_PLACE ? recvbuf : sendbuf, num_bytes,
+                                            [count, datatype, op](VirtualCollective &c) {
+                                                reduceContributions(c, count, datatype, op);
+                                            });
+    (*request)->extract = [recvbuf, num_bytes](VirtualCollective &c) {
+        if (num_bytes > 0)
+            std::memcpy(recvbuf, c.result.data(), num_bytes);
+    };
+    return MPI_SUCCESS;
+}
+
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm) {
+
+    int64_t num_bytes = recvcount * getTypeSize(recvtype);
+    int rank = getCommRank(comm);
+    std::shared_ptr<VirtualCollective> collective;
+
+    checkRank(root, comm);
+    if (sendbuf == MPI_IN_PLACE)
+        sendbuf = static_cast<char*>(recvbuf) + rank * num_bytes;
+
+    collective = joinCollective(comm, sendbuf, sendcount * getTypeSize(sendtype),
+                                std::function<void(VirtualCollective&)>());
+    waitCollective(*collective);
+    if (rank == root) {
+        for (size_t r = 0; r < collective->contributions.size(); ++r) {
+            std::memcpy(static_cast<char*>(recvbuf) + r * num_bytes, collective->contributions[r].data(),
+                        std::min<int64_t>(num_bytes, collective->contributions[r].size()));
+        }
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Dims_create(int nnodes, int ndims, int dims[]) {
+
+    std::vector<int> factors;
+    std::vector<int> free_dims;
+    int remaining = nnodes;
+
+    for (int d = 0; d < ndims; ++d) {
+        if (dims[d] > 0)
+            remaining /= dims[d];
+        else
+            free_dims.push_back(d);
+    }
+    if (free_dims.empty())
+        return MPI_SUCCESS;
+
+    for (int f = 2; (int64_t) f * f <= remaining; ++f) {
+        while (remaining % f == 0) {
+            factors.push_back(f);
+            remaining /= f;
+        }
+    }
+    if (remaining > 1)
+        factors.push_back(remaining);
+
+    /* Largest factors first, each goes to the currently smallest dimension */
+    std::vector<int> sizes(free_dims.size(), 1);
+    for (int n = factors.size() - 1; n >= 0; --n) {
+        *std::min_element(sizes.begin(), sizes.end()) *= factors[n];
+    }
+    std::sort(sizes.begin(), sizes.end(), std::greater<int>());
+    for (size_t d = 0; d < free_dims.size(); ++d) {
+        dims[free_dims[d]] = sizes[d];
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Cart_create(MPI_Comm comm_old, int ndims, const int dims[], const int periods[], int reorder,
+                    MPI_Comm *comm_cart) {
+
+    int size = 1;
+    std::shared_ptr<VirtualComm> comm;
+
+    for (int d = 0; d < ndims; ++d)
+        size *= dims[d];
+    if (size > getCommSize(comm_old))
+        fail("Cartesian grid of " + std::to_string(size) + " ranks does not fit the communicator");
+
+    comm = createComm(*comm_cart, size);
+    comm->dims.assign(dims, dims + ndims);
+    comm->periods.assign(periods, periods + ndims);
+
+    /* Ranks outside of the grid are not members */
+    if (my_rank >= size)
+        *comm_cart = MPI_COMM_NULL;
+    return MPI_SUCCESS;
+}
+
+/*!
+ * @brief Get the Cartesian topology of the communicator.
+ */
+static std::shared_ptr<VirtualComm> getCart(MPI_Comm comm) {
+
+    std::shared_ptr<VirtualComm> topology = getComm(comm);
+    if (topology->dims.empty())
+        fail("communicator " + std::to_string(comm) + " has no Cartesian topology");
+    return topology;
+}
+
+int MPI_Cart_coords(MPI_Comm comm, int rank, int maxdims, int coords[]) {
+
+    std::shared_ptr<VirtualComm> topology = getCart(comm);
+
+    /* The last dimension changes fastest */
+    for (int d = std::min<int>(maxdims, topology->dims.size()) - 1; d >= 0; --d) {
+        coords[d] = rank % topology->dims[d];
+        rank /= topology->dims[d];
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Cart_rank(MPI_Comm comm, const int coords[], int *rank) {
+
+    std::shared_ptr<VirtualComm> topology = getCart(comm);
+
+    *rank = 0;
+    for (size_t d = 0; d < topology->dims.size(); ++d) {
+        int coord = coords[d];
+        if (topology->periods[d])
+            coord = ((coord % topology->dims[d]) + topology->dims[d]) % topology->dims[d];
+        else if (coord < 0 || coord >= topology->dims[d])
+            fail("coordinate " + std::to_string(coord) + " is out of the Cartesian grid");
+        *rank = *rank * topology->dims[d] + coord;
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Cart_shift(MPI_Comm comm, int direction, int disp, int *rank_source, int *rank_dest) {
+
+    std::shared_ptr<VirtualComm> topology = getCart(comm);
+    std::vector<int> coords(topology->dims.size());
+    int dim = topology->dims[direction];
+
+    MPI_Cart_coords(comm, getCommRank(comm), coords.size(), coords.data());
+    int origin = coords[direction];
+    for (int side = 0; side < 2; ++side) {
+        int coord = origin + ((side == 0) ? -disp : disp);
+        int *rank = (side == 0) ? rank_source : rank_dest;
+        if (!topology->periods[direction] && (coord < 0 || coord >= dim)) {
+            *rank = MPI_PROC_NULL;
+            continue;
+        }
+        coords[direction] = coord;
+        MPI_Cart_rank(comm, coords.data(), rank);
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Cart_sub(MPI_Comm comm, const int remain_dims[], MPI_Comm *newcomm) {
+
+    std::shared_ptr<VirtualComm> topology = getCart(comm);
+    int ndims = topology->dims.size();
+    int size = getCommSize(comm);
+    std::vector<int> colors(num_ranks, MPI_UNDEFINED);
+    std::vector<int> keys(num_ranks, 0);
+    std::vector<int> coords(ndims);
+    std::vector<int> dims;
+    std::vector<int> periods;
+
+    if (!topology->groups.empty())
+        fail("Cartesian grids of split communicators are not supported");
+
+    /* Ranks sharing the coordinates of the dropped dimensions form a group */
+    for (int r = 0; r < size; ++r) {
+        MPI_Cart_coords(comm, r, ndims, coords.data());
+        colors[r] = 0;
+        for (int d = 0; d < ndims; ++d) {
+            if (remain_dims[d])
+                keys[r] = keys[r] * topology->dims[d] + coords[d];
+            else
+                colors[r] = colors[r] * topology->dims[d] + coords[d];
+        }
+    }
+    for (int d = 0; d < ndims; ++d) {
+        if (remain_dims[d]) {
+            dims.push_back(topology->dims[d]);
+            periods.push_back(topology->periods[d]);
+        }
+    }
+
+    std::shared_ptr<VirtualComm> sub = createSplitComm(*newcomm, colors, keys);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (sub->dims.empty()) {
+        sub->dims = dims;
+        sub->periods = periods;
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Dist_graph_create_adjacent(MPI_Comm comm_old, int indegree, const int sources[],
+                                   const int sourceweights[], int outdegree, const int destinations[],
+                                   const int destweights[], MPI_Info info, int reorder,
+                                   MPI_Comm *comm_dist_graph) {
+
+    int size = getCommSize(comm_old);
+    bool weighted = sourceweights != MPI_UNWEIGHTED && destweights != MPI_UNWEIGHTED;
+    std::shared_ptr<VirtualComm> comm = createComm(*comm_dist_graph, size);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (comm->sources.empty()) {
+        comm->sources.resize(size);
+        comm->source_weights.resize(size);
+        comm->destinations.resize(size);
+        comm->destination_weights.resize(size);
+    }
+    comm->sources[my_rank].assign(sources, sources + indegree);
+    comm->destinations[my_rank].assign(destinations, destinations + outdegree);
+    if (weighted && indegree > 0)
+        comm->source_weights[my_rank].assign(sourceweights, sourceweights + indegree);
+    if (weighted && outdegree > 0)
+        comm->destination_weights[my_rank].assign(destweights, destweights + outdegree);
+    return MPI_SUCCESS;
+}
+
+int MPI_Dist_graph_neighbors_count(MPI_Comm comm, int *indegree, int *outdegree, int *weighted) {
+
+    std::shared_ptr<VirtualComm> topology = getComm(comm);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    *indegree = topology->sources[my_rank].size();
+    *outdegree = topology->destinations[my_rank].size();
+    *weighted = (topology->source_weights[my_rank].size() == topology->sources[my_rank].size()
+                 && topology->destination_weights[my_rank].size() == topology->destinations[my_rank].size());
+    return MPI_SUCCESS;
+}
+
+int MPI_Dist_graph_neighbors(MPI_Comm comm, int maxindegree, int sources[], int sourceweights[],
+                             int maxoutdegree, int destinations[], int destweights[]) {
+
+    std::shared_ptr<VirtualComm> topology = getComm(comm);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    const std::vector<int> &src = topology->sources[my_rank];
+    const std::vector<int> &dst = topology->destinations[my_rank];
+
+    for (int n = 0; n < std::min<int>(maxindegree, src.size()); ++n) {
+        sources[n] = src[n];
+        if (sourceweights != MPI_UNWEIGHTED && n < (int) topology->source_weights[my_rank].size())
+            sourceweights[n] = topology->source_weights[my_rank][n];
+    }
+    for (int n = 0; n < std::min<int>(maxoutdegree, dst.size()); ++n) {
+        destinations[n] = dst[n];
+        if (destweights != MPI_UNWEIGHTED && n < (int) topology->destination_weights[my_rank].size())
+            destweights[n] = topology->destination_weights[my_rank][n];
+    }
+    return MPI_SUCCESS;
+}
+
+int MPI_Neighbor_alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                          int recvcount, MPI_Datatype recvtype, MPI_Comm comm) {
+
+    std::shared_ptr<VirtualComm> topology = getComm(comm);
+    int64_t send_bytes = sendcount * getTypeSize(sendtype);
+    int64_t recv_bytes = recvcount * getTypeSize(recvtype);
+    std::vector<int> sources;
+    std::vector<int> destinations;
+    std::vector<int> recv_tags;
+    std::vector<int> send_tags;
+    std::vector<MPI_Request> requests;
+
+    if (!topology->dims.empty()) {
+        /* Neighbors of a Cartesian grid are the lower and the upper ones of each dimension. The tag
+         * tells which block of the receiver the message fills, so the two messages between the
+         * same ranks (periodic dimensions of size 2) are not mixed up. */
+        for (int d = 0; d < (int) topology->dims.size(); ++d) {
+            int lower, upper;
+            MPI_Cart_shift(comm, d, 1, &lower, &upper);
+            sources.push_back(lower);
+            sources.push_back(upper);
+            recv_tags.push_back(neighbor_tag - 2 * d);
+            recv_tags.push_back(neighbor_tag - 2 * d - 1);
+            destinations.push_back(lower);
+            destinations.push_back(upper);
+            send_tags.push_back(neighbor_tag - 2 * d - 1);
+            send_tags.push_back(neighbor_tag - 2 * d);
+        }
+    }
+    else {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        if (topology->sources.empty())
+            fail("communicator " + std::to_string(comm) + " has no topology");
+        sources = topology->sources[my_rank];
+        destinations = topology->destinations[my_rank];
+        recv_tags.assign(sources.size(), neighbor_tag);
+        send_tags.assign(destinations.size(), neighbor_tag);
+    }
+
+    for (size_t n = 0; n < sources.size(); ++n) {
+        requests.push_back(postRecv(static_cast<char*>(recvbuf) + n * recv_bytes, recvcount, recvtype,
+                                    sources[n], recv_tags[n], comm));
+    }
+    for (size_t n = 0; n < destinations.size(); ++n) {
+        postSend(static_cast<const char*>(sendbuf) + n * send_bytes, sendcount, sendtype, destinations[n],
+                 send_tags[n], comm, std::shared_ptr<std::atomic<bool> >());
+    }
+    return MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+/*!
+ * @brief Start the ranks: rank 0 runs on the main thread, the others on their own threads.
+ * @return Exit code of the first failed rank, if any.
+ */
+int main(int argc, char** argv) {
+
+    const char *env = std::getenv("VIRTUAL_RANKS");
+    std::vector<std::thread> threads;
+    std::vector<int> exit_codes;
+
+    num_ranks = (env != NULL) ? std::atoi(env) : 1;
+    if (num_ranks < 1) {
+        std::cerr << "Error! VIRTUAL_RANKS has to be a positive number..." << std::endl;
+        return EXIT_FAILURE;
+    }
+    env = std::getenv("VIRTUAL_RANKS_PER_NODE");
+    ranks_per_node = (env != NULL) ? std::atoi(env) : 0;
+
+    types[MPI_BYTE].size = 1;
+    types[MPI_INT].size = sizeof(int);
+    types[MPI_DOUBLE].size = sizeof(double);
+    types[MPI_2INT].size = 2 * sizeof(int);
+    num_types = MPI_2INT + 1;
+    mailboxes = new VirtualMailbox[num_ranks];
+    exit_codes.resize(num_ranks, EXIT_SUCCESS);
+    start_time = std::chrono::steady_clock::now();
+
+    try {
+        for (int r = 1; r < num_ranks; ++r) {
+            threads.push_back(std::thread(runRank, r, argc, argv, &exit_codes[r]));
+        }
+    }
+    catch (const std::system_error& e) {
+        std::cerr << "Error! Unable to start virtual rank " << threads.size() + 1 << " (" << e.what()
+                  << "), check the limit of threads and memory..." << std::endl;
+        std::_Exit(EXIT_FAILURE);
+    }
+
+    runRank(0, argc, argv, &exit_codes[0]);
+    for (size_t n = 0; n < threads.size(); ++n) {
+        threads[n].join();
+    }
+    delete[] mailboxes;
+
+    for (int r = 0; r < num_ranks; ++r) {
+        if (exit_codes[r] != EXIT_SUCCESS)
+            return exit_codes[r];
+    }
+    return EXIT_SUCCESS;
+}
+
+#endif
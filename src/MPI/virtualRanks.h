@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_VIRTUALRANKS_H
+#define UNBALANCED_WORKLOAD_VIRTUALRANKS_H
+
+#include <cstdint>
+
+/*
+ * In-memory replacement of MPI, enabled by USE_VIRTUAL_RANKS (see make_all.sh). The whole job runs
+ * in a single process: every rank is a thread executing the program's main(), the number of ranks
+ * is taken from the environment variable VIRTUAL_RANKS. Only the subset of MPI used by the project
+ * is provided, with the semantics of a single-node MPI library with eager sends:
+ *  - messages are matched in order against the posted receives, then queued as unexpected ones;
+ *  - synchronous sends complete once the message is matched;
+ *  - collectives are matched by their order on the communicator, the ranks contribute in any order
+ *    and the result is combined in the order of ranks, so it does not depend on the timing;
+ *  - topologies are not reordered, the ranks of all communicators equal the ones of MPI_COMM_WORLD,
+ *    except for the split ones (see MPI_Cart_sub), whose groups share a handle;
+ *  - handles of communicators are never reused, freeing one only invalidates the caller's handle;
+ *  - all ranks share a node, unless VIRTUAL_RANKS_PER_NODE splits them into emulated nodes of
+ *    consecutive ranks (see MPI_Comm_split_type).
+ * Datatypes and operations are registered once per distinct definition, so the lazily created
+ * static ones (see ReductionBatch, ReproducibleSum) get the same handle on all ranks.
+ */
+
+typedef int MPI_Comm;
+typedef int MPI_Datatype;
+typedef int MPI_Op;
+typedef int MPI_Info;
+typedef struct VirtualRequest* MPI_Request;
+
+typedef struct {
+    int MPI_SOURCE;
+    int MPI_TAG;
+    int MPI_ERROR;
+    int64_t num_bytes;          // Size of the received message
+} MPI_Status;
+
+typedef void (MPI_User_function)(void *invec, void *inoutvec, int *len, MPI_Datatype *datatype);
+
+#define MPI_SUCCESS             0
+#define MPI_ERR_OTHER           15
+#define MPI_UNDEFINED           (-32766)
+
+#define MPI_COMM_NULL           (-1)
+#define MPI_COMM_WORLD          0
+
+#define MPI_DATATYPE_NULL       0
+#define MPI_BYTE                1
+#define MPI_INT                 2
+#define MPI_DOUBLE              3
+#define MPI_2INT                4
+
+#define MPI_OP_NULL             0
+#define MPI_SUM                 1
+#define MPI_MIN                 2
+#define MPI_MAX                 3
+#define MPI_MINLOC              4
+#define MPI_MAXLOC              5
+
+#define MPI_INFO_NULL           0
+#define MPI_COMM_TYPE_SHARED    1
+#define MPI_ANY_SOURCE          (-2)
+#define MPI_ANY_TAG             (-1)
+#define MPI_PROC_NULL           (-3)
+#define MPI_REQUEST_NULL        ((MPI_Request) 0)
+#define MPI_STATUS_IGNORE       ((MPI_Status*) 0)
+#define MPI_STATUSES_IGNORE     ((MPI_Status*) 0)
+#define MPI_IN_PLACE            ((void*) 1)
+#define MPI_WEIGHTS_EMPTY       ((int*) 1)
+#define MPI_UNWEIGHTED          ((int*) 2)
+
+#define MPI_THREAD_SINGLE       0
+#define MPI_THREAD_FUNNELED     1
+#define MPI_THREAD_SERIALIZED   2
+#define MPI_THREAD_MULTIPLE     3
+
+int MPI_Init_thread(int *argc, char ***argv, int required, int *provided);
+int MPI_Finalize();
+int MPI_Finalized(int *flag);
+int MPI_Abort(MPI_Comm comm, int errorcode);
+double MPI_Wtime();
+
+int MPI_Comm_rank(MPI_Comm comm, int *rank);
+int MPI_Comm_size(MPI_Comm comm, int *size);
+int MPI_Comm_split_type(MPI_Comm comm, int split_type, int key, MPI_Info info, MPI_Comm *newcomm);
+int MPI_Comm_free(MPI_Comm *comm);
+
+int MPI_Type_contiguous(int count, MPI_Datatype oldtype, MPI_Datatype *newtype);
+int MPI_Type_commit(MPI_Datatype *datatype);
+int MPI_Op_create(MPI_User_function *function, int commute, MPI_Op *op);
+
+int MPI_Send(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm);
+int MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+             MPI_Status *status);
+int MPI_Isend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request *request);
+int MPI_Issend(const void *buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+               MPI_Request *request);
+int MPI_Irecv(void *buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request *request);
+int MPI_Sendrecv(const void *sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag,
+                 void *recvbuf, int recvcount, MPI_Datatype recvtype, int source, int recvtag,
+                 MPI_Comm comm, MPI_Status *status);
+int MPI_Probe(int source, int tag, MPI_Comm comm, MPI_Status *status);
+int MPI_Iprobe(int source, int tag, MPI_Comm comm, int *flag, MPI_Status *status);
+int MPI_Get_count(const MPI_Status *status, MPI_Datatype datatype, int *count);
+
+int MPI_Wait(MPI_Request *request, MPI_Status *status);
+int MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[]);
+int MPI_Test(MPI_Request *request, int *flag, MPI_Status *status);
+int MPI_Testall(int count, MPI_Request requests[], int *flag, MPI_Status statuses[]);
+
+int MPI_Barrier(MPI_Comm comm);
+int MPI_Ibarrier(MPI_Comm comm, MPI_Request *request);
+int MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm);
+int MPI_Allreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                  MPI_Comm comm);
+int MPI_Iallreduce(const void *sendbuf, void *recvbuf, int count, MPI_Datatype datatype, MPI_Op op,
+                   MPI_Comm comm, MPI_Request *request);
+int MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+               MPI_Datatype recvtype, int root, MPI_Comm comm);
+
+int MPI_Dims_create(int nnodes, int ndims, int dims[]);
+int MPI_Cart_create(MPI_Comm comm_old, int ndims, const int dims[], const int periods[], int reorder,
+                    MPI_Comm *comm_cart);
+int MPI_Cart_coords(MPI_Comm comm, int rank, int maxdims, int coords[]);
+int MPI_Cart_rank(MPI_Comm comm, const int coords[], int *rank);
+int MPI_Cart_shift(MPI_Comm comm, int direction, int disp, int *rank_source, int *rank_dest);
+int MPI_Cart_sub(MPI_Comm comm, const int remain_dims[], MPI_Comm *newcomm);
+int MPI_Dist_graph_create_adjacent(MPI_Comm comm_old, int indegree, const int sources[],
+                                   const int sourceweights[], int outdegree, const int destinations[],
+                                   const int destweights[], MPI_Info info, int reorder,
+                                   MPI_Comm *comm_dist_graph);
+int MPI_Dist_graph_neighbors_count(MPI_Comm comm, int *indegree, int *outdegree, int *weighted);
+int MPI_Dist_graph_neighbors(MPI_Comm comm, int maxindegree, int sources[], int sourceweights[],
+                             int maxoutdegree, int destinations[], int destweights[]);
+int MPI_Neighbor_alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype, void *recvbuf,
+                          int recvcount, MPI_Datatype recvtype, MPI_Comm comm);
+
+/*!
+ * @brief Entry point of a rank, i.e. the program's main() renamed below.
+ */
+int virtualMain(int argc, char** argv);
+
+/* The runtime defines the actual main(), which starts the ranks */
+#ifndef VIRTUAL_RANKS_RUNTIME
+#define main virtualMain
+#endif
+
+#endif //UNBALANCED_WORKLOAD_VIRTUALRANKS_H
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "wireFormat.h"
+#include "reductionBatch.h"
+
+/*
+ * Conversion kernels are written as plain loops without branches, so the compiler vectorizes
+ * them (the errors are accumulated by the same loops).
+ */
+static inline uint16_t convertToBf16(float value) {
+
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    /* Round to nearest even, NaNs keep a nonzero mantissa instead of being rounded to infinity */
+    uint32_t rounded = (bits + 0x7fff + ((bits >> 16) & 1)) >> 16;
+    uint32_t quiet_nan = (bits >> 16) | 0x40;
+    return (uint16_t) (((bits & 0x7fffffff) > 0x7f800000) ? quiet_nan : rounded);
+}
+
+static inline float convertFromBf16(uint16_t value) {
+
+    uint32_t bits = (uint32_t) value << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+static void encodeFloat(const double* values, int64_t size, float* buffer, WireStats &stats) {
+
+    double max_abs = 0., max_rel = 0., sum_sq = 0.;
+
+    #pragma omp simd reduction(max:max_abs, max_rel) reduction(+:sum_sq)
+    for (int64_t n = 0; n < size; ++n) {
+        buffer[n] = (float) values[n];
+        double error = std::fabs(values[n] - (double) buffer[n]);
+        double rel = (values[n] != 0.) ? error / std::fabs(values[n]) : 0.;
+        max_abs = std::max(max_abs, error);
+        max_rel = std::max(max_rel, rel);
+        sum_sq += error * error;
+    }
+
+    stats.max_abs_error = max_abs;
+    stats.max_rel_error = max_rel;
+    stats.sum_sq_error = sum_sq;
+}
+
+static void encodeBf16(const double* values, int64_t size, uint16_t* buffer, WireStats &stats) {
+
+    double max_abs = 0., max_rel = 0., sum_sq = 0.;
+
+    #pragma omp simd reduction(max:max_abs, max_rel) reduction(+:sum_sq)
+    for (int64_t n = 0; n < size; ++n) {
+        buffer[n] = convertToBf16((float) values[n]);
+        double error = std::fabs(values[n] - (double) convertFromBf16(buffer[n]));
+        double rel = (values[n] != 0.) ? error / std::fabs(values[n]) : 0.;
+        max_abs = std::max(max_abs, error);
+        max_rel = std::max(max_rel, rel);
+        sum_sq += error * error;
+    }
+
+    stats.max_abs_error = max_abs;
+    stats.max_rel_error = max_rel;
+    stats.sum_sq_error = sum_sq;
+}
+
+void WireStats::merge(const WireStats &other) {
+
+    max_abs_error = std::max(max_abs_error, other.max_abs_error);
+    max_rel_error = std::max(max_rel_error, other.max_rel_error);
+    sum_sq_error += other.sum_sq_error;
+    num_values += other.num_values;
+}
+
+void WireStats::reduce() {
+
+    ReductionBatch batch;
+    batch.add(max_abs_error, ReductionBatch::OP_MAX);
+    batch.add(max_rel_error, ReductionBatch::OP_MAX);
+    batch.add(sum_sq_error, ReductionBatch::OP_SUM);
+    batch.add(num_values, ReductionBatch::OP_SUM);
+    batch.flush();
+}
+
+double WireStats::getRmsError() const {
+
+    return (num_values > 0) ? std::sqrt(sum_sq_error / num_values) : 0.;
+}
+
+void WireFormat::encode(const double* values, int64_t size, void* buffer) {
+
+    last_stats.clear();
+
+    if (precision == WIRE_DOUBLE)
+        std::memcpy(buffer, values, size * sizeof(double));
+    else if (precision == WIRE_FLOAT)
+        encodeFloat(values, size, static_cast<float*>(buffer), last_stats);
+    else
+        encodeBf16(values, size, static_cast<uint16_t*>(buffer), last_stats);
+
+    last_stats.num_values = size;
+    total_stats.merge(last_stats);
+    num_bytes += getBytes(size);
+}
+
+void WireFormat::decode(const void* buffer, int64_t size, double* values) {
+
+    if (precision == WIRE_DOUBLE) {
+        std::memcpy(values, buffer, size * sizeof(double));
+    }
+    else if (precision == WIRE_FLOAT) {
+        const float *src = static_cast<const float*>(buffer);
+        #pragma omp simd
+        for (int64_t n = 0; n < size; ++n)
+            values[n] = src[n];
+    }
+    else {
+        const uint16_t *src = static_cast<const uint16_t*>(buffer);
+        #pragma omp simd
+        for (int64_t n = 0; n < size; ++n)
+            values[n] = convertFromBf16(src[n]);
+    }
+}
+
+void WireFormat::clearStats() {
+
+    last_stats.clear();
+    total_stats.clear();
+    num_bytes = 0;
+}
+
+std::string WireFormat::getName(WirePrecision precision) {
+
+    return (precision == WIRE_DOUBLE) ? "double" : (precision == WIRE_FLOAT) ? "float" : "bf16";
+}
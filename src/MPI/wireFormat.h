@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_WIREFORMAT_H
+#define UNBALANCED_WORKLOAD_WIREFORMAT_H
+
+#include <string>
+#include <cstdint>
+
+#include "../common.h"
+#include "../General/macro.h"
+
+/*!
+ * @brief Errors introduced by converting values to the wire format.
+ */
+struct WireStats {
+    double max_abs_error;
+    double max_rel_error;       // Relative to the magnitude of the value (nonzero values only)
+    double sum_sq_error;
+    int64_t num_values;
+
+    WireStats() { clear(); }
+
+    void clear() {
+        max_abs_error = max_rel_error = sum_sq_error = 0.;
+        num_values = 0;
+    }
+
+    void merge(const WireStats &other);
+
+    /*!
+     * @brief Combine the statistics of all processes.
+     */
+    void reduce();
+
+    /*!
+     * @brief Get the root mean square error.
+     */
+    double getRmsError() const;
+};
+
+/*!
+ * \class WireFormat
+ * @brief Converts doubles into a packed reduced-precision buffer for sending and back on receipt.
+ * Computations are always done in double precision, only the messages are converted. Float
+ * values are rounded to nearest, bf16 values are the upper halves of the floats rounded to
+ * nearest even (so a value is rounded twice). The sender measures the errors of each
+ * conversion, as it knows the exact values.
+ */
+class WireFormat {
+public:
+    WireFormat(WirePrecision wire_precision = WIRE_DOUBLE) : precision(wire_precision), num_bytes(0) { }
+
+    ~WireFormat() { }
+
+    /*!
+     * @brief Convert the values into the buffer of \e getBytes(size) bytes.
+     * Errors of the conversion are stored as the last statistics and added to the total ones.
+     */
+    void encode(const double* values, int64_t size, void* buffer);
+
+    /*!
+     * @brief Convert the buffer back into doubles.
+     */
+    void decode(const void* buffer, int64_t size, double* values);
+
+    inline WirePrecision getPrecision() {
+        return precision;
+    }
+
+    /*!
+     * @brief Get size of a value on the wire.
+     */
+    inline int getValueSize() {
+        return (precision == WIRE_DOUBLE) ? sizeof(double) : (precision == WIRE_FLOAT) ? sizeof(float)
+                                                                                       : sizeof(uint16_t);
+    }
+
+    inline int64_t getBytes(int64_t size) {
+        return size * getValueSize();
+    }
+
+    /*!
+     * @brief Get statistics of the last \e encode() call.
+     */
+    inline WireStats& getLastStats() {
+        return last_stats;
+    }
+
+    /*!
+     * @brief Get statistics of all \e encode() calls since the last \e clearStats().
+     */
+    inline WireStats& getTotalStats() {
+        return total_stats;
+    }
+
+    /*!
+     * @brief Get number of encoded bytes since the last \e clearStats().
+     */
+    inline int64_t getEncodedBytes() {
+        return num_bytes;
+    }
+
+    void clearStats();
+
+    static std::string getName(WirePrecision precision);
+
+private:
+    WirePrecision precision;
+    WireStats last_stats;
+    WireStats total_stats;
+    int64_t num_bytes;
+};
+
+#endif //UNBALANCED_WORKLOAD_WIREFORMAT_H
@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <iomanip>
+
+#include "benchmarks.h"
+#include "common.h"
+#include "graph.h"
+#include "processGraph.h"
+#include "reproducibleSum.h"
+
+int Benchmarks::run(const std::string &name, IndicesIJ elts_glob, IndicesIJ num_parts) {
+
+    if (name == "pgraph") {
+        benchProcessGraph(elts_glob, num_parts);
+    }
+    else if (name == "gen") {
+        benchGenerator(elts_glob);
+    }
+    else if (name == "sum") {
+        benchSum(elts_glob);
+    }
+    else {
+        std::cerr << "Error! Unknown benchmark: " << name << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+void Benchmarks::generateBlockPartitioning(IndicesIJ elts_glob, IndicesIJ num_parts, std::vector<int32_t> &part) {
+
+    int32_t block_i = std::max(elts_glob.i / num_parts.i, 1);
+    int32_t block_j = std::max(elts_glob.j / num_parts.j, 1);
+
+    part.resize((int64_t) elts_glob.i * elts_glob.j);
+    for (int32_t i = 0; i < elts_glob.i; ++i) {
+        int32_t proc_ind_i = std::min(i / block_i, num_parts.i - 1);
+        for (int32_t j = 0; j < elts_glob.j; ++j) {
+            int32_t proc_ind_j = std::min(j / block_j, num_parts.j - 1);
+            part[j + (int64_t) i * elts_glob.j] = proc_ind_j + proc_ind_i * num_parts.j;
+        }
+    }
+}
+
+void Benchmarks::benchProcessGraph(IndicesIJ elts_glob, IndicesIJ num_parts) {
+
+    Graph graph(ADJ_LIST);
+    ProcessGraph process_graph;
+    std::map<int32_t, std::vector<int32_t> > map_of_procs;
+    std::map<int32_t, std::vector<int32_t> > map_of_weights;
+    std::vector<int32_t> part;
+    int32_t num_procs = num_parts.i * num_parts.j;
+    double time_map = 1.e+30;
+    double time_csr = 1.e+30;
+    bool match = true;
+
+    graph.generateStructured(elts_glob);
+    generateBlockPartitioning(elts_glob, num_parts, part);
+
+    for (int rep = 0; rep < num_repeats; ++rep) {
+        double start = getWallTime();
+
+        /* Assembly via std::map: push every cut edge, then sort and count duplicates */
+        map_of_procs.clear();
+        map_of_weights.clear();
+        for (int32_t row = 0; row < graph.getRows(); ++row) {
+            int current_rank = part[row];
+            for (int32_t ckey = graph.getOffsets()[row]; ckey < graph.getOffsets()[row + 1]; ++ckey) {
+                int ngb_rank = part[graph.getNodes()[ckey]];
+                if (ngb_rank != current_rank) {
+                    map_of_procs[current_rank].push_back(ngb_rank);
+                }
+            }
+        }
+        for (auto it = map_of_procs.begin(); it != map_of_procs.end(); ++it) {
+            std::vector<int32_t> &ngbs = it->second;
+            std::vector<int32_t> &faces = map_of_weights[it->first];
+            std::sort(ngbs.begin(), ngbs.end());
+            int32_t num_unique = 0;
+            for (size_t n = 0; n < ngbs.size(); ++n) {
+                if (n > 0 && ngbs[n] == ngbs[num_unique - 1]) {
+                    ++faces[num_unique - 1];
+                }
+                else {
+                    ngbs[num_unique] = ngbs[n];
+                    faces.push_back(1);
+                    ++num_unique;
+                }
+            }
+            ngbs.resize(num_unique);
+        }
+        time_map = std::min(time_map, getWallTime() - start);
+
+        start = getWallTime();
+        process_graph.build(graph, part.data(), num_procs);
+        time_csr = std::min(time_csr, getWallTime() - start);
+    }
+
+    /* Both structures must describe the same graph */
+    for (int32_t pid = 0; pid < num_procs && match; ++pid) {
+        std::vector<int32_t> &ngbs = map_of_procs[pid];
+        std::vector<int32_t> &faces = map_of_weights[pid];
+        match = ((int32_t) ngbs.size() == process_graph.getNumNeighbors(pid))
+                && std::equal(ngbs.begin(), ngbs.end(), process_graph.getNeighbors(pid))
+                && std::equal(faces.begin(), faces.end(), process_graph.getWeights(pid));
+    }
+
+    std::cout << "Graph of processes: " << (int64_t) elts_glob.i * elts_glob.j << " cells, "
+              << num_procs << " processes, " << process_graph.getRanks().size() << " links\n"
+              << "  std::map:     " << time_map << "s\n"
+              << "  ProcessGraph: " << time_csr << "s (x" << time_map / time_csr << ")\n"
+              << "  results " << (match ? "match" : "DO NOT match") << "\n";
+}
+
+void Benchmarks::benchGenerator(IndicesIJ elts_glob) {
+
+    int8_t types[2] = {ADJ_LIST, ADJ_MATRIX};
+    std::string names[2] = {"ADJ_LIST", "ADJ_MATRIX"};
+
+    for (int t = 0; t < 2; ++t) {
+        Graph graph_serial(types[t]);
+        Graph graph_parallel(types[t]);
+        double time_serial = 1.e+30;
+        double time_parallel = 1.e+30;
+        double num_edges;
+        bool match;
+
+        for (int rep = 0; rep < num_repeats; ++rep) {
+            double start = getWallTime();
+            graph_serial.generateStructured(elts_glob);
+            time_serial = std::min(time_serial, getWallTime() - start);
+
+            start = getWallTime();
+            graph_parallel.generateStructuredParallel(elts_glob);
+            time_parallel = std::min(time_parallel, getWallTime() - start);
+        }
+
+        match = graph_serial.getOffsets() == graph_parallel.getOffsets()
+                && graph_serial.getNodes() == graph_parallel.getNodes()
+                && graph_serial.getColumns() == graph_parallel.getColumns();
+        num_edges = graph_serial.getNodes().size();
+
+        std::cout << "Structured graph (" << names[t] << "): " << (int64_t) elts_glob.i * elts_glob.j
+                  << " cells, " << (int64_t) num_edges << " entries\n"
+                  << "  serial:   " << time_serial << "s, " << num_edges / time_serial << " edges/s\n"
+                  << "  parallel: " << time_parallel << "s, " << num_edges / time_parallel << " edges/s (x"
+                  << time_serial / time_parallel << ")\n"
+                  << "  results " << (match ? "match" : "DO NOT match") << "\n";
+    }
+}
+
+void Benchmarks::benchSum(IndicesIJ elts_glob) {
+
+    int64_t size = (int64_t) elts_glob.i * elts_glob.j;
+    std::vector<double> values(size);
+    std::mt19937_64 generator(2024);
+    std::uniform_real_distribution<double> distribution(-1., 1.);
+    double time_naive = 1.e+30;
+    double time_exact = 1.e+30;
+    double naive[2] = {0., 0.};
+    double exact[2] = {0., 0.};
+
+    /* Values of very different magnitudes and signs, similar to the results of cells */
+    for (int64_t n = 0; n < size; ++n) {
+        double value = distribution(generator);
+        values[n] = std::exp(15. * std::fabs(value)) * ((value < 0.) ? -1. : 1.) * 1.e-3;
+    }
+
+    /* The second pass sums up the shuffled values */
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1)
+            std::shuffle(values.begin(), values.end(), generator);
+
+        for (int rep = 0; rep < num_repeats; ++rep) {
+            double start = getWallTime();
+            double sum = 0.;
+            for (int64_t n = 0; n < size; ++n)
+                sum += values[n];
+            time_naive = std::min(time_naive, getWallTime() - start);
+            naive[pass] = sum;
+
+            start = getWallTime();
+            ReproducibleSum exact_sum;
+            for (int64_t n = 0; n < size; ++n)
+                exact_sum.add(values[n]);
+            exact[pass] = exact_sum.getValue();
+            time_exact = std::min(time_exact, getWallTime() - start);
+        }
+    }
+
+    ReproducibleSum parallel_sum;
+    double start = getWallTime();
+    parallel_sum.add(values.data(), size);
+    double time_parallel = getWallTime() - start;
+
+    std::cout << "Sum of " << size << " doubles\n" << std::setprecision(17)
+              << "  naive:      " << time_naive << "s, " << naive[0] << " vs. " << naive[1]
+              << " after shuffling (" << ((naive[0] == naive[1]) ? "match" : "DO NOT match") << ")\n"
+              << "  exact:      " << time_exact << "s (x" << time_exact / time_naive << "), " << exact[0]
+              << " vs. " << exact[1] << " (" << ((exact[0] == exact[1]) ? "match" : "DO NOT match") << ")\n"
+              << "  exact, multithreaded: " << time_parallel << "s, "
+              << ((parallel_sum.getValue() == exact[0]) ? "match" : "DO NOT match") << "\n";
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_BENCHMARKS_H
+#define UNBALANCED_WORKLOAD_BENCHMARKS_H
+
+#include <string>
+#include <vector>
+
+#include "General/structs.h"
+
+/*!
+ * \class Benchmarks
+ * @brief Micro-benchmarks of the setup stages, executed by the root process only.
+ */
+class Benchmarks {
+public:
+    /*!
+     * @brief Run the benchmark by its name.
+     * @param name Name of the benchmark
+     * @param elts_glob Global number of elements/cells in each direction
+     * @param num_parts Number of (virtual) subdomains in each direction
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int run(const std::string &name, IndicesIJ elts_glob, IndicesIJ num_parts);
+
+private:
+    /*!
+     * @brief Compare assembly of the graph of processes via \e std::map and via \e ProcessGraph.
+     */
+    void benchProcessGraph(IndicesIJ elts_glob, IndicesIJ num_parts);
+
+    /*!
+     * @brief Compare throughput (edges/s) of the serial and the multithreaded generators of structured graphs.
+     */
+    void benchGenerator(IndicesIJ elts_glob);
+
+    /*!
+     * @brief Compare the naive summation of doubles with \e ReproducibleSum, check if the results
+     * depend on the order of values.
+     */
+    void benchSum(IndicesIJ elts_glob);
+
+    /*!
+     * @brief Generate block partitioning of a structured grid without checking the number of processes.
+     */
+    void generateBlockPartitioning(IndicesIJ elts_glob, IndicesIJ num_parts, std::vector<int32_t> &part);
+
+private:
+    static const int num_repeats = 3;   // Best of \e num_repeats timings is reported
+};
+
+#endif //UNBALANCED_WORKLOAD_BENCHMARKS_H
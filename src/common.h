@@ -24,12 +24,17 @@
 #define UNBALANCED_WORKLOAD_COMMON_H
 
 #include <iostream>
+#include <sys/time.h>
 
 #define USE_MPI
 
 #ifdef USE_MPI
+#ifdef USE_VIRTUAL_RANKS
+#include "MPI/virtualRanks.h"
+#else
 #include <mpi.h>
 #endif
+#endif
 
 inline void findGlobalMin(double &value) {
 
@@ -75,9 +80,30 @@ inline void findGlobalSum(int &value) {
 #endif
 }
 
+inline void broadcastFromRoot(int32_t *data, int size, int root_pid) {
+#ifdef USE_MPI
+    MPI_Bcast(data, size, MPI_INT, root_pid, MPI_COMM_WORLD);
+#endif
+}
+
+inline double getWallTime() {
+
+    double current_time = 0.;
+#ifdef USE_MPI
+    current_time = MPI_Wtime();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    current_time = tv.tv_sec + 1.e-6 * tv.tv_usec;
+#endif
+    return current_time;
+}
+
 inline void initialize(int argc, char** argv) {
 #ifdef USE_MPI
-    MPI_Init(&argc, &argv);
+    /* Threads are used inside the processes, but only the main thread calls MPI */
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 #endif
 }
 
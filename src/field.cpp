@@ -28,22 +28,56 @@
 #include "field.h"
 #include "common.h"
 
-Field::Field() { }
+Field::Field() : num_components(1), layout(FIELD_SOA), num_ghosts(0), ghosts_k(0), padded(false),
+                 component_stride(0) { }
 
 Field::~Field() {
 
     data.clear();
-    _elts_loc.i = _elts_loc.j = 0;
-    _elts_glob.i = _elts_glob.j = 0;
+    _elts_loc.i = _elts_loc.j = _elts_loc.k = 0;
+    _elts_glob.i = _elts_glob.j = _elts_glob.k = 0;
 }
 
 void Field::initialize(IndicesIJ elts_loc, IndicesIJ elts_glob) {
 
+    initialize(IndicesIJK(elts_loc), IndicesIJK(elts_glob));
+}
+
+void Field::initialize(IndicesIJK elts_loc, IndicesIJK elts_glob) {
+
+    initialize(elts_loc, elts_glob, 1, FIELD_SOA);
+}
+
+void Field::initialize(IndicesIJK elts_loc, IndicesIJK elts_glob, int num_comps, FieldLayout field_layout,
+                       int num_ghost_layers, bool pad) {
+
+    int64_t num_cells_mem;
+
     _elts_loc = elts_loc;
     _elts_glob = elts_glob;
+    num_components = num_comps;
+    layout = field_layout;
+    num_ghosts = num_ghost_layers;
+    ghosts_k = (_elts_loc.k > 1) ? num_ghosts : 0;
+    padded = pad;
+
+    _elts_mem.i = _elts_loc.i + 2 * num_ghosts;
+    _elts_mem.j = _elts_loc.j + 2 * num_ghosts;
+    _elts_mem.k = _elts_loc.k + 2 * ghosts_k;
+
+    /* Pad the fastest direction, which is j-th for 2D fields */
+    if (padded && _elts_mem.k > 1)
+        _elts_mem.k = (_elts_mem.k + block_size - 1) / block_size * block_size;
+    else if (padded)
+        _elts_mem.j = (_elts_mem.j + block_size - 1) / block_size * block_size;
+
+    /* Each component (SoA) or each block of cells (AoSoA) starts at a cache line */
+    num_cells_mem = (int64_t) _elts_mem.i * _elts_mem.j * _elts_mem.k;
+    component_stride = (num_cells_mem + block_size - 1) / block_size * block_size;
 
     data.clear();
-    data.resize(_elts_loc.i * _elts_loc.j);
+    data.resize(component_stride * num_components);
+    touchPages();
 }
 
 void Field::generate() {
@@ -53,12 +87,20 @@ void Field::generate() {
         return;
     }
 
-    for (int i = 0; i < _elts_loc.i; ++i) {
-        for (int j = 0; j < _elts_loc.j; ++j) {
-            int id_glob = i * j; //getLocalID(i, j);
-            int max_elts = _elts_glob.i * _elts_glob.j;
-            this->operator()(i, j) = log(id_glob + 1.) / log (max_elts + 1.);// * pow(id_glob, 2.);
-        }
+    const int64_t num_elts = getNumElts();
+
+    /* The first write places the pages, so the cells are split between threads as in performDummyWork() */
+    #pragma omp parallel for schedule(static)
+    for (int64_t n = 0; n < num_elts; ++n) {
+        int k = n % _elts_loc.k;
+        int j = (n / _elts_loc.k) % _elts_loc.j;
+        int i = n / _elts_loc.k / _elts_loc.j;
+        int id_glob = i * j * (k + 1); //getLocalID(i, j, k);
+        int max_elts = _elts_glob.i * _elts_glob.j * _elts_glob.k;
+        this->operator()(i, j, k) = log(id_glob + 1.) / log (max_elts + 1.);// * pow(id_glob, 2.);
+        /* Other variables are scaled copies of the first one */
+        for (int comp = 1; comp < num_components; ++comp)
+            at(comp, i, j, k) = this->operator()(i, j, k) / (comp + 1);
     }
 }
 
@@ -71,7 +113,15 @@ void Field::print(std::string base_name) {
     if (out_str.is_open()) {
         for (int32_t i = 0; i < _elts_loc.i; ++i) {
             for (int32_t j = 0; j < _elts_loc.j; ++j) {
-                out_str << this->operator()(i, j) << " ";
+                for (int32_t k = 0; k < _elts_loc.k; ++k) {
+                    /* Components of a cell are separated by commas */
+                    for (int comp = 0; comp < num_components; ++comp) {
+                        out_str << at(comp, i, j, k) << ((comp + 1 < num_components) ? "," : " ");
+                    }
+                }
+                /* 3D fields are printed plane by plane */
+                if (_elts_loc.k > 1)
+                    out_str << "\n";
             }
             out_str << "\n";
         }
@@ -83,78 +133,313 @@ void Field::print(std::string base_name) {
     }
 }
 
+void Field::touchPages() {
+
+    const int64_t num_cells_mem = (int64_t) _elts_mem.i * _elts_mem.j * _elts_mem.k;
+
+    /* Ghost cells, padding and the rest of the last block */
+    #pragma omp parallel for schedule(static)
+    for (int64_t cell = 0; cell < component_stride; ++cell) {
+        if (cell < num_cells_mem) {
+            int64_t k = cell % _elts_mem.k - ghosts_k;
+            int64_t j = (cell / _elts_mem.k) % _elts_mem.j - num_ghosts;
+            int64_t i = cell / _elts_mem.k / _elts_mem.j - num_ghosts;
+            if (i >= 0 && i < _elts_loc.i && j >= 0 && j < _elts_loc.j && k >= 0 && k < _elts_loc.k)
+                continue;
+        }
+        for (int comp = 0; comp < num_components; ++comp)
+            data[getStorageID(comp, cell)] = 0.;
+    }
+}
+
 double Field::performDummyWork() {
 
-    double result = 0.;
-    for(int n = 0; n < data.size(); ++n) {
-        double value = getLocalLoad(data[n]);
-        for (int m = 0; m < (int) value; ++m) {
-            result += (std::log(value) + std::cos(value)) / std::exp(value);
+    ReproducibleSum result;
+    performDummyWork(result);
+    return result.getValue();
+}
+
+void Field::performDummyWork(ReproducibleSum &result) {
+
+    const int64_t num_elts = getNumElts();
+
+    /* Each thread accumulates its own part, exact sums can be merged in any order */
+    #pragma omp parallel
+    {
+        ReproducibleSum local;
+
+        /* Ghost cells and padding are not part of the domain */
+        #pragma omp for schedule(static)
+        for (int64_t n = 0; n < num_elts; ++n) {
+            for (int comp = 0; comp < num_components; ++comp)
+                local.add(performCellWork(at(comp, n)));
         }
+
+        #pragma omp critical
+        result.add(local);
+    }
+}
+
+double Field::performCellWork(double value) {
+
+    double load = getLocalLoad(value);
+    double result = 0.;
+    for (int m = 0; m < (int) load; ++m) {
+        result += (std::log(load) + std::cos(load)) / std::exp(load);
     }
     return result;
 }
 
 void Field::distribute(int32_t* partitioning, int num_glob_elts, int root_pid) {
 
+    WireFormat wire(WIRE_DOUBLE);
+    distribute(partitioning, num_glob_elts, root_pid, wire);
+}
+
+void Field::distribute(int32_t* partitioning, int num_glob_elts, int root_pid, WireFormat &wire) {
+
+    std::vector<std::vector<int32_t> > snd_cells;
+
+    // Collect the cells of each partition
+    if (getMyRank() == root_pid) {
+        snd_cells.resize(getNumProcs());
+        for (int m = 0; m < num_glob_elts; ++m) {
+            snd_cells[partitioning[m]].push_back(m);
+        }
+    }
+
+    distribute([&snd_cells](int pid, std::vector<int32_t> &cells) { cells.swap(snd_cells[pid]); },
+               root_pid, wire);
+}
+
+void Field::distribute(int32_t* partitioning, int num_glob_elts, int root_pid, WireFormat &wire, Graph &graph,
+                       LocalGraph &local_graph) {
+
+    int tag_graph = 9996;
+    std::vector<std::vector<int32_t> > snd_cells;
+    std::vector<std::vector<int32_t> > snd_graphs;
+    std::vector<MPI_Request> requests;
+
+    // Collect the cells of each partition
+    if (getMyRank() == root_pid) {
+        snd_cells.resize(getNumProcs());
+        snd_graphs.resize(getNumProcs());
+        requests.resize(getNumProcs());
+        for (int m = 0; m < num_glob_elts; ++m) {
+            snd_cells[partitioning[m]].push_back(m);
+        }
+    }
+
+    // The rows of the cells are extracted and sent while the cells of the process are at hand
+    distribute([&](int pid, std::vector<int32_t> &cells) {
+                   LocalGraph sub;
+                   sub.extract(graph, partitioning, pid, snd_cells[pid]);
+                   sub.pack(snd_graphs[pid]);
+                   MPI_Isend(snd_graphs[pid].data(), snd_graphs[pid].size(), MPI_INT, pid, tag_graph,
+                             MPI_COMM_WORLD, &requests[pid]);
+                   cells.swap(snd_cells[pid]);
+               },
+               root_pid, wire);
+
+    // Receive the local graph, its size is known from the message only
+    MPI_Status status;
+    int msg_size = 0;
+    MPI_Probe(root_pid, tag_graph, MPI_COMM_WORLD, &status);
+    MPI_Get_count(&status, MPI_INT, &msg_size);
+    std::vector<int32_t> rcv_graph(msg_size);
+    MPI_Recv(rcv_graph.data(), msg_size, MPI_INT, root_pid, tag_graph, MPI_COMM_WORLD, &status);
+    local_graph.unpack(rcv_graph);
+
+    if (getMyRank() == root_pid) {
+        MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+    }
+}
+
+void Field::distribute(const StructuredOwnership &ownership, int root_pid, WireFormat &wire) {
+
+    // Cells of a process are listed from its range, one process at a time
+    distribute([&ownership](int pid, std::vector<int32_t> &cells) { ownership.getCells(pid, cells); },
+               root_pid, wire);
+}
+
+void Field::distribute(const std::function<void(int, std::vector<int32_t>&)> &get_cells, int root_pid,
+                       WireFormat &wire) {
+
     int num_procs = getNumProcs();
     int tag_field = 9999;
-    MPI_Request request_arr[num_procs];
-    std::vector<Field> snd_field(num_procs);
-    std::vector<int> num_elts(num_procs);
+    int tag_ids = 9997;
+    MPI_Request request_arr[2 * num_procs];
+    std::vector<double> snd_values;
+    std::vector<std::vector<char> > snd_buffers(num_procs);
+    std::vector<std::vector<int32_t> > snd_cells(num_procs);
+    int32_t comp_info[3] = {num_components, layout, wire.getPrecision()};
 
     // Sync all processes first
     MPI_Barrier(MPI_COMM_WORLD);
 
-    if (getMyRank() == root_pid) {
+    // Local fields keep the components and the layout of the global one, messages have the precision of the root
+    broadcastFromRoot(comp_info, 3, root_pid);
+    WireFormat rcv_wire((WirePrecision) comp_info[2]);
 
-        // Count number of elements in each partition
-        for (int n = 0; n < num_procs; ++n) {
-            num_elts[n] = std::count(partitioning,partitioning + num_glob_elts, n);
-        }
+    if (getMyRank() == root_pid) {
 
-        // Assemble the buffers
+        // Assemble the buffers, all components of a cell are sent together
         for (int n = 0; n < num_procs; ++n) {
-            IndicesIJ num_elts_loc = {num_elts[n], 1};
-            int counter = 0;
-
-            snd_field[n].initialize(num_elts_loc, num_elts_loc);
-
-            for (int m = 0; m < num_glob_elts; ++m) {
-                if (partitioning[m] == n) {
-                    snd_field[n](counter) = data[m];
-                    ++counter;
-                    if (counter == num_elts[n])
-                        break;
-                }
-            }
+            get_cells(n, snd_cells[n]);
+            snd_values.resize(snd_cells[n].size() * num_components);
+            pack(snd_cells[n].data(), snd_cells[n].size(), snd_values.data());
+            snd_buffers[n].resize(wire.getBytes(snd_values.size()));
+            wire.encode(snd_values.data(), snd_values.size(), snd_buffers[n].data());
 
             // Send the field
-            MPI_Isend(snd_field[n].getData().data(), num_elts[n],
-                      MPI_DOUBLE, n, tag_field, MPI_COMM_WORLD, &request_arr[n]);
+            MPI_Isend(snd_buffers[n].data(), snd_buffers[n].size(),
+                      MPI_BYTE, n, tag_field, MPI_COMM_WORLD, &request_arr[n]);
+
+            // Send the global IDs, so the process knows its cells without the partitioning
+            MPI_Isend(snd_cells[n].data(), snd_cells[n].size(),
+                      MPI_INT, n, tag_ids, MPI_COMM_WORLD, &request_arr[num_procs + n]);
         }
     }
 
     // Receive data by all processes (including the root process)
     // Count the message size first
     MPI_Status status;
-    MPI_Status status_arr[num_procs];
+    MPI_Status status_arr[2 * num_procs];
     int msg_size = 0;
     MPI_Probe(root_pid, tag_field, MPI_COMM_WORLD, &status);
-    MPI_Get_count(&status, MPI_DOUBLE, &msg_size);
+    MPI_Get_count(&status, MPI_BYTE, &msg_size);
 
     // Resize the receiving buffer
-    IndicesIJ num_elts_loc = {msg_size, 1};
-    initialize(num_elts_loc, num_elts_loc);
+    std::vector<char> rcv_message(msg_size);
+    std::vector<double> rcv_buffer(msg_size / rcv_wire.getValueSize());
+    std::vector<int32_t> rcv_cells(rcv_buffer.size() / comp_info[0]);
+    IndicesIJK num_elts_loc(rcv_cells.size(), 1, 1);
+    initialize(num_elts_loc, num_elts_loc, comp_info[0], (FieldLayout) comp_info[1]);
+    for (size_t n = 0; n < rcv_cells.size(); ++n) {
+        rcv_cells[n] = n;
+    }
 
     // Receive the message
-    MPI_Recv(data.data(), msg_size, MPI_DOUBLE, root_pid,
+    MPI_Recv(rcv_message.data(), msg_size, MPI_BYTE, root_pid,
              tag_field, MPI_COMM_WORLD, &status);
+    rcv_wire.decode(rcv_message.data(), rcv_buffer.size(), rcv_buffer.data());
+    unpack(rcv_cells.data(), rcv_cells.size(), rcv_buffer.data());
+    glob_ids.resize(rcv_cells.size());
+    MPI_Recv(glob_ids.data(), glob_ids.size(), MPI_INT, root_pid, tag_ids, MPI_COMM_WORLD, &status);
 
     // Wait for finalized delivery
     if (getMyRank() == root_pid) {
-        MPI_Waitall(num_procs, request_arr, status_arr);
+        MPI_Waitall(2 * num_procs, request_arr, status_arr);
     }
 
     MPI_Barrier(MPI_COMM_WORLD);
-}
\ No newline at end of file
+}
+
+int32_t Field::migrate(const int32_t* old_part, const int32_t* new_part, int num_glob_elts) {
+
+    int num_procs = getNumProcs();
+    int my_rank = getMyRank();
+    int tag_field = 9998;
+    int32_t num_old = getNumElts();
+    int32_t num_new = 0;
+    int32_t num_received = 0;
+    std::vector<std::vector<int32_t> > snd_cells(num_procs);   // Local IDs of the sent cells
+    std::vector<int32_t> rcv_counts(num_procs, 0);
+    std::vector<int32_t> kept;              // Old local ID of each new local cell, or EMPTY if received
+    std::vector<MPI_Request> requests;
+
+    requests.reserve(2 * num_procs);
+
+    /* Both sides list the cells in ascending order of the global IDs, so no IDs are sent */
+    int32_t old_id = 0;
+    for (int32_t cell = 0; cell < num_glob_elts; ++cell) {
+        if (old_part[cell] == my_rank) {
+            if (new_part[cell] == my_rank)
+                kept.push_back(old_id);
+            else
+                snd_cells[new_part[cell]].push_back(old_id);
+            ++old_id;
+        }
+        else if (new_part[cell] == my_rank) {
+            kept.push_back(EMPTY);
+            ++rcv_counts[old_part[cell]];
+        }
+    }
+    num_new = kept.size();
+
+    std::vector<double> old_values((int64_t) num_old * num_components);
+    std::vector<int32_t> old_cells(num_old);
+    for (int32_t n = 0; n < num_old; ++n)
+        old_cells[n] = n;
+    pack(old_cells.data(), num_old, old_values.data());
+
+    std::vector<std::vector<double> > snd_buffers(num_procs);
+    std::vector<std::vector<double> > rcv_buffers(num_procs);
+    for (int pid = 0; pid < num_procs; ++pid) {
+        if (rcv_counts[pid] > 0) {
+            rcv_buffers[pid].resize((int64_t) rcv_counts[pid] * num_components);
+            requests.push_back(MPI_REQUEST_NULL);
+            MPI_Irecv(rcv_buffers[pid].data(), rcv_buffers[pid].size(), MPI_DOUBLE, pid, tag_field,
+                      MPI_COMM_WORLD, &requests.back());
+            num_received += rcv_counts[pid];
+        }
+    }
+    for (int pid = 0; pid < num_procs; ++pid) {
+        if (!snd_cells[pid].empty()) {
+            snd_buffers[pid].resize(snd_cells[pid].size() * num_components);
+            pack(snd_cells[pid].data(), snd_cells[pid].size(), snd_buffers[pid].data());
+            requests.push_back(MPI_REQUEST_NULL);
+            MPI_Isend(snd_buffers[pid].data(), snd_buffers[pid].size(), MPI_DOUBLE, pid, tag_field,
+                      MPI_COMM_WORLD, &requests.back());
+        }
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    /* Assemble the new local field, the received cells of each owner arrive in ascending order */
+    IndicesIJK num_elts_loc(num_new, 1, 1);
+    std::vector<int64_t> rcv_positions(num_procs, 0);
+    initialize(num_elts_loc, num_elts_loc, num_components, layout);
+
+    int32_t new_id = 0;
+    std::vector<const double*> new_values(num_new);
+    glob_ids.resize(num_new);
+    for (int32_t cell = 0; cell < num_glob_elts; ++cell) {
+        if (new_part[cell] != my_rank)
+            continue;
+        glob_ids[new_id] = cell;
+        new_values[new_id] = (kept[new_id] != EMPTY)
+                             ? &old_values[(int64_t) kept[new_id] * num_components]
+                             : &rcv_buffers[old_part[cell]][rcv_positions[old_part[cell]]++ * num_components];
+        ++new_id;
+    }
+
+    /* The first write places the pages, so the cells are split between threads as in performDummyWork() */
+    #pragma omp parallel for schedule(static)
+    for (int32_t n = 0; n < num_new; ++n) {
+        for (int comp = 0; comp < num_components; ++comp)
+            at(comp, n) = new_values[n][comp];
+    }
+
+    return num_received;
+}
+
+void Field::pack(const int32_t* cells, int64_t num_cells, double* buffer) {
+
+    for (int64_t n = 0; n < num_cells; ++n) {
+        for (int comp = 0; comp < num_components; ++comp) {
+            buffer[n * num_components + comp] = at(comp, cells[n]);
+        }
+    }
+}
+
+void Field::unpack(const int32_t* cells, int64_t num_cells, const double* buffer) {
+
+    /* Received fields are unpacked in the order of cells, thus the first write places the pages of each
+     * thread as in performDummyWork() */
+    #pragma omp parallel for schedule(static)
+    for (int64_t n = 0; n < num_cells; ++n) {
+        for (int comp = 0; comp < num_components; ++comp) {
+            at(comp, cells[n]) = buffer[n * num_components + comp];
+        }
+    }
+}
@@ -25,9 +25,25 @@
 
 #include <vector>
 #include <cmath>
+#include <functional>
 
 #include "General/structs.h"
+#include "General/alignedAllocator.h"
+#include "reproducibleSum.h"
+#include "localGraph.h"
+#include "MPI/wireFormat.h"
+#include "MPI/Decomposition/structuredOwnership.h"
 
+/*!
+ * \class Field
+ * @brief Multi-component field of cells.
+ * Components are stored either as separate arrays (SoA) or interleaved in blocks of
+ * \e block_size cells (AoSoA), both 64-byte aligned. Structured blocks might be surrounded
+ * by ghost layers and the fastest direction might be padded to a multiple of \e block_size
+ * cells, so each row starts at a cache line. Cells are numbered as k + n.k * (j + n.j * i)
+ * without ghost cells and padding, which are skipped by the accessors. The first component
+ * is the one used by the load model.
+ */
 class Field {
 public:
     Field();
@@ -40,6 +56,25 @@ public:
      */
     void initialize(IndicesIJ elts_loc, IndicesIJ elts_glob);
 
+    /*!
+     * @brief Initialize the 3D field.
+     * @param elts_loc Number of local elements.
+     * @param elts_glob Number of global elements.
+     */
+    void initialize(IndicesIJK elts_loc, IndicesIJK elts_glob);
+
+    /*!
+     * @brief Initialize the multi-component field.
+     * @param elts_loc Number of local elements.
+     * @param elts_glob Number of global elements.
+     * @param num_components Number of variables stored in each cell.
+     * @param layout Either \e FIELD_SOA or \e FIELD_AOSOA.
+     * @param num_ghosts Number of ghost layers around the block (in k-th direction for 3D only).
+     * @param padded Pad the fastest direction to a multiple of \e block_size cells.
+     */
+    void initialize(IndicesIJK elts_loc, IndicesIJK elts_glob, int num_components, FieldLayout layout,
+                    int num_ghosts = 0, bool padded = false);
+
     /*!
      * @brief Generate the field.
      */
@@ -60,22 +95,103 @@ public:
      */
     void distribute(int32_t* partitioning, int num_glob_elts, int root_pid);
 
+    /*!
+     * @brief Distribute the field across processes, the values are sent in the precision of \e wire.
+     * Conversion errors are collected by \e wire of the root process. Global IDs of the cells are
+     * sent along, see \e getGlobalIDs().
+     */
+    void distribute(int32_t* partitioning, int num_glob_elts, int root_pid, WireFormat &wire);
+
+    /*!
+     * @brief Distribute the field along with the part of the graph each process needs.
+     * The root process sends each process the rows of its cells and the owners of their neighbors
+     * (see \e LocalGraph), so neither the graph nor the partitioning of the whole domain has to be
+     * known by the other processes.
+     * @param graph Graph of the whole domain (root only).
+     * @param local_graph [out] Rows of the local cells and owners of the halo cells.
+     */
+    void distribute(int32_t* partitioning, int num_glob_elts, int root_pid, WireFormat &wire, Graph &graph,
+                    LocalGraph &local_graph);
+
+    /*!
+     * @brief Distribute the field across processes by the structured decomposition.
+     * The cells of each process are computed from \e ownership, so the partitioning of the whole
+     * domain is never stored.
+     */
+    void distribute(const StructuredOwnership &ownership, int root_pid, WireFormat &wire);
+
+    /*!
+     * @brief Move the cells changing their owner directly between the processes.
+     * Local cells are kept in ascending order of their global IDs, i.e. the order produced by
+     * \e distribute() with the new partitioning.
+     * @param old_part Partitioning the field is distributed by, known by all processes.
+     * @param new_part New partitioning, known by all processes.
+     * @param num_glob_elts Global number of elements.
+     * @return Number of cells received by the process.
+     */
+    int32_t migrate(const int32_t* old_part, const int32_t* new_part, int num_glob_elts);
+
+    /*!
+     * @brief Copy all components of the cells into the buffer, cell by cell.
+     * @param cells IDs of the cells.
+     * @param num_cells Number of the cells.
+     * @param buffer [out] Buffer of \e num_cells * \e getNumComponents() values.
+     */
+    void pack(const int32_t* cells, int64_t num_cells, double* buffer);
+
+    /*!
+     * @brief Copy all components of the cells from the buffer, see \e pack().
+     */
+    void unpack(const int32_t* cells, int64_t num_cells, const double* buffer);
+
     /*!
      * @brief Emulate some work by each process.
      */
     double performDummyWork();
 
+    /*!
+     * @brief Emulate some work by each process, results of cells are summed up exactly.
+     * @param result [out] Accumulator of the results of cells.
+     */
+    void performDummyWork(ReproducibleSum &result);
+
+    /*!
+     * @brief Emulate the work for a single cell, see \e performDummyWork().
+     * @param value Value stored in the cell.
+     * @return Contribution of the cell to the result.
+     */
+    double performCellWork(double value);
+
     /*!
      * @brief Get number of elements in the field.
      */
     inline int getNumElts() {
-        return data.size();
+        return _elts_loc.i * _elts_loc.j * _elts_loc.k;
+    }
+
+    inline int getNumComponents() {
+        return num_components;
+    }
+
+    /*!
+     * @brief Get global IDs of the local cells in ascending order (distributed fields only).
+     */
+    inline std::vector<int32_t>& getGlobalIDs() {
+        return glob_ids;
+    }
+
+    inline FieldLayout getLayout() {
+        return layout;
+    }
+
+    inline int getNumGhosts() {
+        return num_ghosts;
     }
 
     /*!
-     * @brief Get reference to the field.
+     * @brief Get reference to the storage (including ghost cells and padding).
      */
-    inline std::vector<double>& getData() {
+    inline std::vector<double, AlignedAllocator<double> >& getData() {
         return data;
     }
 
@@ -85,7 +201,35 @@ public:
      * @return Reference to the element.
      */
     inline double& operator()(int n) {
-        return data[n];
+        return at(0, n);
+    }
+
+    /*!
+     * @brief Get reference to a component of a particular element.
+     * @param comp Index of the component.
+     * @param n ID of the element.
+     * @return Reference to the component.
+     */
+    inline double& at(int comp, int64_t n) {
+        if (num_ghosts == 0 && !padded)
+            return data[getStorageID(comp, n)];
+        int k = n % _elts_loc.k;
+        n /= _elts_loc.k;
+        return at(comp, n / _elts_loc.j, n % _elts_loc.j, k);
+    }
+
+    /*!
+     * @brief Get reference to a component of a particular element in the 3D field.
+     * Ghost cells are accessed with indices from -num_ghosts to n + num_ghosts - 1.
+     * @param comp Index of the component.
+     * @param i i-th index of the element.
+     * @param j j-th index of the element.
+     * @param k k-th index of the element.
+     * @return Reference to the component.
+     */
+    inline double& at(int comp, int i, int j, int k) {
+        int64_t cell = (k + ghosts_k) + _elts_mem.k * ((j + num_ghosts) + (int64_t) _elts_mem.j * (i + num_ghosts));
+        return data[getStorageID(comp, cell)];
     }
 
     /*!
@@ -95,7 +239,18 @@ public:
      * @return Reference to the element.
      */
     inline double& operator()(int i, int j) {
-        return data[getLocalID(i, j)];
+        return at(0, i, j, 0);
+    }
+
+    /*!
+     * @brief Get reference to a particular element in the 3D field.
+     * @param i i-th index of the element.
+     * @param j j-th index of the element.
+     * @param k k-th index of the element.
+     * @return Reference to the element.
+     */
+    inline double& operator()(int i, int j, int k) {
+        return at(0, i, j, k);
     }
 
     /*!
@@ -108,6 +263,17 @@ public:
         return j + _elts_loc.j * i;
     }
 
+    /*!
+     * @brief Get local ID of the element in the 3D field.
+     * @param i i-th index of the element.
+     * @param j j-th index of the element.
+     * @param k k-th index of the element.
+     * @return Local for a process ID.
+     */
+    inline int getLocalID(int i, int j, int k) {
+        return k + _elts_loc.k * (j + _elts_loc.j * i);
+    }
+
     /*!
      * @brief Evaluate the workload for the specified value.
      * @param value Value to be used during the evaluation.
@@ -117,10 +283,61 @@ public:
         return std::exp(15. * value);
     }
 
+    /*!
+     * @brief Evaluate the memory footprint for the specified value.
+     * Cells with cheap computations keep more data, i.e. the footprint decreases with the load.
+     * @param value Value to be used during the evaluation.
+     * @return Memory footprint.
+     */
+    inline double getLocalMemory(double value) {
+        return std::exp(5. * (1. - value));
+    }
+
+    /*!
+     * @brief Number of cells in a block of the AoSoA layout and the padding unit (64 bytes).
+     */
+    static const int block_size = 8;
+
+private:
+    /*!
+     * @brief Zero the ghost cells and the padding with multiple threads.
+     * The storage is not initialized by the allocator. The cells of the domain are not touched
+     * here: \e generate(), \e distribute() and \e migrate() write them first, with the same static
+     * partition of cells as \e performDummyWork(), so their pages are placed on the NUMA node of
+     * the thread that computes on them.
+     */
+    void touchPages();
+
+    /*!
+     * @brief Send the cells of each process by the root one and receive the local ones.
+     * @param get_cells Fills in global IDs of the cells of a process in ascending order (root only).
+     */
+    void distribute(const std::function<void(int, std::vector<int32_t>&)> &get_cells, int root_pid,
+                    WireFormat &wire);
+
+    /*!
+     * @brief Get position of a component of the cell in the storage.
+     * @param comp Index of the component.
+     * @param cell ID of the cell in the storage, i.e. including ghost cells and padding.
+     */
+    inline int64_t getStorageID(int comp, int64_t cell) {
+        if (layout == FIELD_SOA)
+            return comp * component_stride + cell;
+        return (cell / block_size) * block_size * num_components + comp * block_size + cell % block_size;
+    }
+
 private:
-    std::vector<double> data;
-    IndicesIJ _elts_loc;
-    IndicesIJ _elts_glob;
+    std::vector<double, AlignedAllocator<double> > data;
+    IndicesIJK _elts_loc;       // 2D fields have a single layer in k-th direction
+    IndicesIJK _elts_glob;
+    IndicesIJK _elts_mem;       // Number of stored cells in each direction (ghost cells and padding)
+    int num_components;
+    FieldLayout layout;
+    int num_ghosts;             // Number of ghost layers
+    int ghosts_k;               // Number of ghost layers in k-th direction (none for 2D fields)
+    bool padded;                // The fastest direction is padded
+    int64_t component_stride;   // Distance between components of a cell (SoA)
+    std::vector<int32_t> glob_ids;  // Global IDs of the local cells, set by distribute() and migrate()
 };
 
 
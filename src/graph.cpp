@@ -22,6 +22,8 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstdlib>
 
 #include "graph.h"
 
@@ -112,6 +114,182 @@ void Graph::generateStructured(IndicesIJ size) {
     offsets[num_rows] = estimated_nnz;
 }
 
+template <StorageType TYPE>
+int64_t Graph::getStructuredOffset(IndicesIJ size, int64_t i, int64_t j) {
+
+    const int64_t diag = (TYPE == ADJ_MATRIX) ? 1 : 0;
+    const int64_t ni = size.i;
+    const int64_t nj = size.j;
+
+    /* Entries of all previous lines of cells: vertical neighbors, diagonal and horizontal neighbors */
+    int64_t before = nj * (std::max<int64_t>(i - 1, 0) + std::min<int64_t>(i, ni - 1) + i * diag)
+                     + i * 2 * (nj - 1);
+
+    /* Entries of the previous cells in the current line */
+    int64_t vert = (i > 0) + (i < ni - 1);
+    int64_t within = j * (vert + diag) + std::max<int64_t>(j - 1, 0) + std::min<int64_t>(j, nj - 1);
+
+    return before + within;
+}
+
+template <StorageType TYPE>
+void Graph::fillStructured(IndicesIJ size) {
+
+    const int32_t ni = size.i;
+    const int32_t nj = size.j;
+
+#pragma omp parallel for schedule(static)
+    for (int32_t i = 0; i < ni; ++i) {
+        const bool has_up = i > 0;
+        const bool has_down = i < ni - 1;
+        int32_t counter = getStructuredOffset<TYPE>(size, i, 0);
+
+        for (int32_t j = 0; j < nj; ++j) {
+            int32_t row = j + i * nj;
+
+            offsets[row] = counter;
+
+            /* Keep the order of generateStructured(): up, left, diagonal, right, down */
+            if (has_up) {
+                if (TYPE == ADJ_MATRIX) { nodes[counter] = 1; columns[counter] = row - nj; }
+                else { nodes[counter] = row - nj; }
+                ++counter;
+            }
+            if (j > 0) {
+                if (TYPE == ADJ_MATRIX) { nodes[counter] = 1; columns[counter] = row - 1; }
+                else { nodes[counter] = row - 1; }
+                ++counter;
+            }
+            if (TYPE == ADJ_MATRIX) {
+                nodes[counter] = 1;
+                columns[counter] = row;
+                ++counter;
+            }
+            if (j < nj - 1) {
+                if (TYPE == ADJ_MATRIX) { nodes[counter] = 1; columns[counter] = row + 1; }
+                else { nodes[counter] = row + 1; }
+                ++counter;
+            }
+            if (has_down) {
+                if (TYPE == ADJ_MATRIX) { nodes[counter] = 1; columns[counter] = row + nj; }
+                else { nodes[counter] = row + nj; }
+                ++counter;
+            }
+        }
+    }
+}
+
+void Graph::generateStructuredParallel(IndicesIJ size) {
+
+    int64_t nnz;
+
+    num_rows = size.i * size.j;
+    num_cols = num_rows;
+
+    if (g_type == ADJ_MATRIX) {
+        nnz = getStructuredOffset<ADJ_MATRIX>(size, size.i, 0);
+        nodes.resize(nnz);
+        columns.resize(nnz);
+    }
+    else {
+        nnz = getStructuredOffset<ADJ_LIST>(size, size.i, 0);
+        nodes.resize(nnz);
+        columns.clear();
+    }
+    offsets.resize(num_rows + 1);
+
+    if (g_type == ADJ_MATRIX) {
+        fillStructured<ADJ_MATRIX>(size);
+    }
+    else {
+        fillStructured<ADJ_LIST>(size);
+    }
+
+    offsets[num_rows] = nnz;
+}
+
+template <StorageType TYPE>
+void Graph::fillStructured(IndicesIJK size, int stencil) {
+
+    const int32_t ni = size.i;
+    const int32_t nj = size.j;
+    const int32_t nk = size.k;
+    const int max_dist = (stencil == 7) ? 1 : 3;   // Manhattan distance to the farthest neighbor
+
+#pragma omp parallel for schedule(static)
+    for (int32_t i = 0; i < ni; ++i) {
+        for (int32_t j = 0; j < nj; ++j) {
+            for (int32_t k = 0; k < nk; ++k) {
+                int32_t row = k + nk * (j + nj * i);
+                int32_t counter = offsets[row];
+
+                /* Visiting the neighbors in this order keeps the columns sorted */
+                for (int di = -1; di <= 1; ++di) {
+                    if (i + di < 0 || i + di >= ni)
+                        continue;
+                    for (int dj = -1; dj <= 1; ++dj) {
+                        if (j + dj < 0 || j + dj >= nj)
+                            continue;
+                        for (int dk = -1; dk <= 1; ++dk) {
+                            int dist = std::abs(di) + std::abs(dj) + std::abs(dk);
+                            if (k + dk < 0 || k + dk >= nk || dist > max_dist)
+                                continue;
+                            if (TYPE == ADJ_LIST && dist == 0)
+                                continue;
+
+                            int32_t col = row + dk + nk * (dj + nj * di);
+                            if (TYPE == ADJ_MATRIX) { nodes[counter] = 1; columns[counter] = col; }
+                            else { nodes[counter] = col; }
+                            ++counter;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Graph::generateStructured(IndicesIJK size, int stencil) {
+
+    const int32_t ni = size.i;
+    const int32_t nj = size.j;
+    const int32_t nk = size.k;
+    const int diag = (g_type == ADJ_MATRIX) ? 1 : 0;
+
+    num_rows = ni * nj * nk;
+    num_cols = num_rows;
+    offsets.resize(num_rows + 1);
+    offsets[0] = 0;
+
+    /* Number of neighbors of each cell follows from the number of its neighbors in each direction */
+#pragma omp parallel for schedule(static)
+    for (int32_t i = 0; i < ni; ++i) {
+        int ci = (i > 0) + (i < ni - 1);
+        for (int32_t j = 0; j < nj; ++j) {
+            int cj = (j > 0) + (j < nj - 1);
+            for (int32_t k = 0; k < nk; ++k) {
+                int ck = (k > 0) + (k < nk - 1);
+                int degree = (stencil == 7) ? ci + cj + ck : (ci + 1) * (cj + 1) * (ck + 1) - 1;
+                offsets[k + nk * (j + nj * i) + 1] = degree + diag;
+            }
+        }
+    }
+
+    for (int32_t row = 0; row < num_rows; ++row) {
+        offsets[row + 1] += offsets[row];
+    }
+
+    nodes.resize(offsets[num_rows]);
+    if (g_type == ADJ_MATRIX) {
+        columns.resize(offsets[num_rows]);
+        fillStructured<ADJ_MATRIX>(size, stencil);
+    }
+    else {
+        columns.clear();
+        fillStructured<ADJ_LIST>(size, stencil);
+    }
+}
+
 void Graph::print() {
 
     if (nodes.empty()) {
@@ -165,4 +343,36 @@ void Graph::print() {
         }
         std::cout << "\n";
     }
-}
\ No newline at end of file
+}
+
+void Graph::extractSubgraph(const std::vector<int32_t>& vertices, Graph& sub) {
+
+    std::vector<int32_t> local(num_rows, EMPTY);
+    int32_t num_vertices = vertices.size();
+    bool has_weights = !edge_weights.empty();
+
+    for (int32_t n = 0; n < num_vertices; ++n)
+        local[vertices[n]] = n;
+
+    sub.g_type = ADJ_LIST;
+    sub.num_rows = sub.num_cols = num_vertices;
+    sub.num_constraints = 0;
+    sub.nodes.clear();
+    sub.columns.clear();
+    sub.vertex_weights.clear();
+    sub.vertex_sizes.clear();
+    sub.edge_weights.clear();
+    sub.offsets.assign(num_vertices + 1, 0);
+
+    for (int32_t n = 0; n < num_vertices; ++n) {
+        int32_t row = vertices[n];
+        for (int32_t ckey = offsets[row]; ckey < offsets[row + 1]; ++ckey) {
+            if (local[nodes[ckey]] == EMPTY)
+                continue;
+            sub.nodes.push_back(local[nodes[ckey]]);
+            if (has_weights)
+                sub.edge_weights.push_back(edge_weights[ckey]);
+        }
+        sub.offsets[n + 1] = sub.nodes.size();
+    }
+}
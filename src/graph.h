@@ -26,15 +26,24 @@
 #include <vector>
 
 #include "General/structs.h"
+#include "General/alignedAllocator.h"
+
+/*!
+ * @brief Array of the graph, pages are placed by the threads filling it in (see \e AlignedAllocator).
+ */
+typedef std::vector<int32_t, AlignedAllocator<int32_t> > GraphArray;
 
 /*!
  * @brief Represents graph in a form of adjacency matrix.
  * This class uses CSR format to store the graph.
  */
 class Graph {
+    /* Reader of graph files fills in the CSR arrays directly */
+    friend class GraphReader;
+
 public:
 
-    Graph(int8_t type) {
+    Graph(int8_t type) : num_rows(0), num_cols(0), num_constraints(0) {
 
         g_type = type;
     }
@@ -44,12 +53,41 @@ public:
         nodes.clear();
         columns.clear();
         offsets.clear();
+        vertex_weights.clear();
+        vertex_sizes.clear();
+        edge_weights.clear();
     }
 
     void generateStructured(IndicesIJ size);
 
+    /*!
+     * @brief Generate graph of a structured grid (5-point stencil) using multiple threads.
+     * The result is identical to \e generateStructured(), but offsets of each row are computed
+     * in closed form, so all rows are filled independently.
+     * @param size Number of cells in each direction
+     */
+    void generateStructuredParallel(IndicesIJ size);
+
+    /*!
+     * @brief Generate graph of a 3D structured grid using multiple threads.
+     * Cells are enumerated as k + size.k * (j + size.j * i), columns of each row are sorted
+     * in ascending order. For a single layer in k-th direction and the 7-point stencil the
+     * result is identical to the one of \e generateStructured(IndicesIJ).
+     * @param size Number of cells in each direction
+     * @param stencil Number of points in the stencil: 7 (faces) or 27 (faces, edges and corners)
+     */
+    void generateStructured(IndicesIJK size, int stencil);
+
     void print();
 
+    /*!
+     * @brief Extract the subgraph induced by the vertices of an adjacency list, i.e. the edges
+     * leaving the vertices are dropped. Weights of edges are kept, weights of vertices are not.
+     * @param vertices Vertices of the subgraph, their order defines the IDs in the subgraph.
+     * @param sub [out] Subgraph stored as an adjacency list.
+     */
+    void extractSubgraph(const std::vector<int32_t>& vertices, Graph& sub);
+
     inline int32_t getRows() {
         return num_rows;
     }
@@ -58,25 +96,82 @@ public:
         return num_cols;
     }
 
-    inline std::vector<int32_t>& getNodes() {
+    inline GraphArray& getNodes() {
         return nodes;
     }
 
-    inline std::vector<int32_t>& getColumns() {
+    inline GraphArray& getColumns() {
         return columns;
     }
 
-    inline std::vector<int32_t>& getOffsets() {
+    inline GraphArray& getOffsets() {
         return offsets;
     }
 
+    /*!
+     * @brief Get number of weights per vertex (0 if the graph has no vertex weights).
+     */
+    inline int32_t getNumConstraints() {
+        return num_constraints;
+    }
+
+    /*!
+     * @brief Get weights of vertices, \e getNumConstraints() consecutive values per vertex.
+     */
+    inline GraphArray& getVertexWeights() {
+        return vertex_weights;
+    }
+
+    /*!
+     * @brief Get sizes of vertices, i.e. the amount of data to be communicated for each vertex.
+     */
+    inline GraphArray& getVertexSizes() {
+        return vertex_sizes;
+    }
+
+    /*!
+     * @brief Get weights of edges, the layout matches \e getNodes().
+     */
+    inline GraphArray& getEdgeWeights() {
+        return edge_weights;
+    }
+
+private:
+    /*!
+     * @brief Get offset of the row (i,j) of a structured grid in closed form.
+     * @tparam TYPE Storage type, diagonal entries are stored for \e ADJ_MATRIX only
+     * @param size Number of cells in each direction
+     * @param i i-th index of the cell
+     * @param j j-th index of the cell
+     */
+    template <StorageType TYPE>
+    int64_t getStructuredOffset(IndicesIJ size, int64_t i, int64_t j);
+
+    /*!
+     * @brief Fill in the rows of a structured grid, see \e generateStructuredParallel().
+     * @tparam TYPE Storage type, resolved at compile time to keep the loop free of branches on it
+     */
+    template <StorageType TYPE>
+    void fillStructured(IndicesIJ size);
+
+    /*!
+     * @brief Fill in the rows of a 3D structured grid, see \e generateStructured(IndicesIJK, int).
+     * Offsets are expected to be computed already.
+     */
+    template <StorageType TYPE>
+    void fillStructured(IndicesIJK size, int stencil);
+
 private:
     int8_t g_type;                  // Storage type: adjacency matrix or list
     int32_t num_rows;               // Number of rows in the graph
     int32_t num_cols;               // Number of columns in the graph
-    std::vector<int32_t> nodes;     // Nodes value
-    std::vector<int32_t> columns;   // Column indices
-    std::vector<int32_t> offsets;   // Index offsets for rows
+    GraphArray nodes;               // Nodes value
+    GraphArray columns;             // Column indices
+    GraphArray offsets;             // Index offsets for rows
+    int32_t num_constraints;                // Number of weights per vertex (optional)
+    GraphArray vertex_weights;              // Weights of vertices (optional)
+    GraphArray vertex_sizes;                // Sizes of vertices (optional)
+    GraphArray edge_weights;                // Weights of edges (optional)
 };
 
 #endif //UNBALANCED_WORKLOAD_GRAPH_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "graphReader.h"
+
+int GraphReader::open(const std::string &file_name) {
+
+    struct stat file_stat;
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        std::cerr << "Error! Can't open the graph file " << file_name << "..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        std::cerr << "Error! The graph file " << file_name << " is empty..." << std::endl;
+        ::close(fd);
+        return EXIT_FAILURE;
+    }
+
+    file_size = file_stat.st_size;
+    void *ptr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (ptr == MAP_FAILED) {
+        std::cerr << "Error! Can't map the graph file " << file_name << " into memory..." << std::endl;
+        file_size = 0;
+        return EXIT_FAILURE;
+    }
+
+    /* The whole file will be read by multiple threads, ask the kernel to prefetch it */
+    madvise(ptr, file_size, MADV_WILLNEED);
+
+    data = static_cast<const char*>(ptr);
+    end = data + file_size;
+
+    return EXIT_SUCCESS;
+}
+
+void GraphReader::close() {
+
+    if (data != NULL) {
+        munmap(const_cast<char*>(data), file_size);
+    }
+    data = end = NULL;
+    file_size = 0;
+}
+
+int GraphReader::parseHeader(const char* &pos) {
+
+    int64_t fmt = 0;
+    int64_t value = 0;
+
+    while (isComment(pos)) {
+        pos = nextLine(pos);
+    }
+
+    if (!parseInt(pos, num_vertices) || !parseInt(pos, num_edges)) {
+        std::cerr << "Error! The header of the graph file is incorrect..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    /* Format is a 3-digit flag, where leading zeros might be omitted */
+    parseInt(pos, fmt);
+    has_sizes = (fmt / 100) % 10;
+    has_vweights = (fmt / 10) % 10;
+    has_eweights = fmt % 10;
+
+    ncon = 0;
+    if (has_vweights) {
+        ncon = parseInt(pos, value) ? value : 1;
+    }
+
+    if (num_vertices <= 0 || num_vertices > INT32_MAX || 2 * num_edges > INT32_MAX || ncon < 0) {
+        std::cerr << "Error! The graph size is not supported: " << num_vertices << " vertices, "
+                  << num_edges << " edges..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    pos = nextLine(pos);
+    return EXIT_SUCCESS;
+}
+
+void GraphReader::splitIntoChunks(const char* body, int num_chunks, std::vector<const char*> &chunks) {
+
+    size_t length = end - body;
+
+    chunks.resize(num_chunks + 1);
+    chunks[0] = body;
+    for (int c = 1; c < num_chunks; ++c) {
+        const char* pos = body + length * c / num_chunks;
+        /* Move to the beginning of the next line, unless the position is at the beginning already */
+        if (pos[-1] != '\n')
+            pos = nextLine(pos);
+        chunks[c] = std::max(pos, chunks[c - 1]);
+    }
+    chunks[num_chunks] = end;
+}
+
+int GraphReader::read(const std::string &file_name, Graph &graph) {
+
+    const char* body = NULL;
+    std::vector<const char*> chunks;
+    std::vector<int64_t> first_vertex;
+    int num_chunks = 1;
+    int num_vertex_tokens;
+    int num_edge_tokens;
+    int error = 0;
+
+    if (graph.g_type != ADJ_LIST) {
+        std::cerr << "Error! Graph files can be read into adjacency lists only..." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (open(file_name) == EXIT_FAILURE)
+        return EXIT_FAILURE;
+
+    body = data;
+    if (parseHeader(body) == EXIT_FAILURE) {
+        close();
+        return EXIT_FAILURE;
+    }
+
+#ifdef _OPENMP
+    num_chunks = omp_get_max_threads();
+#endif
+    splitIntoChunks(body, num_chunks, chunks);
+    first_vertex.assign(num_chunks + 1, 0);
+
+    /* Pass 1: count vertex lines in each chunk to find the first vertex of each chunk */
+#pragma omp parallel for schedule(static, 1)
+    for (int c = 0; c < num_chunks; ++c) {
+        int64_t count = 0;
+        for (const char* line = chunks[c]; line < chunks[c + 1]; line = nextLine(line)) {
+            if (!isComment(line))
+                ++count;
+        }
+        first_vertex[c + 1] = count;
+    }
+    for (int c = 0; c < num_chunks; ++c) {
+        first_vertex[c + 1] += first_vertex[c];
+    }
+
+    if (first_vertex[num_chunks] < num_vertices) {
+        std::cerr << "Error! The graph file contains " << first_vertex[num_chunks] << " vertices instead of "
+                  << num_vertices << "..." << std::endl;
+        close();
+        return EXIT_FAILURE;
+    }
+
+    graph.num_rows = graph.num_cols = num_vertices;
+    graph.num_constraints = ncon;
+    graph.columns.clear();
+    graph.offsets.assign(num_vertices + 1, 0);
+    graph.vertex_sizes.resize(has_sizes ? num_vertices : 0);
+    graph.vertex_weights.resize((int64_t) ncon * num_vertices);
+
+    num_vertex_tokens = has_sizes + ncon;
+    num_edge_tokens = 1 + has_eweights;
+
+    /* Pass 2: count neighbors of each vertex */
+#pragma omp parallel for schedule(static, 1) reduction(max: error)
+    for (int c = 0; c < num_chunks; ++c) {
+        int64_t vertex = first_vertex[c];
+        for (const char* line = chunks[c]; line < chunks[c + 1] && vertex < num_vertices; line = nextLine(line)) {
+            const char* pos = line;
+            int64_t value;
+            int64_t num_tokens = 0;
+
+            if (isComment(line))
+                continue;
+
+            while (parseInt(pos, value))
+                ++num_tokens;
+
+            /* Anything but the end of the line means an unexpected character */
+            num_tokens -= num_vertex_tokens;
+            if ((pos < end && *pos != '\n') || num_tokens < 0 || num_tokens % num_edge_tokens) {
+                error = 1;
+                break;
+            }
+            graph.offsets[vertex + 1] = num_tokens / num_edge_tokens;
+            ++vertex;
+        }
+    }
+
+    if (error) {
+        std::cerr << "Error! The graph file has an incorrect vertex line..." << std::endl;
+        close();
+        return EXIT_FAILURE;
+    }
+
+    for (int64_t vertex = 0; vertex < num_vertices; ++vertex) {
+        graph.offsets[vertex + 1] += graph.offsets[vertex];
+    }
+    if (graph.offsets[num_vertices] != 2 * num_edges) {
+        std::cout << "Warning! The graph file declares " << num_edges << " edges, but "
+                  << graph.offsets[num_vertices] / 2. << " were found...\n";
+    }
+
+    graph.nodes.resize(graph.offsets[num_vertices]);
+    graph.edge_weights.resize(has_eweights ? graph.offsets[num_vertices] : 0);
+
+    /* Pass 3: fill in the vertices and edges */
+#pragma omp parallel for schedule(static, 1) reduction(max: error)
+    for (int c = 0; c < num_chunks; ++c) {
+        int64_t vertex = first_vertex[c];
+        for (const char* line = chunks[c]; line < chunks[c + 1] && vertex < num_vertices; line = nextLine(line)) {
+            const char* pos = line;
+            int64_t value = 0;
+
+            if (isComment(line))
+                continue;
+
+            if (has_sizes) {
+                parseInt(pos, value);
+                graph.vertex_sizes[vertex] = value;
+            }
+            for (int32_t con = 0; con < ncon; ++con) {
+                parseInt(pos, value);
+                graph.vertex_weights[vertex * ncon + con] = value;
+            }
+            for (int32_t ckey = graph.offsets[vertex]; ckey < graph.offsets[vertex + 1]; ++ckey) {
+                parseInt(pos, value);
+                if (value < 1 || value > num_vertices)
+                    error = 1;
+                /* Vertices are numbered from 1 in the file */
+                graph.nodes[ckey] = value - 1;
+                if (has_eweights) {
+                    parseInt(pos, value);
+                    graph.edge_weights[ckey] = value;
+                }
+            }
+            ++vertex;
+        }
+    }
+
+    close();
+
+    if (error) {
+        std::cerr << "Error! The graph file refers to a non-existing vertex..." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef UNBALANCED_WORKLOAD_GRAPHREADER_H
+#define UNBALANCED_WORKLOAD_GRAPHREADER_H
+
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+/*!
+ * \class GraphReader
+ * @brief Reads graphs stored in the METIS/Chaco format.
+ * The file is memory-mapped and split into chunks of lines which are parsed by multiple
+ * threads. The format is:
+ *   % comment
+ *   n m [fmt [ncon]]
+ *   [size] [w_1 ... w_ncon] v_1 [e_1] v_2 [e_2] ...     <- one line per vertex
+ * where \e fmt is a 3-digit flag (vertex sizes, vertex weights, edge weights) and vertices
+ * are numbered starting from 1.
+ */
+class GraphReader {
+public:
+    GraphReader() : data(NULL), end(NULL), file_size(0) { }
+    ~GraphReader() { close(); }
+
+    /*!
+     * @brief Read the graph from the file.
+     * @param file_name Name of the file
+     * @param graph [out] Graph in the \e ADJ_LIST format
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int read(const std::string &file_name, Graph &graph);
+
+private:
+    /*!
+     * @brief Map the file into memory.
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int open(const std::string &file_name);
+
+    /*!
+     * @brief Unmap the file.
+     */
+    void close();
+
+    /*!
+     * @brief Parse the header of the file.
+     * @param pos [in/out] Position in the file, points to the first vertex line on exit
+     * @return Returns EXIT_SUCCESS on success and EXIT_FAILURE on error.
+     */
+    int parseHeader(const char* &pos);
+
+    /*!
+     * @brief Split the lines following \e body into chunks, one per thread.
+     * Each chunk starts at the beginning of a line.
+     * @param body Beginning of the first vertex line
+     * @param num_chunks Number of chunks
+     * @param chunks [out] Beginnings of the chunks, followed by the end of the file
+     */
+    void splitIntoChunks(const char* body, int num_chunks, std::vector<const char*> &chunks);
+
+    /*!
+     * @brief Check if the line starting at \e pos is a comment.
+     */
+    inline bool isComment(const char* pos) {
+        return pos < end && *pos == '%';
+    }
+
+    /*!
+     * @brief Get the beginning of the next line.
+     */
+    inline const char* nextLine(const char* pos) {
+        while (pos < end && *pos != '\n')
+            ++pos;
+        return (pos < end) ? pos + 1 : end;
+    }
+
+    /*!
+     * @brief Parse the next non-negative integer on the current line.
+     * @param pos [in/out] Position in the file, points after the number on exit
+     * @param value [out] Parsed value
+     * @return False if the end of the line is reached before any digit.
+     */
+    inline bool parseInt(const char* &pos, int64_t &value) {
+        while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+            ++pos;
+        if (pos >= end || *pos < '0' || *pos > '9')
+            return false;
+        value = 0;
+        while (pos < end && *pos >= '0' && *pos <= '9') {
+            value = 10 * value + (*pos - '0');
+            ++pos;
+        }
+        return true;
+    }
+
+private:
+    const char* data;           // Mapped file
+    const char* end;            // End of the mapped file
+    size_t file_size;           // Size of the file in bytes
+    int64_t num_vertices;       // Number of vertices declared in the header
+    int64_t num_edges;          // Number of (undirected) edges declared in the header
+    bool has_sizes;             // Vertex sizes are present
+    bool has_vweights;          // Vertex weights are present
+    bool has_eweights;          // Edge weights are present
+    int32_t ncon;               // Number of weights per vertex
+};
+
+#endif //UNBALANCED_WORKLOAD_GRAPHREADER_H
@@ -61,53 +61,312 @@ double Helpers::toc() {
 void Helpers::terminateDueToParserFailure() {
     printByRoot("\nError! Incorrect arguments were passed to the command line.\n"
                 "Use the following keys:\n"
-                "  -s - set number of the grid cells in each direction (i j)\n"
-                "  -d - set decomposition for each direction (i j)\n"
+                "  -s - set number of the grid cells in each direction (i j [k]), or\n"
+                "  -g - read the graph from a METIS/Chaco file (graph decompositions only)\n"
+                "  -d - set decomposition for each direction (i j [k]), or\n"
+                "       'pencil'/'block' to find it automatically, or\n"
+                "       'auto' to minimize the halo size, or\n"
+                "       'auto-load' to minimize the maximum load\n"
                 "       (doesn’t affect the METIS decomposition, but should be\n"
                 "        set anyway!)\n"
-                "  -t - set decomposition type ('m' for METIS, 's' for STRUCTURED)\n"
+                "  -t - set decomposition type ('m' for METIS, 's' for STRUCTURED,\n"
+                "       'n' for the built-in multilevel graph partitioner,\n"
+                "       'a' to select the best one and its options automatically)\n"
+                "Optional keys:\n"
+                "  -p - set the stencil of the graph: 7 (5 in 2D) or 27 (9 in 2D)\n"
+                "  -c - set number of METIS balancing constraints: 1 (compute) or\n"
+                "       2 (compute and memory)\n"
+                "  -u - set allowed imbalance of each constraint (e.g. 1.05,1.2)\n"
+                "  -T - set desired fraction of the load of each partition\n"
+                "       (e.g. 0.5,0.25,0.25)\n"
+                "  -a - set the weight of the communication volume in the cost\n"
+                "       model of the autotuner (default 1)\n"
+                "  -n - set number of time steps, each one overlaps the halo exchange\n"
+                "       with the work on interior cells\n"
+                "  -r - set number of drift steps: the weights drift slightly at each\n"
+                "       one and the graph decomposition is refined incrementally\n"
+                "  -k - set number of chunks of each process: the graph decomposition\n"
+                "       is split into chunks, which migrate between processes during\n"
+                "       the time steps according to their measured cost\n"
+                "  -v - set number of variables in each cell and optionally their\n"
+                "       layout: 'soa' (default) or 'aosoa'\n"
+                "  -w - set precision of the field values in messages: 'double'\n"
+                "       (default), 'float' or 'bf16' (computations stay in double)\n"
+                "  -m - set backing of large arrays: 'default', 'thp' (transparent\n"
+                "       huge pages) or 'huge' (reserved huge pages), and report\n"
+                "       the placement of pages on NUMA nodes\n"
+                "  --dry-run - predict the time step of the decomposition for the\n"
+                "       given number of processes without running it\n"
+                "  --nodes - partition the graph into the nodes first and into the\n"
+                "       ranks of each node second; optionally set the number of\n"
+                "       ranks per node to emulate nodes of consecutive ranks\n"
+                "  -b - run a benchmark instead of the regular workflow:\n"
+                "       'pgraph' - assembly of the graph of processes\n"
+                "       'gen'    - generation of the structured graph\n"
+                "       'sum'    - reproducible summation of doubles\n"
+                "       'comm'   - latency and bandwidth of the neighbors on\n"
+                "                  MPI_COMM_WORLD and the topologies (all processes)\n"
                 "Example:\n"
-                "  ./a.out -s 10 10 -d 1 1 -t m");
+                "  ./a.out -s 10 10 -d 1 1 -t m\n"
+                "  ./a.out -s 10 10 10 -d block -t s -p 27\n"
+                "  ./a.out -g mesh.graph -d 1 1 -t m\n"
+                "  ./a.out -s 1000 1000 -d 1 1 -t n -u 1.05\n"
+                "  ./a.out -s 200 200 -d 1 1 -t m -k 8 -n 20\n"
+                "  ./a.out -s 1000 1000 -d block -t s --dry-run 4096\n"
+                "  ./a.out -s 200 200 -d 1 1 -t m --nodes 4");
     terminateExecution();
 }
 
-void Helpers::parseInput(int argc, char** argv, IndicesIJ &elts_glob, IndicesIJ &num_procs, int8_t &type) {
+void Helpers::checkNumValues(int argc, int pos, int num_values) {
+
+    if (pos + num_values >= argc)
+        terminateDueToParserFailure();
+}
+
+bool Helpers::isNumber(const char* str) {
+
+    if (*str == '\0')
+        return false;
+    for (; *str != '\0'; ++str) {
+        if (*str < '0' || *str > '9')
+            return false;
+    }
+    return true;
+}
+
+void Helpers::parseList(const char* str, std::vector<float> &values) {
+
+    char* pos = const_cast<char*>(str);
+
+    values.clear();
+    while (*pos != '\0') {
+        char* next;
+        values.push_back(strtof(pos, &next));
+        if (next == pos || (*next != ',' && *next != '\0'))
+            terminateDueToParserFailure();
+        pos = (*next == ',') ? next + 1 : next;
+    }
+}
+
+int Helpers::parseIndices(int argc, char** argv, int pos, IndicesIJK &indices) {
+
+    checkNumValues(argc, pos, 2);
+    if (!isNumber(argv[pos + 1]) || !isNumber(argv[pos + 2]))
+        terminateDueToParserFailure();
+
+    indices.i = atoi(argv[pos + 1]);
+    indices.j = atoi(argv[pos + 2]);
+    indices.k = 1;
+
+    if (pos + 3 < argc && isNumber(argv[pos + 3])) {
+        indices.k = atoi(argv[pos + 3]);
+        return 3;
+    }
+    return 2;
+}
+
+void Helpers::parseInput(int argc, char** argv, IndicesIJK &elts_glob, IndicesIJK &num_procs, int8_t &type) {
 
     /* Assign the default values first. */
     elts_glob.i = elts_glob.j = 10;
-    num_procs.i = num_procs.j = 1;
+    elts_glob.k = 1;
+    num_procs.i = num_procs.j = num_procs.k = 1;
     type = STRUCTURED;
+    benchmark.clear();
+    graph_file.clear();
+    stencil = 7;
+    layout = LAYOUT_MANUAL;
+    num_constraints = 1;
+    tolerances.clear();
+    target_weights.clear();
+    cost_factor = 1.;
+    num_steps = 0;
+    num_drifts = 0;
+    num_chunks = 1;
+    num_components = 1;
+    field_layout = FIELD_SOA;
+    wire_precision = WIRE_DOUBLE;
+    dry_run_procs = 0;
+    node_aware = false;
+    ranks_per_node = 0;
+    page_policy = PAGES_DEFAULT;
+    report_pages = false;
 
     elts_glob.i = 3;
     elts_glob.j = 5;
 
-    if (argc > 1 && argc != 9) {
-        terminateDueToParserFailure();
-    }
-    else if (argc == 9) {
+    if (argc > 1) {
         int found_keys = 0;
 
         for (int pos = 1; pos < argc; ++pos) {
             if (std::string(argv[pos]) == "-s") {
-                elts_glob.i = atoi(argv[pos + 1]);
-                elts_glob.j = atoi(argv[pos + 2]);
+                pos += parseIndices(argc, argv, pos, elts_glob);
+                ++found_keys;
+            }
+            else if (std::string(argv[pos]) == "-g") {
+                /* The graph replaces the grid, thus the key counts instead of -s */
+                checkNumValues(argc, pos, 1);
+                graph_file = argv[pos + 1];
                 ++found_keys;
-                pos += 2;
+                ++pos;
             }
             else if (std::string(argv[pos]) == "-d") {
-                num_procs.i = atoi(argv[pos + 1]);
-                num_procs.j = atoi(argv[pos + 2]);
+                checkNumValues(argc, pos, 1);
+                if (std::string(argv[pos + 1]) == "pencil") {
+                    layout = LAYOUT_PENCIL;
+                    ++pos;
+                }
+                else if (std::string(argv[pos + 1]) == "block") {
+                    layout = LAYOUT_BLOCK;
+                    ++pos;
+                }
+                else if (std::string(argv[pos + 1]) == "auto") {
+                    layout = LAYOUT_AUTO;
+                    ++pos;
+                }
+                else if (std::string(argv[pos + 1]) == "auto-load") {
+                    layout = LAYOUT_AUTO_LOAD;
+                    ++pos;
+                }
+                else {
+                    pos += parseIndices(argc, argv, pos, num_procs);
+                }
                 ++found_keys;
-                pos += 2;
             }
             else if (std::string(argv[pos]) == "-t") {
+                checkNumValues(argc, pos, 1);
                 if (std::string(argv[pos + 1]) == "m")
                     type = METIS;
                 else if (std::string(argv[pos + 1]) == "s")
                     type = STRUCTURED;
+                else if (std::string(argv[pos + 1]) == "a")
+                    type = AUTOTUNE;
+                else if (std::string(argv[pos + 1]) == "n")
+                    type = NATIVE;
                 ++found_keys;
                 ++pos;
             }
+            else if (std::string(argv[pos]) == "-p") {
+                checkNumValues(argc, pos, 1);
+                stencil = atoi(argv[pos + 1]);
+                /* 5- and 9-point stencils are 2D versions of 7- and 27-point ones */
+                if (stencil == 5)
+                    stencil = 7;
+                else if (stencil == 9)
+                    stencil = 27;
+                if (stencil != 7 && stencil != 27)
+                    terminateDueToParserFailure();
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-c") {
+                checkNumValues(argc, pos, 1);
+                num_constraints = atoi(argv[pos + 1]);
+                if (num_constraints != 1 && num_constraints != 2)
+                    terminateDueToParserFailure();
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-u") {
+                checkNumValues(argc, pos, 1);
+                parseList(argv[pos + 1], tolerances);
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-T") {
+                checkNumValues(argc, pos, 1);
+                parseList(argv[pos + 1], target_weights);
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-a") {
+                checkNumValues(argc, pos, 1);
+                cost_factor = atof(argv[pos + 1]);
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-n") {
+                checkNumValues(argc, pos, 1);
+                num_steps = atoi(argv[pos + 1]);
+                if (num_steps < 0)
+                    terminateDueToParserFailure();
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-r") {
+                checkNumValues(argc, pos, 1);
+                if (!isNumber(argv[pos + 1]))
+                    terminateDueToParserFailure();
+                num_drifts = atoi(argv[pos + 1]);
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-k") {
+                checkNumValues(argc, pos, 1);
+                if (!isNumber(argv[pos + 1]) || atoi(argv[pos + 1]) < 1)
+                    terminateDueToParserFailure();
+                num_chunks = atoi(argv[pos + 1]);
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-v") {
+                checkNumValues(argc, pos, 1);
+                num_components = atoi(argv[pos + 1]);
+                if (num_components < 1)
+                    terminateDueToParserFailure();
+                ++pos;
+                /* The layout is optional */
+                if (pos + 1 < argc && std::string(argv[pos + 1]) == "soa") {
+                    field_layout = FIELD_SOA;
+                    ++pos;
+                }
+                else if (pos + 1 < argc && std::string(argv[pos + 1]) == "aosoa") {
+                    field_layout = FIELD_AOSOA;
+                    ++pos;
+                }
+            }
+            else if (std::string(argv[pos]) == "--dry-run") {
+                checkNumValues(argc, pos, 1);
+                if (!isNumber(argv[pos + 1]) || atoi(argv[pos + 1]) < 1)
+                    terminateDueToParserFailure();
+                dry_run_procs = atoi(argv[pos + 1]);
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "--nodes") {
+                node_aware = true;
+                /* The number of ranks per node is optional */
+                if (pos + 1 < argc && isNumber(argv[pos + 1])) {
+                    ranks_per_node = atoi(argv[pos + 1]);
+                    if (ranks_per_node < 1)
+                        terminateDueToParserFailure();
+                    ++pos;
+                }
+            }
+            else if (std::string(argv[pos]) == "-w") {
+                checkNumValues(argc, pos, 1);
+                if (std::string(argv[pos + 1]) == "double")
+                    wire_precision = WIRE_DOUBLE;
+                else if (std::string(argv[pos + 1]) == "float")
+                    wire_precision = WIRE_FLOAT;
+                else if (std::string(argv[pos + 1]) == "bf16")
+                    wire_precision = WIRE_BF16;
+                else
+                    terminateDueToParserFailure();
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-m") {
+                checkNumValues(argc, pos, 1);
+                if (std::string(argv[pos + 1]) == "default")
+                    page_policy = PAGES_DEFAULT;
+                else if (std::string(argv[pos + 1]) == "thp")
+                    page_policy = PAGES_TRANSPARENT;
+                else if (std::string(argv[pos + 1]) == "huge")
+                    page_policy = PAGES_EXPLICIT;
+                else
+                    terminateDueToParserFailure();
+                report_pages = true;
+                ++pos;
+            }
+            else if (std::string(argv[pos]) == "-b") {
+                checkNumValues(argc, pos, 1);
+                benchmark = argv[pos + 1];
+                ++pos;
+            }
+            else {
+                terminateDueToParserFailure();
+            }
         }
 
         if (found_keys != 3)
@@ -23,6 +23,9 @@
 #ifndef UNBALANCED_WORKLOAD_HELPERS_H
 #define UNBALANCED_WORKLOAD_HELPERS_H
 
+#include <string>
+#include <vector>
+
 #include "General/structs.h"
 
 class Helpers {
@@ -47,14 +50,190 @@ public:
      * @param num_procs Number of local elements in each direction.
      * @param type Decomposition type.
      */
-    void parseInput(int argc, char** argv, IndicesIJ &elts_glob,
-                    IndicesIJ &num_procs, int8_t &type);
+    void parseInput(int argc, char** argv, IndicesIJK &elts_glob,
+                    IndicesIJK &num_procs, int8_t &type);
+
+    /*!
+     * @brief Get name of the graph file requested from CL (empty if the grid is generated).
+     */
+    inline const std::string& getGraphFile() {
+        return graph_file;
+    }
+
+    /*!
+     * @brief Get number of balancing constraints (compute, memory).
+     */
+    inline int getNumConstraints() {
+        return num_constraints;
+    }
+
+    /*!
+     * @brief Get allowed load imbalance of each constraint (empty for default).
+     */
+    inline std::vector<float>& getTolerances() {
+        return tolerances;
+    }
+
+    /*!
+     * @brief Get desired fractions of the load of each partition (empty for uniform).
+     */
+    inline std::vector<float>& getTargetWeights() {
+        return target_weights;
+    }
+
+    /*!
+     * @brief Get weight of the communication volume in the cost model of the autotuner.
+     */
+    inline double getCostFactor() {
+        return cost_factor;
+    }
+
+    /*!
+     * @brief Get number of time steps (0 performs the work once without the halo exchange).
+     */
+    inline int getNumSteps() {
+        return num_steps;
+    }
+
+    /*!
+     * @brief Get number of drift steps of the weights, each one followed by an incremental refinement.
+     */
+    inline int getNumDrifts() {
+        return num_drifts;
+    }
+
+    /*!
+     * @brief Get number of chunks of each process (1 without the over-decomposition).
+     */
+    inline int getNumChunks() {
+        return num_chunks;
+    }
+
+    /*!
+     * @brief Get number of variables stored in each cell.
+     */
+    inline int getNumComponents() {
+        return num_components;
+    }
+
+    /*!
+     * @brief Get storage layout of the variables.
+     */
+    inline FieldLayout getFieldLayout() {
+        return field_layout;
+    }
+
+    /*!
+     * @brief Get number of processes of the dry run (0 for a regular run).
+     */
+    inline int getDryRunProcs() {
+        return dry_run_procs;
+    }
+
+    /*!
+     * @brief Check if the graph decomposition is partitioned into the nodes first.
+     */
+    inline bool isNodeAware() {
+        return node_aware;
+    }
+
+    /*!
+     * @brief Get number of ranks of each emulated node (0 to discover the nodes).
+     */
+    inline int getRanksPerNode() {
+        return ranks_per_node;
+    }
+
+    /*!
+     * @brief Get precision of the field values sent by the distribution and the halo exchange.
+     */
+    inline WirePrecision getWirePrecision() {
+        return wire_precision;
+    }
+
+    /*!
+     * @brief Get backing of large arrays of fields and graphs.
+     */
+    inline PagePolicy getPagePolicy() {
+        return page_policy;
+    }
+
+    /*!
+     * @brief Check if the placement of pages on NUMA nodes should be reported.
+     */
+    inline bool getReportPages() {
+        return report_pages;
+    }
+
+    /*!
+     * @brief Get number of points in the stencil of the structured graph.
+     */
+    inline int getStencil() {
+        return stencil;
+    }
+
+    /*!
+     * @brief Get the layout of processes requested from CL (pencils, blocks or set manually).
+     */
+    inline ProcessLayout getProcessLayout() {
+        return layout;
+    }
+
+    /*!
+     * @brief Get name of the benchmark requested from CL (empty if none).
+     */
+    inline const std::string& getBenchmark() {
+        return benchmark;
+    }
 
 private:
     /*!
      * @brief Terminate execution due to the error in the input parameters.
      */
     void terminateDueToParserFailure();
+
+    /*!
+     * @brief Check that the key at position \e pos is followed by enough values.
+     */
+    void checkNumValues(int argc, int pos, int num_values);
+
+    /*!
+     * @brief Parse two or three indices following the key at position \e pos.
+     * A missing third index is set to 1, i.e. a single layer in k-th direction.
+     * @return Number of parsed values.
+     */
+    int parseIndices(int argc, char** argv, int pos, IndicesIJK &indices);
+
+    /*!
+     * @brief Check if the string is a non-negative integer number.
+     */
+    bool isNumber(const char* str);
+
+    /*!
+     * @brief Parse a comma separated list of numbers, e.g. "1.05,1.2".
+     */
+    void parseList(const char* str, std::vector<float> &values);
+
+private:
+    std::string benchmark;      // Name of the benchmark to run (optional)
+    std::string graph_file;     // Name of the graph file (optional)
+    int stencil;                // Number of points in the stencil (5/7 or 27)
+    int num_constraints;        // Number of balancing constraints
+    std::vector<float> tolerances;      // Allowed imbalance of each constraint
+    std::vector<float> target_weights;  // Desired fractions of the load of each partition
+    double cost_factor;         // Weight of the communication volume in the autotuner
+    int num_steps;              // Number of time steps
+    int num_drifts;             // Number of drift steps of the weights
+    int num_chunks;             // Number of chunks of each process
+    int num_components;         // Number of variables in each cell
+    FieldLayout field_layout;   // Storage layout of the variables
+    WirePrecision wire_precision;   // Precision of the sent field values
+    int dry_run_procs;          // Number of processes of the dry run (0 if disabled)
+    bool node_aware;            // Partition the graph into the nodes first
+    int ranks_per_node;         // Number of ranks of each emulated node (0 to discover the nodes)
+    PagePolicy page_policy;     // Backing of large arrays
+    bool report_pages;          // Report placement of pages on NUMA nodes
+    ProcessLayout layout;       // Layout of the structured decomposition
 };
 
 
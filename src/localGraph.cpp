@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "localGraph.h"
+
+void LocalGraph::extract(Graph& graph, const int32_t* partitioning, int pid,
+                         const std::vector<int32_t>& local_cells) {
+
+    int32_t *glob_offsets = graph.getOffsets().data();
+    int32_t *glob_nodes = graph.getNodes().data();
+
+    clear();
+    rank = pid;
+    cells = local_cells;
+
+    offsets.push_back(0);
+    for (int32_t row : cells) {
+        for (int32_t ckey = glob_offsets[row]; ckey < glob_offsets[row + 1]; ++ckey) {
+            int32_t col = glob_nodes[ckey];
+            nodes.push_back(col);
+            if (partitioning[col] != rank)
+                halo_cells.push_back(col);
+        }
+        offsets.push_back(nodes.size());
+    }
+
+    std::sort(halo_cells.begin(), halo_cells.end());
+    halo_cells.erase(std::unique(halo_cells.begin(), halo_cells.end()), halo_cells.end());
+    halo_owners.resize(halo_cells.size());
+    for (size_t n = 0; n < halo_cells.size(); ++n)
+        halo_owners[n] = partitioning[halo_cells[n]];
+}
+
+void LocalGraph::generate(const StructuredOwnership& ownership, int pid, int stencil) {
+
+    const IndicesIJK &size = ownership.getGlobalSize();
+    const int max_dist = (stencil == 7) ? 1 : 3;   // Manhattan distance to the farthest neighbor
+    IndicesIJK beg, end;
+
+    clear();
+    rank = pid;
+    ownership.getRange(pid, beg, end);
+
+    offsets.push_back(0);
+    for (int32_t i = beg.i; i < end.i; ++i) {
+        for (int32_t j = beg.j; j < end.j; ++j) {
+            for (int32_t k = beg.k; k < end.k; ++k) {
+                int32_t row = k + size.k * (j + size.j * i);
+                cells.push_back(row);
+
+                /* Same order as Graph::generateStructured(), i.e. ascending columns */
+                for (int di = -1; di <= 1; ++di) {
+                    if (i + di < 0 || i + di >= size.i)
+                        continue;
+                    for (int dj = -1; dj <= 1; ++dj) {
+                        if (j + dj < 0 || j + dj >= size.j)
+                            continue;
+                        for (int dk = -1; dk <= 1; ++dk) {
+                            int dist = std::abs(di) + std::abs(dj) + std::abs(dk);
+                            if (k + dk < 0 || k + dk >= size.k || dist > max_dist || dist == 0)
+                                continue;
+
+                            int32_t col = row + dk + size.k * (dj + size.j * di);
+                            nodes.push_back(col);
+                            if (i + di < beg.i || i + di >= end.i || j + dj < beg.j || j + dj >= end.j
+                                || k + dk < beg.k || k + dk >= end.k)
+                                halo_cells.push_back(col);
+                        }
+                    }
+                }
+                offsets.push_back(nodes.size());
+            }
+        }
+    }
+
+    std::sort(halo_cells.begin(), halo_cells.end());
+    halo_cells.erase(std::unique(halo_cells.begin(), halo_cells.end()), halo_cells.end());
+    halo_owners.resize(halo_cells.size());
+    for (size_t n = 0; n < halo_cells.size(); ++n)
+        halo_owners[n] = ownership.getOwner((int64_t) halo_cells[n]);
+}
+
+void LocalGraph::pack(std::vector<int32_t>& buffer) const {
+
+    /* Header: rank, number of rows and number of halo cells; the number of edges follows from the offsets */
+    buffer.clear();
+    buffer.reserve(3 + 2 * cells.size() + 1 + nodes.size() + 2 * halo_cells.size());
+    buffer.push_back(rank);
+    buffer.push_back(cells.size());
+    buffer.push_back(halo_cells.size());
+    buffer.insert(buffer.end(), cells.begin(), cells.end());
+    buffer.insert(buffer.end(), offsets.begin(), offsets.end());
+    buffer.insert(buffer.end(), nodes.begin(), nodes.end());
+    buffer.insert(buffer.end(), halo_cells.begin(), halo_cells.end());
+    buffer.insert(buffer.end(), halo_owners.begin(), halo_owners.end());
+}
+
+void LocalGraph::unpack(const std::vector<int32_t>& buffer) {
+
+    const int32_t *pos = buffer.data() + 3;
+    int32_t num_rows = buffer[1];
+    int32_t num_halo = buffer[2];
+
+    rank = buffer[0];
+    cells.assign(pos, pos + num_rows);
+    pos += num_rows;
+    offsets.assign(pos, pos + num_rows + 1);
+    pos += num_rows + 1;
+    nodes.assign(pos, pos + offsets[num_rows]);
+    pos += offsets[num_rows];
+    halo_cells.assign(pos, pos + num_halo);
+    pos += num_halo;
+    halo_owners.assign(pos, pos + num_halo);
+}
+
+void LocalGraph::clear() {
+
+    rank = EMPTY;
+    cells.clear();
+    offsets.clear();
+    nodes.clear();
+    halo_cells.clear();
+    halo_owners.clear();
+}
+
+int LocalGraph::getOwner(int32_t cell) const {
+
+    int32_t hid = getHaloID(cell);
+    return (hid == EMPTY) ? rank : halo_owners[hid];
+}
+
+int32_t LocalGraph::getLocalID(int32_t cell) const {
+
+    std::vector<int32_t>::const_iterator it = std::lower_bound(cells.begin(), cells.end(), cell);
+    return (it != cells.end() && *it == cell) ? (int32_t) (it - cells.begin()) : EMPTY;
+}
+
+int32_t LocalGraph::getHaloID(int32_t cell) const {
+
+    std::vector<int32_t>::const_iterator it = std::lower_bound(halo_cells.begin(), halo_cells.end(), cell);
+    return (it != halo_cells.end() && *it == cell) ? (int32_t) (it - halo_cells.begin()) : EMPTY;
+}
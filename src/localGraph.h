@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_LOCALGRAPH_H
+#define UNBALANCED_WORKLOAD_LOCALGRAPH_H
+
+#include <vector>
+
+#include "graph.h"
+#include "MPI/Decomposition/structuredOwnership.h"
+
+/*!
+ * @brief Part of the graph known by a single process.
+ * Rows of the cells owned by the process are stored in CSR format, in ascending order of the global
+ * IDs of the cells and with the global IDs of their neighbors. Neighbors owned by other processes
+ * (halo cells) are listed once, in ascending order of the global IDs, along with their owners. The
+ * size of the object grows with the number of local cells and their edges only, so neither the graph
+ * nor the partitioning of the whole domain is needed by the process.
+ */
+class LocalGraph {
+public:
+    LocalGraph() : rank(EMPTY) { }
+
+    ~LocalGraph() {
+
+        clear();
+    }
+
+    /*!
+     * @brief Extract the rows of the cells of a process from the graph of the whole domain.
+     * @param graph Graph of the whole domain
+     * @param partitioning Partitioning of the whole domain
+     * @param pid Process owning the cells
+     * @param local_cells Global IDs of the cells owned by the process in ascending order
+     */
+    void extract(Graph& graph, const int32_t* partitioning, int pid, const std::vector<int32_t>& local_cells);
+
+    /*!
+     * @brief Generate the rows of the cells of a structured subdomain in closed form.
+     * Cells are taken from the range of the subdomain and the owners of the halo cells from \e ownership,
+     * so neither the graph nor the partitioning of the whole domain is built. The rows are identical to
+     * the ones of \e Graph::generateStructured() (adjacency list).
+     * @param ownership Ownership of the cells
+     * @param pid Process owning the cells
+     * @param stencil Number of points in the stencil: 7 (faces) or 27 (faces, edges and corners)
+     */
+    void generate(const StructuredOwnership& ownership, int pid, int stencil);
+
+    /*!
+     * @brief Serialize the object into a single buffer, e.g. to send it to the process.
+     * @param buffer [out] Buffer of integers.
+     */
+    void pack(std::vector<int32_t>& buffer) const;
+
+    /*!
+     * @brief Restore the object from the buffer filled in by \e pack().
+     */
+    void unpack(const std::vector<int32_t>& buffer);
+
+    void clear();
+
+    /*!
+     * @brief Get the process owning the cell, the process of the local graph unless it is a halo cell.
+     * @param cell Global ID of a local or a halo cell.
+     */
+    int getOwner(int32_t cell) const;
+
+    /*!
+     * @brief Get position of the cell in \e getCells() or EMPTY if the cell is not local.
+     */
+    int32_t getLocalID(int32_t cell) const;
+
+    /*!
+     * @brief Get position of the cell in \e getHaloCells() or EMPTY if it is not a halo cell.
+     */
+    int32_t getHaloID(int32_t cell) const;
+
+    /*!
+     * @brief Get the process owning the local cells.
+     */
+    inline int getRank() const {
+        return rank;
+    }
+
+    inline int32_t getNumRows() const {
+        return cells.size();
+    }
+
+    /*!
+     * @brief Get global IDs of the local cells.
+     */
+    inline const std::vector<int32_t>& getCells() const {
+        return cells;
+    }
+
+    inline const std::vector<int32_t>& getOffsets() const {
+        return offsets;
+    }
+
+    /*!
+     * @brief Get global IDs of the neighbors of the local cells.
+     */
+    inline const std::vector<int32_t>& getNodes() const {
+        return nodes;
+    }
+
+    /*!
+     * @brief Get global IDs of the halo cells.
+     */
+    inline const std::vector<int32_t>& getHaloCells() const {
+        return halo_cells;
+    }
+
+    /*!
+     * @brief Get owners of the halo cells, the layout matches \e getHaloCells().
+     */
+    inline const std::vector<int32_t>& getHaloOwners() const {
+        return halo_owners;
+    }
+
+private:
+    int rank;                           // Process owning the local cells
+    std::vector<int32_t> cells;         // Global IDs of the local cells
+    std::vector<int32_t> offsets;       // Rows of the local cells (CSR)
+    std::vector<int32_t> nodes;
+    std::vector<int32_t> halo_cells;    // Global IDs of the neighbors owned by other processes
+    std::vector<int32_t> halo_owners;   // Owner of each halo cell
+};
+
+#endif //UNBALANCED_WORKLOAD_LOCALGRAPH_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <cstdlib>
+#include <cctype>
+#include <sched.h>
+#include <dirent.h>
+
+#include "pageLocality.h"
+
+int PageLocality::collect() {
+
+    std::ifstream in_str("/proc/self/numa_maps");
+    std::string line, token;
+    std::vector<double> node_kb;
+
+    if (!in_str.is_open())
+        return EXIT_FAILURE;
+
+    node = findCurrentNode();
+
+    /* Each line describes a mapping: "address policy [file=...] [anon=...] [huge] N0=pages ... kernelpagesize_kB=4" */
+    while (std::getline(in_str, line)) {
+        std::istringstream tokens(line);
+        std::vector<std::pair<int, double> > pages;
+        double page_kb = 4.;
+        bool huge = false;
+
+        if (line.find(" file=") != std::string::npos)
+            continue;
+
+        while (tokens >> token) {
+            if (token == "huge")
+                huge = true;
+            else if (token.compare(0, 18, "kernelpagesize_kB=") == 0)
+                page_kb = std::atof(token.c_str() + 18);
+            else if (token.size() > 2 && token[0] == 'N' && std::isdigit(token[1]) && token.find('=') != std::string::npos)
+                pages.push_back(std::make_pair(std::atoi(token.c_str() + 1),
+                                               std::atof(token.c_str() + token.find('=') + 1)));
+        }
+
+        for (size_t n = 0; n < pages.size(); ++n) {
+            if (pages[n].first >= (int) node_kb.size())
+                node_kb.resize(pages[n].first + 1, 0.);
+            node_kb[pages[n].first] += pages[n].second * page_kb;
+            if (huge)
+                hugetlb_kb += pages[n].second * page_kb;
+        }
+    }
+
+    total_kb = local_kb = 0.;
+    num_nodes = 0;
+    for (int n = 0; n < (int) node_kb.size(); ++n) {
+        total_kb += node_kb[n];
+        num_nodes += node_kb[n] > 0.;
+    }
+    local_kb = (node < (int) node_kb.size()) ? node_kb[node] : 0.;
+    thp_kb = readValue("/proc/self/smaps_rollup", "AnonHugePages");
+
+    return EXIT_SUCCESS;
+}
+
+void PageLocality::report() {
+
+    const int num_values = 6;
+    double values[num_values] = {(double) node, total_kb, local_kb, hugetlb_kb, thp_kb, (double) num_nodes};
+    std::vector<double> all_values(getMyRank() == 0 ? num_values * getNumProcs() : 0);
+
+    MPI_Gather(values, num_values, MPI_DOUBLE, all_values.data(), num_values, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    if (getMyRank() != 0)
+        return;
+
+    std::cout << "Page locality (anonymous memory):\n";
+    for (int rank = 0; rank < getNumProcs(); ++rank) {
+        double *v = &all_values[rank * num_values];
+        if (v[0] < 0) {
+            std::cout << "  rank " << rank << ": /proc/self/numa_maps is not available\n";
+            continue;
+        }
+        std::cout << "  rank " << rank << " (node " << (int) v[0] << "): " << std::fixed << std::setprecision(1)
+                  << v[1] / 1024. << " MB on " << (int) v[5] << " node(s), local "
+                  << ((v[1] > 0.) ? 100. * v[2] / v[1] : 100.) << "%, huge pages "
+                  << v[3] / 1024. << " MB (explicit) + " << v[4] / 1024. << " MB (transparent)\n";
+    }
+    std::cout << std::defaultfloat << std::setprecision(6) << std::flush;
+}
+
+int PageLocality::findCurrentNode() {
+
+    int cpu = sched_getcpu();
+    int current = 0;
+    std::string dir_name = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR *dir;
+    struct dirent *entry;
+
+    if (cpu < 0 || (dir = opendir(dir_name.c_str())) == NULL)
+        return current;
+
+    /* The directory of the CPU contains a link "nodeN" to its node */
+    while ((entry = readdir(dir)) != NULL) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 && std::isdigit(name[4])) {
+            current = std::atoi(name.c_str() + 4);
+            break;
+        }
+    }
+    closedir(dir);
+
+    return current;
+}
+
+double PageLocality::readValue(const std::string &file_name, const std::string &key) {
+
+    std::ifstream in_str(file_name);
+    std::string line;
+
+    while (std::getline(in_str, line)) {
+        if (line.compare(0, key.size() + 1, key + ":") == 0)
+            return std::atof(line.c_str() + key.size() + 1);
+    }
+    return 0.;
+}
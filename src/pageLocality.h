@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_PAGELOCALITY_H
+#define UNBALANCED_WORKLOAD_PAGELOCALITY_H
+
+#include <string>
+
+#include "common.h"
+
+/*!
+ * @brief Placement of the anonymous memory (heap, stack, mapped arrays) of the process on NUMA nodes.
+ * Resident pages of each mapping are read from /proc/self/numa_maps, file-backed mappings are
+ * skipped. Pages are local if they reside on the node of the CPU running the calling thread.
+ */
+class PageLocality {
+public:
+    PageLocality() : node(-1), total_kb(0.), local_kb(0.), hugetlb_kb(0.), thp_kb(0.), num_nodes(0) { }
+
+    ~PageLocality() { }
+
+    /*!
+     * @brief Read the statistics of the calling process.
+     * @return EXIT_SUCCESS if /proc/self/numa_maps is available, EXIT_FAILURE otherwise.
+     */
+    int collect();
+
+    /*!
+     * @brief Gather the statistics of all processes and print them on the root process.
+     */
+    void report();
+
+private:
+    /*!
+     * @brief Find the NUMA node of the CPU running the calling thread.
+     * @return ID of the node, 0 if the system does not expose it.
+     */
+    static int findCurrentNode();
+
+    /*!
+     * @brief Get the value of the "key: value" line of the file, e.g. from /proc/self/smaps_rollup.
+     */
+    static double readValue(const std::string &file_name, const std::string &key);
+
+private:
+    int node;               // Node of the process
+    double total_kb;        // Resident anonymous memory
+    double local_kb;        // Part of it on the node of the process
+    double hugetlb_kb;      // Explicit huge pages
+    double thp_kb;          // Transparent huge pages
+    int num_nodes;          // Number of nodes holding the pages
+};
+
+#endif //UNBALANCED_WORKLOAD_PAGELOCALITY_H
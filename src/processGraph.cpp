@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "processGraph.h"
+
+void ProcessGraph::clear() {
+
+    num_procs = 0;
+    offsets.clear();
+    ranks.clear();
+    weights.clear();
+    cells.clear();
+}
+
+void ProcessGraph::collectCutEdges(Graph& graph, const int32_t* part, std::vector<int32_t> &cut_offsets,
+                                   std::vector<int32_t> &cut_ngbs, std::vector<char> &cut_firsts) {
+
+    int32_t num_rows = graph.getRows();
+    int32_t *g_offsets = graph.getOffsets().data();
+    int32_t *g_nodes = graph.getNodes().data();
+    int num_threads = 1;
+
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+
+    std::vector<std::vector<int32_t> > loc_src(num_threads);
+    std::vector<std::vector<int32_t> > loc_dst(num_threads);
+    std::vector<std::vector<char> > loc_first(num_threads);
+    std::vector<int32_t> counts((int64_t) num_threads * num_procs, 0);
+
+    cut_offsets.assign(num_procs + 1, 0);
+
+#pragma omp parallel num_threads(num_threads)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        std::vector<int32_t> &src = loc_src[tid];
+        std::vector<int32_t> &dst = loc_dst[tid];
+        std::vector<char> &first = loc_first[tid];
+        int32_t *loc_counts = counts.data() + (int64_t) tid * num_procs;
+
+        /* The only pass over all edges: keep the cut ones */
+#pragma omp for schedule(static)
+        for (int32_t row = 0; row < num_rows; ++row) {
+            int32_t current_rank = part[row];
+            size_t row_start = dst.size();
+            for (int32_t ckey = g_offsets[row]; ckey < g_offsets[row + 1]; ++ckey) {
+                int32_t ngb_rank = part[g_nodes[ckey]];
+                if (ngb_rank != current_rank) {
+                    /* The cell is sent once to each process, however many edges lead there */
+                    char is_first = std::find(dst.begin() + row_start, dst.end(), ngb_rank) == dst.end();
+                    src.push_back(current_rank);
+                    dst.push_back(ngb_rank);
+                    first.push_back(is_first);
+                    ++loc_counts[current_rank];
+                }
+            }
+        }
+
+        /* Turn the counters into the starting positions: process-major, thread-minor */
+#pragma omp single
+        {
+            int32_t pos = 0;
+            for (int32_t pid = 0; pid < num_procs; ++pid) {
+                cut_offsets[pid] = pos;
+                for (int t = 0; t < num_threads; ++t) {
+                    int32_t cnt = counts[(int64_t) t * num_procs + pid];
+                    counts[(int64_t) t * num_procs + pid] = pos;
+                    pos += cnt;
+                }
+            }
+            cut_offsets[num_procs] = pos;
+            cut_ngbs.resize(pos);
+            cut_firsts.resize(pos);
+        }
+
+        /* Group the cut edges by their owners */
+        for (size_t n = 0; n < src.size(); ++n) {
+            cut_firsts[loc_counts[src[n]]] = first[n];
+            cut_ngbs[loc_counts[src[n]]++] = dst[n];
+        }
+    }
+}
+
+void ProcessGraph::build(Graph& graph, const int32_t* part, int32_t num_parts) {
+
+    std::vector<int32_t> cut_offsets;
+    std::vector<int32_t> cut_ngbs;
+    std::vector<char> cut_firsts;
+
+    clear();
+    num_procs = num_parts;
+    offsets.assign(num_procs + 1, 0);
+
+    collectCutEdges(graph, part, cut_offsets, cut_ngbs, cut_firsts);
+
+    /* First pass: count distinct neighbors of each process. The marker stores the last process that
+     * has seen the neighbor, so it never has to be reset. */
+#pragma omp parallel
+    {
+        std::vector<int32_t> marker(num_procs, EMPTY);
+
+#pragma omp for schedule(dynamic, 16)
+        for (int32_t pid = 0; pid < num_procs; ++pid) {
+            int32_t degree = 0;
+            for (int32_t n = cut_offsets[pid]; n < cut_offsets[pid + 1]; ++n) {
+                int32_t ngb_rank = cut_ngbs[n];
+                if (marker[ngb_rank] != pid) {
+                    marker[ngb_rank] = pid;
+                    ++degree;
+                }
+            }
+            offsets[pid + 1] = degree;
+        }
+    }
+
+    for (int32_t pid = 0; pid < num_procs; ++pid) {
+        offsets[pid + 1] += offsets[pid];
+    }
+    ranks.resize(offsets[num_procs]);
+    weights.resize(offsets[num_procs]);
+    cells.resize(offsets[num_procs]);
+
+    /* Second pass: fill in the neighbors and count the shared faces and the sent cells */
+#pragma omp parallel
+    {
+        std::vector<int32_t> faces(num_procs, 0);
+        std::vector<int32_t> sent(num_procs, 0);
+
+#pragma omp for schedule(dynamic, 16)
+        for (int32_t pid = 0; pid < num_procs; ++pid) {
+            int32_t pos = offsets[pid];
+            for (int32_t n = cut_offsets[pid]; n < cut_offsets[pid + 1]; ++n) {
+                int32_t ngb_rank = cut_ngbs[n];
+                if (faces[ngb_rank]++ == 0) {
+                    ranks[pos++] = ngb_rank;
+                }
+                sent[ngb_rank] += cut_firsts[n];
+            }
+
+            std::sort(ranks.begin() + offsets[pid], ranks.begin() + offsets[pid + 1]);
+            for (int32_t ckey = offsets[pid]; ckey < offsets[pid + 1]; ++ckey) {
+                weights[ckey] = faces[ranks[ckey]];
+                cells[ckey] = sent[ranks[ckey]];
+                faces[ranks[ckey]] = 0;
+                sent[ranks[ckey]] = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_PROCESSGRAPH_H
+#define UNBALANCED_WORKLOAD_PROCESSGRAPH_H
+
+#include <vector>
+
+#include "graph.h"
+
+/*!
+ * @brief Represents connectivity between processes.
+ * This class uses CSR format to store the graph: row \e pid lists the neighboring processes of
+ * \e pid in ascending order together with the number of faces shared with each of them and the
+ * number of cells \e pid sends to each of them, i.e. its cells with at least one edge to the neighbor.
+ */
+class ProcessGraph {
+public:
+    ProcessGraph() : num_procs(0) { }
+
+    ~ProcessGraph() {
+
+        clear();
+    }
+
+    /*!
+     * @brief Build the graph of processes from the partitioned graph of cells.
+     * The cut edges are collected in a single parallel sweep over the cells. The graph is then
+     * assembled from them in two passes (count, then fill), each parallelized over the processes.
+     * Duplicates are removed with per-thread marker arrays, so no per-process containers are
+     * allocated.
+     * @param graph Graph of cells
+     * @param part Partitioning of the cells
+     * @param num_parts Number of processes
+     */
+    void build(Graph& graph, const int32_t* part, int32_t num_parts);
+
+    void clear();
+
+    inline int32_t getNumProcs() {
+        return num_procs;
+    }
+
+    inline int32_t getNumNeighbors(int32_t pid) {
+        return offsets[pid + 1] - offsets[pid];
+    }
+
+    /*!
+     * @brief Get raw pointer to the neighbors of the process.
+     */
+    inline int32_t* getNeighbors(int32_t pid) {
+        return ranks.data() + offsets[pid];
+    }
+
+    /*!
+     * @brief Get raw pointer to the number of faces shared with each neighbor of the process.
+     */
+    inline int32_t* getWeights(int32_t pid) {
+        return weights.data() + offsets[pid];
+    }
+
+    /*!
+     * @brief Get raw pointer to the number of cells sent to each neighbor of the process.
+     */
+    inline int32_t* getCells(int32_t pid) {
+        return cells.data() + offsets[pid];
+    }
+
+    inline std::vector<int32_t>& getOffsets() {
+        return offsets;
+    }
+
+    inline std::vector<int32_t>& getRanks() {
+        return ranks;
+    }
+
+    inline std::vector<int32_t>& getWeights() {
+        return weights;
+    }
+
+private:
+    /*!
+     * @brief Collect the cut edges and group them by the owners of their first vertex.
+     * This is the only step that visits all edges of \e graph; the rest of the assembly works
+     * on the cut edges only.
+     * @param graph Graph of cells
+     * @param part Partitioning of the cells
+     * @param cut_offsets [out] Index offsets of each process in \e cut_ngbs
+     * @param cut_ngbs [out] Owners of the second vertex of the cut edges, grouped by processes
+     * @param cut_firsts [out] Whether the edge is the first one of its cell leading to that owner
+     */
+    void collectCutEdges(Graph& graph, const int32_t* part, std::vector<int32_t> &cut_offsets,
+                         std::vector<int32_t> &cut_ngbs, std::vector<char> &cut_firsts);
+
+private:
+    int32_t num_procs;              // Number of processes (rows)
+    std::vector<int32_t> offsets;   // Index offsets for rows
+    std::vector<int32_t> ranks;     // Neighboring processes
+    std::vector<int32_t> weights;   // Number of shared faces
+    std::vector<int32_t> cells;     // Number of cells sent to the neighbor
+};
+
+#endif //UNBALANCED_WORKLOAD_PROCESSGRAPH_H
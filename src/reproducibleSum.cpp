@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cmath>
+#include <algorithm>
+
+#include "reproducibleSum.h"
+
+void ReproducibleSum::clear() {
+
+    for (int n = 0; n < num_limbs; ++n)
+        limbs[n] = 0;
+    special = 0.;
+    num_pending = 0;
+}
+
+void ReproducibleSum::add(const double* values, int64_t size) {
+
+    /* Each thread accumulates its own part, exact sums can be merged in any order */
+    #pragma omp parallel
+    {
+        ReproducibleSum local;
+
+        #pragma omp for schedule(static)
+        for (int64_t n = 0; n < size; ++n) {
+            local.add(values[n]);
+        }
+
+        #pragma omp critical
+        add(local);
+    }
+}
+
+void ReproducibleSum::add(const ReproducibleSum& other) {
+
+    ReproducibleSum copy = other;
+
+    /* Both operands have digits below 2^32 after the normalization, the sum can not overflow */
+    copy.normalize();
+    normalize();
+    for (int n = 0; n < num_limbs; ++n)
+        limbs[n] += copy.limbs[n];
+    special += copy.special;
+    normalize();
+}
+
+void ReproducibleSum::reduce() {
+
+    static MPI_Datatype sum_type = MPI_DATATYPE_NULL;
+    static MPI_Op sum_op = MPI_OP_NULL;
+
+    if (sum_type == MPI_DATATYPE_NULL) {
+        MPI_Type_contiguous(sizeof(ReproducibleSum), MPI_BYTE, &sum_type);
+        MPI_Type_commit(&sum_type);
+        MPI_Op_create(&ReproducibleSum::combine, 1, &sum_op);
+    }
+
+    normalize();
+    MPI_Allreduce(MPI_IN_PLACE, this, 1, sum_type, sum_op, MPI_COMM_WORLD);
+}
+
+double ReproducibleSum::getValue() {
+
+    ReproducibleSum magnitude = *this;
+    double sign = 1.;
+    double result = 0.;
+    int top = num_limbs - 1;
+
+    magnitude.normalize();
+
+    /* Only the most significant limb is signed, negate the whole number to get the magnitude */
+    if (magnitude.limbs[num_limbs - 1] < 0) {
+        sign = -1.;
+        for (int n = 0; n < num_limbs; ++n)
+            magnitude.limbs[n] = -magnitude.limbs[n];
+        magnitude.normalize();
+    }
+
+    while (top > 0 && magnitude.limbs[top] == 0)
+        --top;
+
+    /* Three digits cover more than the 53 bits of the mantissa */
+    for (int n = std::max(top - 2, 0); n <= top; ++n) {
+        result += std::ldexp((double) magnitude.limbs[n], 32 * n - 1074);
+    }
+
+    return sign * result + special;
+}
+
+void ReproducibleSum::normalize() {
+
+    for (int n = 0; n < num_limbs - 1; ++n) {
+        int64_t carry = limbs[n] >> 32;     // Rounds towards minus infinity
+        limbs[n] -= carry * (INT64_C(1) << 32);
+        limbs[n + 1] += carry;
+    }
+    num_pending = 0;
+}
+
+void ReproducibleSum::combine(void *in, void *inout, int *len, MPI_Datatype * /* datatype */) {
+
+    ReproducibleSum *src = static_cast<ReproducibleSum*>(in);
+    ReproducibleSum *dst = static_cast<ReproducibleSum*>(inout);
+
+    for (int n = 0; n < *len; ++n) {
+        dst[n].add(src[n]);
+    }
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_REPRODUCIBLESUM_H
+#define UNBALANCED_WORKLOAD_REPRODUCIBLESUM_H
+
+#include <cstring>
+#include <cstdint>
+
+#include "common.h"
+
+/*!
+ * \class ReproducibleSum
+ * @brief Exact sum of doubles, independent of the order of summation.
+ * Every double is a multiple of 2^-1074, so the sum is kept as a fixed-point number with this
+ * resolution (a superaccumulator). It is split into 32-bit digits stored in int64_t limbs; the
+ * upper half of each limb absorbs carries, which are propagated once per 2^30 additions. Since
+ * the accumulated value is exact, both the local and the global (see \e reduce()) sums are
+ * bitwise identical for any order of the values, i.e. for any decomposition.
+ */
+class ReproducibleSum {
+public:
+    ReproducibleSum() { clear(); }
+
+    ~ReproducibleSum() { }
+
+    void clear();
+
+    /*!
+     * @brief Add the value exactly.
+     * Infinities and NaNs are summed separately in the regular way.
+     */
+    inline void add(double value) {
+
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        int32_t exponent = (bits >> 52) & 0x7ff;
+        uint64_t mantissa = bits & ((UINT64_C(1) << 52) - 1);
+
+        if (exponent == 0x7ff) {
+            special += value;
+            return;
+        }
+
+        /* value = mantissa * 2^(shift - 1074), subnormal numbers have no implicit bit */
+        int32_t shift = 0;
+        if (exponent > 0) {
+            mantissa |= UINT64_C(1) << 52;
+            shift = exponent - 1;
+        }
+
+        int32_t limb = shift >> 5;
+        int32_t offset = shift & 31;
+        int64_t low = (int64_t) ((mantissa << offset) & 0xffffffff);
+        int64_t rest = (int64_t) (mantissa >> (32 - offset));
+
+        /* Branch-free negation: x ^ 0 - 0 = x, x ^ -1 - (-1) = -x */
+        int64_t sign = -(int64_t) (bits >> 63);
+        limbs[limb] += (low ^ sign) - sign;
+        limbs[limb + 1] += ((rest & 0xffffffff) ^ sign) - sign;
+        limbs[limb + 2] += ((rest >> 32) ^ sign) - sign;
+
+        if (++num_pending == max_pending)
+            normalize();
+    }
+
+    /*!
+     * @brief Add values of the array.
+     */
+    void add(const double* values, int64_t size);
+
+    /*!
+     * @brief Add the accumulated value of another sum.
+     */
+    void add(const ReproducibleSum& other);
+
+    /*!
+     * @brief Sum up the accumulators of all processes exactly.
+     */
+    void reduce();
+
+    /*!
+     * @brief Round the accumulated value to double.
+     * The rounding depends on the exact value only, so the result is reproducible.
+     */
+    double getValue();
+
+    /*!
+     * @brief Number of limbs, covers 2^-1074 ... 2^1024 and carries.
+     */
+    static const int num_limbs = 70;
+
+private:
+    /*!
+     * @brief Propagate carries, so the lower half of each limb stores its digit.
+     * The most significant limb keeps the sign.
+     */
+    void normalize();
+
+    /*!
+     * @brief User-defined MPI operation adding accumulators.
+     */
+    static void combine(void *in, void *inout, int *len, MPI_Datatype *datatype);
+
+private:
+    int64_t limbs[num_limbs];
+    double special;             // Sum of infinities and NaNs
+    int64_t num_pending;        // Number of additions since the last normalization
+
+    static const int64_t max_pending = INT64_C(1) << 30;
+};
+
+#endif //UNBALANCED_WORKLOAD_REPRODUCIBLESUM_H
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include "weightModel.h"
+#include "common.h"
+
+void WeightModel::calibrate(Field &field, int num_samples) {
+
+    double sum_n = 0., sum_t = 0., sum_nn = 0., sum_nt = 0.;
+    volatile double sink = 0.;      // Keeps the work from being optimized away
+
+    num_samples = std::max(num_samples, 2);
+
+    for (int s = 0; s < num_samples; ++s) {
+        double value = (double) s / (num_samples - 1);
+        double iters = (int) field.getLocalLoad(value);
+        int repeats = 0;
+        double start = getWallTime();
+        double elapsed = 0.;
+
+        /* Cheap cells are repeated until the timer resolution becomes negligible */
+        do {
+            sink = sink + field.performCellWork(value);
+            ++repeats;
+            elapsed = getWallTime() - start;
+        } while (elapsed < 1.e-3);
+
+        double time = elapsed / repeats;
+        sum_n += iters;
+        sum_t += time;
+        sum_nn += iters * iters;
+        sum_nt += iters * time;
+    }
+
+    double det = num_samples * sum_nn - sum_n * sum_n;
+    cost_per_iter = (det > 0.) ? (num_samples * sum_nt - sum_n * sum_t) / det : 0.;
+    cost_base = (sum_t - cost_per_iter * sum_n) / num_samples;
+
+    /* Timing noise must not produce negative costs */
+    if (cost_per_iter <= 0.) {
+        std::cout << "Warning! The calibration failed, the load is used as the cost...\n";
+        cost_base = 0.;
+        cost_per_iter = 1.;
+        calibrated = false;
+        return;
+    }
+    cost_base = std::max(cost_base, 0.);
+    calibrated = true;
+
+    std::cout << "Cost of a cell: " << cost_base << "s + " << cost_per_iter << "s per iteration\n";
+}
+
+void WeightModel::computeWeights(Field &field, std::vector<int32_t> &weights, int32_t ncon) {
+
+    int64_t num_cells = field.getNumElts();
+    std::vector<double> costs(num_cells);
+
+    weights.resize(num_cells * ncon);
+
+    for (int32_t con = 0; con < ncon; ++con) {
+        #pragma omp parallel for
+        for (int64_t n = 0; n < num_cells; ++n) {
+            costs[n] = (con == 0) ? getCost(field, field(n)) : field.getLocalMemory(field(n));
+        }
+
+        double error = quantize(costs, weights.data() + con, ncon);
+
+        if (error > max_error) {
+            std::cout << "Warning! Relative quantization error of constraint " << con << " is " << error
+                      << ", the partitioning might be imbalanced...\n";
+        }
+    }
+}
+
+double WeightModel::quantize(const std::vector<double> &costs, int32_t* weights, int32_t stride) {
+
+    int64_t num_cells = costs.size();
+    double total = 0.;
+    double error = 0.;
+
+    #pragma omp parallel for reduction(+:total)
+    for (int64_t n = 0; n < num_cells; ++n) {
+        total += costs[n];
+    }
+
+    if (total <= 0.) {
+        for (int64_t n = 0; n < num_cells; ++n)
+            weights[n * stride] = 1;
+        return 0.;
+    }
+
+    /*
+     * Use the whole range, so the relative precision is kept for both small and large totals.
+     * Rounding each cell adds at most 0.5 to the total, clamping to 1 adds at most 1.
+     */
+    double scale = (max_total - (double) num_cells) / total;
+    if (scale <= 0.) {
+        std::cout << "Warning! Too many cells to fit the weights into idx_t...\n";
+        scale = 0.;
+    }
+
+    #pragma omp parallel for reduction(+:error)
+    for (int64_t n = 0; n < num_cells; ++n) {
+        double scaled = costs[n] * scale;
+        int32_t weight = std::max((int32_t) std::llround(scaled), 1);
+        weights[n * stride] = weight;
+        error += std::fabs(weight - scaled);
+    }
+
+    return (scale > 0.) ? error / (total * scale) : 1.;
+}
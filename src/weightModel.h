@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2024 Maksim Masterov, SURF
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UNBALANCED_WORKLOAD_WEIGHTMODEL_H
+#define UNBALANCED_WORKLOAD_WEIGHTMODEL_H
+
+#include <vector>
+
+#include "field.h"
+
+/*!
+ * @brief Converts the cost of cells into integer weights of vertices for METIS.
+ * The cost of a cell is modelled as t0 + t1 * n, where n is the number of iterations performed
+ * by \e Field::performCellWork() and t0, t1 are measured by \e calibrate(). Without calibration
+ * the cost is the load of the cell. Costs are scaled so the sum of weights of each constraint
+ * fits into idx_t and then rounded to integers, the smallest weight being 1.
+ */
+class WeightModel {
+public:
+    WeightModel() : cost_base(0.), cost_per_iter(1.), calibrated(false), max_error(1.e-3) { }
+
+    ~WeightModel() { }
+
+    /*!
+     * @brief Measure the cost of a cell by timing \e Field::performCellWork() for sampled values.
+     * The costs t0 and t1 are fitted with the least squares method.
+     * @param field Field providing the cost model.
+     * @param num_samples Number of sampled values in range [0, 1].
+     */
+    void calibrate(Field &field, int num_samples = 16);
+
+    /*!
+     * @brief Evaluate the cost of a cell.
+     * @param field Field providing the cost model.
+     * @param value Value stored in the cell.
+     * @return Cost of the cell (in seconds, if calibrated).
+     */
+    inline double getCost(Field &field, double value) {
+        return calibrated ? cost_base + cost_per_iter * (int) field.getLocalLoad(value)
+                          : field.getLocalLoad(value);
+    }
+
+    /*!
+     * @brief Compute the weights of all cells of the field in parallel.
+     * The compute cost is the first constraint, the memory footprint is the second one.
+     * @param field Field storing values of all cells.
+     * @param weights [out] Weights of cells, \e ncon consecutive values per cell.
+     * @param ncon Number of constraints (1 or 2).
+     */
+    void computeWeights(Field &field, std::vector<int32_t> &weights, int32_t ncon);
+
+    /*!
+     * @brief Scale the costs and round them to integers.
+     * @param costs Costs of cells.
+     * @param weights [out] Weights of cells, the weight of cell \e n is weights[n * stride].
+     * @param stride Distance between weights of consecutive cells.
+     * @return Relative quantization error, i.e. sum |weight - scaled cost| / sum scaled cost.
+     */
+    static double quantize(const std::vector<double> &costs, int32_t* weights, int32_t stride = 1);
+
+    /*!
+     * @brief Set the relative quantization error above which a warning is printed.
+     */
+    inline void setMaxError(double error) {
+        max_error = error;
+    }
+
+    /*!
+     * @brief Maximum sum of weights of a single constraint, leaves a headroom for METIS.
+     */
+    static const int32_t max_total = 1 << 30;
+
+private:
+    double cost_base;       // Cost of a cell without iterations (t0)
+    double cost_per_iter;   // Cost of a single iteration (t1)
+    bool calibrated;
+    double max_error;       // Relative quantization error triggering a warning
+};
+
+#endif //UNBALANCED_WORKLOAD_WEIGHTMODEL_H